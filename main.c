@@ -12,54 +12,225 @@
 #include <string.h>
 #include <time.h>
 #include <ctype.h>
+#include <math.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdarg.h>
+#ifndef _WIN32
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
+#if defined(USE_IO_URING) && defined(__linux__)
+#define IO_URING_AVAILABLE
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
+
+// Lot profiles
+// A build is specialized for one kind of lot: -DLOT_PROFILE_KIOSK for a small
+// unattended lot, -DLOT_PROFILE_GARAGE for a multi-storey garage, neither for
+// the standard lot. A profile only picks defaults; each constant below can
+// still be overridden on its own.
+#if defined(LOT_PROFILE_KIOSK)
+#define LOT_PROFILE_NAME "kiosk"
+#define PROFILE_SPOTS 16
+#define PROFILE_VEHICLES 64
+#define PROFILE_OWNERS 64
+#define PROFILE_ZONES 1
+#define PROFILE_SURGE_PRICING 0 // Flat rate: nobody on site to explain a surge
+#elif defined(LOT_PROFILE_GARAGE)
+#define LOT_PROFILE_NAME "garage"
+#define PROFILE_SPOTS 2000
+#define PROFILE_VEHICLES 8000
+#define PROFILE_OWNERS 4000
+#define PROFILE_ZONES 8 // One per level
+#define PROFILE_SURGE_PRICING 1
+#else
+#define LOT_PROFILE_NAME "standard"
+#define PROFILE_SPOTS 50
+#define PROFILE_VEHICLES 200
+#define PROFILE_OWNERS 100
+#define PROFILE_ZONES 5
+#define PROFILE_SURGE_PRICING 1
+#endif
 
 // Constants
+// Table sizes can be raised at build time, e.g. -DMAX_VEHICLES=1000000 for benchmarks
 #define MAX_ADMINS 10
-#define MAX_OWNERS 100
-#define MAX_VEHICLES 200
-#define MAX_PARKING_SPOTS 50
+#ifndef MAX_OWNERS
+#define MAX_OWNERS PROFILE_OWNERS
+#endif
+#ifndef MAX_VEHICLES
+#define MAX_VEHICLES PROFILE_VEHICLES
+#endif
+#ifndef MAX_PARKING_SPOTS
+#define MAX_PARKING_SPOTS PROFILE_SPOTS
+#endif
 #define NAME_LEN 50
-#define EMAIL_LEN 20
+#define EMAIL_LEN 21 // 20 characters and the terminator
 #define CONTACT_LEN 12
 #define PASSWORD_LEN 50
+#define PASSWORD_HASH_LEN 128 // "pbkdf2$<iterations>$<salt hex>$<hash hex>"
+#define PBKDF2_ITERATIONS 100000
+#define PASSWORD_SALT_LEN 16
+#define SESSION_TOKEN_LEN 33 // 128 random bits as hex
+#define SESSION_TTL_SECONDS (30 * 60)
+#define MAX_SESSIONS 64
+#define SESSION_INDEX_SIZE 131
 #define OWNER_ID_LEN 20
 #define VEHICLE_ID_LEN 20
 #define LICENSE_PLATE_LEN 15
 #define VEHICLE_TYPE_LEN 20
+#define MAX_PASSES 200
+#define HOLDER_NAME_LEN 50
+#ifndef NUM_ZONES
+#define NUM_ZONES PROFILE_ZONES
+#endif
+#ifndef SURGE_PRICING
+#define SURGE_PRICING PROFILE_SURGE_PRICING
+#endif
+// Free spots are found through a bitmap on large lots; a plain scan is faster
+// while the whole spot table fits in a few cache lines
+#ifndef SPOT_BITMAP
+#define SPOT_BITMAP (MAX_PARKING_SPOTS > 256)
+#endif
+#define SPOT_WORDS ((MAX_PARKING_SPOTS + 63) / 64)
+#define SPOTS_PER_ZONE (MAX_PARKING_SPOTS / NUM_ZONES)
+#define ALL_ZONES ((1u << NUM_ZONES) - 1)
+#define INDEX_KEY_LEN 20
+#define PASS_INDEX_SIZE 512 // At least twice MAX_PASSES
+#define VEHICLE_INDEX_SIZE (2 * MAX_VEHICLES + 1)
+#define OWNER_INDEX_SIZE (2 * MAX_OWNERS + 1)
+#define MAX_OWNERSHIPS (2 * MAX_VEHICLES)
+#define HIST_SUB_BUCKETS 8  // Sub-buckets per power of two (about 12% precision)
+#define HIST_BUCKETS (64 * HIST_SUB_BUCKETS)
+#define MAX_FEED_SUBSCRIBERS 256
+#define FEED_RING_SIZE 256 // Changed spots queued per dashboard subscriber, power of two
+#define FEED_SPOT_WORDS SPOT_WORDS
+#define FEED_POLL_BATCH 64
+#define FEED_RESYNC -1 // Returned by feedPoll: redraw the whole lot from spots[]
+#define TIMER_TICK_SECONDS 60
+#define TIMER_WHEEL_BITS 6
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_BITS)
+#define TIMER_LEVELS 4
+#define TIMER_LISTS (TIMER_LEVELS * TIMER_WHEEL_SLOTS + 1)
+#define TIMER_DUE_LIST (TIMER_LISTS - 1) // Armed with an expiry already reached
+#define MAX_TIMERS (MAX_PARKING_SPOTS + MAX_PASSES)
+#define SPOT_TIMER(spotIndex) (spotIndex)
+#define PASS_TIMER(passIdx) (MAX_PARKING_SPOTS + (passIdx))
+#define RECENT_ALERTS 16
+#define JOURNAL_PENDING_MAX 1024 // Gate events queued between two parking saves
+#define REPLAY_MAX_REPORTED 20
+#define WAITLIST_MAX 128 // Vehicles queued at the entry gate, all classes together
+#define WAIT_GAP_SMOOTHING 0.2 // Weight of the newest gap in the smoothed release interval
+#define SEARCH_PAGE_SIZE 20
+#define TRIGRAM_ALPHABET 38 // Letters folded to one case, digits, space, everything else
+#define TRIGRAM_SPACE (TRIGRAM_ALPHABET * TRIGRAM_ALPHABET * TRIGRAM_ALPHABET)
+#define MAX_TRIGRAM_POSTINGS (MAX_OWNERS * (NAME_LEN - 3)) // Every owner at the longest name
+#define SERIES_BLOCK_SAMPLES 512 // Minutes in one compressed occupancy block
+#define SERIES_MAX_BLOCKS 65536 // Ten years of a 5-zone lot
+#define SERIES_DATA_BYTES (4 * 1024 * 1024)
+#define SERIES_MAX_GAP_MINUTES (366 * 24 * 60) // Longer outages start the series again
+#define ARENA_BLOCK_SIZE (256 * 1024)
+#define ARENA_ALIGN 16
+#define WRITER_BUFFER_SIZE (64 * 1024) // Data file writes go out in chunks of this size
+#define IO_SLOTS 8 // Chunk buffers shared by the asynchronous I/O backends
+#define IO_THREADS 2
+#define IO_URING_ENTRIES (2 * IO_SLOTS) // A chunk takes a write and at most one fsync
+#define MAX_SITES 64
+#define SITE_NAME_LEN 32
+#define MAX_SITE_PLATES (MAX_SITES * MAX_PARKING_SPOTS)
+#define SITE_PLATE_INDEX_SIZE (2 * MAX_SITE_PLATES + 1)
+
+#if NUM_ZONES < 1 || NUM_ZONES > 26
+#error "NUM_ZONES must be between 1 and 26 (zones are lettered A to Z)"
+#endif
+#if MAX_PARKING_SPOTS < NUM_ZONES
+#error "Every zone needs at least one parking spot"
+#endif
 
 // CREATING ALL FOLDER
 
 #ifdef _WIN32
 #include <direct.h>
+#include <windows.h>
 #else
 #include <sys/stat.h>
 #endif
 
-void createFolders()
+// Root folder of all data files, empty means the current directory
+char dataRoot[200] = "";
+
+void buildDataPath(char *path, size_t size, const char *relative)
+{
+    if (dataRoot[0] == 0)
+        snprintf(path, size, "%s", relative);
+    else
+        snprintf(path, size, "%s/%s", dataRoot, relative);
+}
+
+FILE *openDataFile(const char *relative, const char *mode)
+{
+    char path[300];
+    buildDataPath(path, sizeof(path), relative);
+    return fopen(path, mode);
+}
+
+void makeFolder(const char *relative)
 {
+    char path[300];
+    buildDataPath(path, sizeof(path), relative);
 #ifdef _WIN32
-    _mkdir("admin");
-    _mkdir("vehicles");
-    _mkdir("owners");
-    _mkdir("parking");
-    _mkdir("reports");
+    _mkdir(path);
 #else
-    mkdir("admin", 0777);
-    mkdir("vehicles", 0777);
-    mkdir("owners", 0777);
-    mkdir("parking", 0777);
-    mkdir("reports", 0777);
+    mkdir(path, 0777);
 #endif
 }
+
+void createFolders()
+{
+    if (dataRoot[0] != 0)
+        makeFolder("");
+    makeFolder("admin");
+    makeFolder("vehicles");
+    makeFolder("owners");
+    makeFolder("parking");
+    makeFolder("reports");
+    makeFolder("passes");
+    makeFolder("metrics");
+    makeFolder("forecast");
+    makeFolder("alerts");
+    makeFolder("journal");
+    makeFolder("history");
+}
 // END FOLDER
 
+// Heap allocation counters. Every allocation the program makes goes through
+// heapAlloc; the import validators and I/O workers allocate too, so the
+// counters are atomic.
+_Atomic unsigned long long heapAllocCount = 0;
+_Atomic unsigned long long heapAllocBytes = 0;
+
+void *heapAlloc(size_t size)
+{
+    heapAllocCount++;
+    heapAllocBytes += size;
+    return malloc(size);
+}
+
 // For Admin
 typedef struct
 {
     char name[NAME_LEN];
     char phoneNumber[CONTACT_LEN];
     char email[EMAIL_LEN];
-    char password[PASSWORD_LEN];
+    char passwordHash[PASSWORD_HASH_LEN]; // Salted PBKDF2-HMAC-SHA256, never the password
 } Admin;
 
 // For Owner
@@ -67,7 +238,6 @@ typedef struct
 {
     char ownerId[OWNER_ID_LEN];
     char name[NAME_LEN];
-    char vehicleID[VEHICLE_ID_LEN];
     char phoneNumber[CONTACT_LEN];
 
 } Owner;
@@ -77,9 +247,6 @@ typedef struct
 {
     char vehicleId[VEHICLE_ID_LEN];
     char licensePlate[LICENSE_PLATE_LEN];
-    char ownerId[OWNER_ID_LEN];
-    char ownerName[NAME_LEN];
-    char ownerPhoneNumber[CONTACT_LEN];
     char vehicleType[VEHICLE_TYPE_LEN];
     int isParked;
     int spotNumber;
@@ -94,8 +261,544 @@ typedef struct
     char vehicleId[VEHICLE_ID_LEN];
     time_t entryTime;
     double parkingFee;
+    int isPassSession; // Parked under a monthly pass, no fee at exit
+    double ratePerHour; // Locked in at entry by the surge pricing
 } ParkingSpot;
 
+// For Monthly Pass / Subscription (season tickets, company fleets)
+typedef struct
+{
+    char vehicleId[VEHICLE_ID_LEN];
+    char holderName[HOLDER_NAME_LEN];
+    time_t validFrom;
+    time_t validUntil;
+    int monthlyQuota;      // Entries allowed per calendar month, 0 = unlimited
+    int entriesThisMonth;
+    int quotaPeriod;       // year * 12 + month the entry counter belongs to
+    unsigned int zoneMask; // Bit z set = zone z allowed
+    int isActive;
+} Pass;
+
+// Owner <-> vehicle link. Each link sits in two singly linked adjacency
+// lists: the owner's vehicles and the vehicle's owners.
+typedef struct
+{
+    int ownerIndex;
+    int vehicleIndex;
+    int nextOfOwner;   // Next link of the same owner, -1 ends the list
+    int nextOfVehicle; // Next link of the same vehicle, -1 ends the list
+} Ownership;
+
+// Logged-in operator session; the token is handed out once at login
+typedef struct
+{
+    char token[SESSION_TOKEN_LEN];
+    int adminIndex; // -1 = free slot
+    time_t expiresAt;
+} Session;
+
+// One record for bulk validation; NULL fields are not checked
+typedef struct
+{
+    const char *name;
+    const char *phone;
+    const char *email;
+    const char *password;
+    const char *plate;
+    const char *vehicleType;
+} ValidationRecord;
+
+// CSV row during import; the strings point into the read buffer
+typedef struct
+{
+    ValidationRecord check;
+    const char *vehicleId; // NULL when the file has no vehicle_id column
+    long line;
+    unsigned int errors;
+} ImportRow;
+
+typedef struct
+{
+    ImportRow *rows;
+    int count;
+} ImportSlice;
+
+typedef struct
+{
+    long vehiclesAdded;
+    long ownersAdded;
+    long coOwners;
+    long duplicates;
+    long rejected;
+    long full;
+} ImportStats;
+
+// Spot change as seen by a display (latest state of the spot when polled)
+typedef struct
+{
+    int spotNumber;
+    int isOccupied;
+    char vehicleId[VEHICLE_ID_LEN];
+    time_t changedAt;
+} SpotEvent;
+
+// One display following the lot. A spot sits in the ring at most once: further
+// changes before the display polls are coalesced into the queued entry.
+typedef struct
+{
+    int active;
+    int needsResync; // Ring overflowed or the lot was reset
+    unsigned int head;
+    unsigned int tail;
+    int ring[FEED_RING_SIZE]; // Spot indexes
+    unsigned long long queued[FEED_SPOT_WORDS];
+} FeedSubscriber;
+
+// Pending timer of a spot or a pass, linked into one wheel slot
+typedef struct
+{
+    time_t expiresAt;
+    int kind; // ALERT_* raised when it fires
+    int armed;
+    int list; // Wheel slot (or due list) it is linked into
+    int prev;
+    int next;
+} Timer;
+
+// Fired alert as handed to the sink
+typedef struct
+{
+    int kind;
+    time_t at; // When the stage was reached
+    int spotNumber; // 0 for pass alerts
+    char vehicleId[VEHICLE_ID_LEN];
+    char detail[64];
+} AlertEvent;
+
+// Occupied spot in a lot snapshot (live or replayed from the journal)
+typedef struct
+{
+    int spotNumber;
+    time_t entryTime;
+    int isPassSession;
+    double ratePerHour;
+    int registered; // Vehicle still in the registry (owner and type filled in)
+    char vehicleId[VEHICLE_ID_LEN];
+    char licensePlate[LICENSE_PLATE_LEN];
+    char vehicleType[VEHICLE_TYPE_LEN];
+    char ownerName[NAME_LEN];
+} SnapshotRow;
+
+typedef struct
+{
+    unsigned long version; // lotVersion the copy was taken at
+    int count;
+    SnapshotRow *rows;
+} LotSnapshot;
+
+// Counts kept while replaying the event journal
+typedef struct
+{
+    long parks;
+    long unparks;
+    long removes;
+    long divergences;
+    double revenue;
+} ReplayStats;
+
+// Sealed block of one zone's per-minute occupancy (24 bytes, also the file record)
+typedef struct
+{
+    int32_t startMinute; // Minutes since the epoch
+    uint16_t count;
+    uint8_t zone;
+    uint8_t width; // Bits per zigzag delta, 0 when nothing changed
+    uint16_t first;
+    uint16_t minValue;
+    uint16_t maxValue;
+    uint16_t reserved;
+    uint32_t sum;
+    uint32_t dataOffset; // Packed deltas in seriesData (not meaningful on disk)
+} SeriesBlock;
+
+// Samples of a zone not yet sealed into a block
+typedef struct
+{
+    int32_t startMinute;
+    int count;
+    uint16_t values[SERIES_BLOCK_SAMPLES];
+} SeriesStage;
+
+// One bucket of a downsampled occupancy query
+typedef struct
+{
+    long long sum;
+    long samples;
+    int minValue;
+    int maxValue;
+} SeriesPoint;
+
+// Gate event waiting for the next journal flush
+typedef struct
+{
+    int type;
+    time_t at;
+    int spotNumber;
+    double amount; // Rate locked at entry, or fee charged at exit
+    char vehicleId[VEHICLE_ID_LEN];
+    char licensePlate[LICENSE_PLATE_LEN];
+} JournalEntry;
+
+// Vehicle waiting at the entry gate, linked into its class FIFO (or the free list)
+typedef struct
+{
+    int vehicleIndex;
+    int waitClass;
+    time_t queuedAt;
+    int prev;
+    int next;
+} WaitEntry;
+
+// One owner in the posting list of a name trigram
+typedef struct
+{
+    int ownerIndex;
+    int next; // Posting + 1, or 0 at the end of the list
+} TrigramPosting;
+
+typedef void (*AlertSinkFn)(const AlertEvent *event, const char *line);
+
+// One site as seen by the aggregator (filled from its latest status reply)
+typedef struct
+{
+    char socketPath[108];
+    char name[SITE_NAME_LEN];
+    int online;
+    int partial; // Online, but some of its parked plates are missing from the global index
+    uint32_t totalSpots;
+    uint32_t occupied;
+    uint32_t vehicles;
+    double revenue;
+    double entryRate;
+} SiteShard;
+
+// Parked plate in the aggregator's global plate -> site index
+typedef struct
+{
+    char plate[LICENSE_PLATE_LEN];
+    int site;
+    int spotNumber;
+    time_t entryTime;
+} SitePlate;
+
+// Closed sessions per hour of week (forecast history)
+typedef struct
+{
+    unsigned int arrivals;   // Sessions that started in this hour
+    unsigned int departures; // Sessions that ended in this hour
+} HourStats;
+
+// Per-thread bump allocator for transient buffers; see the Arena Allocator section
+#ifdef _MSC_VER
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL _Thread_local
+#endif
+
+typedef struct ArenaBlock
+{
+    struct ArenaBlock *next;
+    size_t size;
+    size_t used;
+    _Alignas(ARENA_ALIGN) unsigned char data[];
+} ArenaBlock;
+
+typedef struct
+{
+    ArenaBlock *first;
+    ArenaBlock *current;
+    size_t bytesInUse;
+    size_t peakBytes;
+    unsigned long long blockAllocs; // Calls to malloc, flat once the arena is warm
+    unsigned long long resets;
+} Arena;
+
+// Position to rewind an arena to, taken at the start of a scope
+typedef struct
+{
+    ArenaBlock *block;
+    size_t used;
+    size_t bytesInUse;
+} ArenaMark;
+
+// Data file being written: records are formatted into an arena buffer and
+// written out in WRITER_BUFFER_SIZE chunks, no stdio stream is involved
+typedef struct
+{
+#ifdef _WIN32
+    FILE *fp;
+#else
+    int fd;
+#endif
+    Arena *arena;
+    ArenaMark mark;
+    char *buffer;
+    size_t length;
+    size_t capacity;
+    long written;
+    int failed;
+    int append;
+    int durable;  // Data sync before close returns (the event journal)
+    int slot;     // Shared I/O chunk being filled, -1 when writing synchronously
+    int inFlight; // Chunks handed to the I/O backend and not yet finished
+} DataWriter;
+
+// Chunk buffer of the asynchronous I/O backends
+typedef struct
+{
+    char *data;
+    int state;
+    DataWriter *owner;
+    int fd;
+    size_t length;
+    long long offset; // -1: append at the file position
+    int sync;
+    int ok;
+    int done;    // Set by an I/O thread under ioLock
+    int pending; // io_uring completions still expected (write, fsync)
+} IoSlot;
+
+#ifdef IO_URING_AVAILABLE
+// Rings shared with the kernel, mapped once by ioUringSetup
+typedef struct
+{
+    int fd;
+    unsigned *sqHead;
+    unsigned *sqTail;
+    unsigned sqMask;
+    unsigned *sqArray;
+    struct io_uring_sqe *sqes;
+    unsigned *cqHead;
+    unsigned *cqTail;
+    unsigned cqMask;
+    struct io_uring_cqe *cqes;
+} IoRing;
+#endif
+
+// Whole data file in memory, consumed line by line
+typedef struct
+{
+    char *data;
+    size_t size;
+    size_t pos;
+    long line;        // Line number of the line last returned
+    const char *name; // File name for warnings
+} DataReader;
+
+// Field of a data file line: points into the reader's buffer, not terminated
+typedef struct
+{
+    const char *start;
+    int length;
+} FieldSpan;
+
+// Plate as read by a gate camera
+typedef struct
+{
+    char plate[LICENSE_PLATE_LEN];
+    int gate; // GATE_ENTRY or GATE_EXIT
+    time_t readAt;
+} PlateRead;
+
+// BK-tree node over canonical plates; children hang off a first-child/next-sibling list
+typedef struct
+{
+    char key[LICENSE_PLATE_LEN];
+    int vehicleIndex;
+    int distance; // Edit distance to the parent
+    int firstChild;
+    int nextSibling;
+    int duplicates; // Other vehicles with the same canonical plate
+} PlateNode;
+
+// One-deletion variant of a canonical plate, chained per hash bucket
+typedef struct
+{
+    unsigned int hash;
+    int node;
+    int next;
+} PlateVariant;
+
+// Slot of an open-addressing string index (key -> array position)
+typedef struct
+{
+    char key[INDEX_KEY_LEN];
+    int value; // INDEX_EMPTY, INDEX_DELETED or the array position
+} IndexSlot;
+
+#define INDEX_EMPTY -1
+#define INDEX_DELETED -2
+
+// Result of a pass check at the gate
+#define PASS_NONE 0
+#define PASS_OK 1
+#define PASS_QUOTA_EXHAUSTED 2
+#define PASS_NOT_YET_VALID 3
+
+// Log-linear latency histogram in nanoseconds (HDR style)
+typedef struct
+{
+    unsigned long long counts[HIST_BUCKETS];
+    unsigned long long total;
+    unsigned long long sum;
+    unsigned long long max;
+} LatencyHistogram;
+
+// Instrumented operations and persisted files (metric label order)
+#define OP_PARK 0
+#define OP_UNPARK 1
+#define OP_LOOKUP 2
+#define OP_GATE 3
+#define OP_SAVE 4
+#define OP_TIME_FORMAT 5
+#define OP_PLATE_MATCH 6
+#define NUM_OPS 7
+
+#define SAVE_ADMIN 0
+#define SAVE_VEHICLES 1
+#define SAVE_OWNERS 2
+#define SAVE_PARKING 3
+#define SAVE_PASSES 4
+#define SAVE_FORECAST 5
+#define NUM_SAVE_FILES 6
+
+#define METRICS_DUMP_SECONDS 60
+
+// Camera plate reads
+#define PLATE_QUEUE_SIZE 256 // Ring buffer of pending reads, power of two
+#define PLATE_MAX_DISTANCE 2 // Edits tolerated between a read and a registered plate
+#define PLATE_VARIANT_BUCKETS (4 * MAX_VEHICLES + 1)
+#define PLATE_NO_MATCH -1
+#define PLATE_AMBIGUOUS -2
+#define GATE_ENTRY 0
+#define GATE_EXIT 1
+
+// Overstay alerting: stages of a stay, measured from the entry time
+#define LONG_DWELL_SECONDS (12 * 3600)
+#define OVERSTAY_SECONDS (24 * 3600)
+#define OVERSTAY_GRACE_SECONDS (2 * 3600) // After the overstay warning, before enforcement
+#define ALERT_LONG_DWELL 0
+#define ALERT_OVERSTAY 1
+#define ALERT_GRACE_EXPIRED 2
+#define ALERT_PASS_EXPIRED 3
+#define NUM_ALERT_KINDS 4
+
+// Event journal entry types
+#define JOURNAL_PARK 0
+#define JOURNAL_UNPARK 1
+#define JOURNAL_REMOVE 2 // Parked vehicle deleted from the registry
+
+// Entry waitlist classes, in admission order
+#define WAIT_PASS 0
+#define WAIT_RESERVED 1
+#define WAIT_WALK_IN 2
+#define NUM_WAIT_CLASSES 3
+
+// Persistence backends: how data file chunks reach the disk
+#define IO_BACKEND_SYNC 0   // write() on the calling thread
+#define IO_BACKEND_THREAD 1 // Queued to a pool of I/O threads
+#define IO_BACKEND_URING 2  // io_uring, built with -DUSE_IO_URING (Linux)
+#define IO_SLOT_FREE 0
+#define IO_SLOT_FILLING 1 // A writer is formatting into it
+#define IO_SLOT_QUEUED 2 // Handed to the backend, settled by ioReap
+
+// Seqlock primitives for the lot version (plain accesses where no builtins exist)
+#if defined(__GNUC__)
+#define SEQ_LOAD(x) __atomic_load_n(&(x), __ATOMIC_ACQUIRE)
+#define SEQ_STORE(x, v) __atomic_store_n(&(x), (v), __ATOMIC_RELEASE)
+#define SEQ_FENCE() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#else
+#define SEQ_LOAD(x) (x)
+#define SEQ_STORE(x, v) ((x) = (v))
+#define SEQ_FENCE()
+#endif
+
+// Site federation protocol
+#define SHARD_SOCKET_NAME "shard.sock" // Inside the site's data folder
+#define SHARD_OP_STATUS 1
+#define SHARD_OP_PARKED 2
+#define SHARD_OP_FIND 3
+#define SHARD_OK 0
+#define SHARD_NOT_FOUND 1
+#define SHARD_BAD_REQUEST 2
+#define SHARD_REPLY_HEADER 5 // Status byte and 4-byte payload length
+#define SHARD_PARKED_PAGE 64 // Parked plates per reply; sites and aggregators may differ in lot size
+#define SHARD_REPLY_MAX (SHARD_REPLY_HEADER + 4 + SHARD_PARKED_PAGE * (11 + LICENSE_PLATE_LEN))
+
+// Outcome of a processed read (metric label order)
+#define PLATE_READ_PARKED 0
+#define PLATE_READ_UNPARKED 1
+#define PLATE_READ_NO_MATCH 2
+#define PLATE_READ_AMBIGUOUS 3
+#define PLATE_READ_REJECTED 4 // Matched, but the gate refused (full, already parked, not parked)
+#define PLATE_READ_DROPPED 5  // Queue was full
+#define NUM_PLATE_RESULTS 6
+
+// Validator character classes
+#define CH_UPPER 0x01
+#define CH_LOWER 0x02
+#define CH_DIGIT 0x04
+#define CH_SPACE 0x08 // Blank only, not tabs or newlines
+
+// Failing fields reported by validateRecord
+#define INVALID_NAME 0x01
+#define INVALID_PHONE 0x02
+#define INVALID_EMAIL 0x04
+#define INVALID_PASSWORD 0x08
+#define INVALID_PLATE 0x10
+#define INVALID_TYPE 0x20
+
+// Bulk CSV import
+#define CSV_CHUNK_SIZE (1 << 20) // Read buffer; also the longest accepted line
+#define IMPORT_BATCH 8192        // Rows validated together
+#define IMPORT_PARALLEL_MIN 2048 // Smaller batches are validated on the calling thread
+#define IMPORT_MAX_THREADS 8
+#define IMPORT_MAX_REPORTED 20 // Invalid lines printed individually
+#define IMPORT_MAX_FIELDS 16
+#define IMPORT_COL_PLATE 0
+#define IMPORT_COL_TYPE 1
+#define IMPORT_COL_NAME 2
+#define IMPORT_COL_PHONE 3
+#define IMPORT_COL_VEHICLE_ID 4
+#define IMPORT_COLUMNS 5
+
+#define HOURS_PER_WEEK 168
+#define HOUR_CACHE_SLOTS 8 // Recent local hours remembered by hourOfWeek, power of two
+
+// Surge pricing: the base rate times a factor for the occupancy band and time of day
+#define BASE_RATE_PER_HOUR 100.0
+#define NUM_OCCUPANCY_BANDS 4
+#define NUM_DAY_PERIODS 3
+
+// Gate engine status codes
+#define GATE_OK 0
+#define GATE_ALREADY_PARKED -1
+#define GATE_LOT_FULL -2
+#define GATE_NOT_PARKED -3
+
+// Outcome of a park/unpark at the gate
+typedef struct
+{
+    int status;
+    int spotNumber;
+    int passIdx;
+    int passStatus;
+    int isPassSession;
+    double fee;
+    double ratePerHour; // Rate locked in for the session (park only)
+    int admittedIndex;  // Waiting vehicle parked in the released spot (unpark only), or -1
+} GateResult;
+
 // Global variables
 Admin admins[MAX_ADMINS];
 Owner owners[MAX_OWNERS];
@@ -105,6 +808,195 @@ int numAdmins = 0;
 int numOwners = 0;
 int numVehicles = 0;
 
+// Session cache: index keyed by the first 16 hex digits of the token
+Session sessions[MAX_SESSIONS];
+IndexSlot sessionIndex[SESSION_INDEX_SIZE];
+char currentSessionToken[SESSION_TOKEN_LEN] = "";
+
+// Ownership links and the indexes over vehicles and owners
+Ownership ownerships[MAX_OWNERSHIPS];
+int numOwnerships = 0;
+int freeOwnership = -1; // Free list threaded through nextOfOwner
+int ownerFirstLink[MAX_OWNERS];
+int ownerLastLink[MAX_OWNERS]; // Tail of each owner's list, so appends do not walk it
+int vehicleFirstLink[MAX_VEHICLES];
+IndexSlot vehicleIdIndex[VEHICLE_INDEX_SIZE];
+IndexSlot ownerIdIndex[OWNER_INDEX_SIZE];
+IndexSlot ownerPhoneIndex[OWNER_INDEX_SIZE];
+IndexSlot importPlateIndex[VEHICLE_INDEX_SIZE]; // Exact plate -> vehicle, only during an import
+
+// Fuzzy plate index (exact canonical index + BK-tree) and the camera read queue
+PlateNode plateNodes[MAX_VEHICLES];
+int numPlateNodes = 0;
+int plateIndexStale = 1; // Built on the first match after a load or a removal
+IndexSlot plateIndex[VEHICLE_INDEX_SIZE]; // Canonical plate -> plate node
+PlateVariant plateVariants[MAX_VEHICLES * (LICENSE_PLATE_LEN - 1)];
+int numPlateVariants = 0;
+int plateVariantHead[PLATE_VARIANT_BUCKETS];
+PlateRead plateQueue[PLATE_QUEUE_SIZE];
+unsigned int plateQueueHead = 0; // Free-running counters, masked on access
+unsigned int plateQueueTail = 0;
+
+// Change feed subscribers and the time each spot last changed
+FeedSubscriber feedSubscribers[MAX_FEED_SUBSCRIBERS];
+int feedSubscriberLimit = 0; // One past the highest slot ever used
+int numFeedSubscribers = 0;
+int dashboardSubscriber = -1; // The admin console's own subscription
+time_t spotChangedAt[MAX_PARKING_SPOTS];
+
+// Timer wheel and alert delivery
+Timer timers[MAX_TIMERS];
+int timerListHead[TIMER_LISTS];
+unsigned long long timerCurrentTick = 0;
+int numTimersArmed = 0;
+static const char *alertKindNames[NUM_ALERT_KINDS] = {"LONG_DWELL", "OVERSTAY", "GRACE_EXPIRED", "PASS_EXPIRED"};
+AlertEvent recentAlerts[RECENT_ALERTS];
+unsigned long long recentAlertCount = 0;
+unsigned long long alertCount[NUM_ALERT_KINDS];
+unsigned long long alertsDropped = 0;
+char alertSocketPath[108] = "";
+void alertSinkFile(const AlertEvent *event, const char *line);
+AlertSinkFn alertSink = alertSinkFile;
+
+// Lot version for snapshot readers and the event journal queue
+unsigned long lotVersion = 0;
+unsigned long long snapshotRetries = 0;
+static const char *journalTypeNames[] = {"PARK", "UNPARK", "REMOVE"};
+JournalEntry journalPending[JOURNAL_PENDING_MAX];
+int journalPendingCount = 0;
+int journalEnabled = 0; // Off for the simulator and bench, which never touch the data files
+unsigned long long journalEvents = 0;
+unsigned long long journalDropped = 0;
+
+// Per-minute zone occupancy history
+int zoneOccupied[NUM_ZONES];
+SeriesBlock seriesBlocks[SERIES_MAX_BLOCKS];
+int numSeriesBlocks = 0;
+int numSeriesPersisted = 0; // Blocks already in history/occupancy.dat
+unsigned char seriesData[SERIES_DATA_BYTES];
+size_t seriesDataUsed = 0;
+SeriesStage seriesStages[NUM_ZONES];
+int seriesEnabled = 0; // Off for the simulator and bench, like the journal
+unsigned long long seriesDropped = 0; // Samples lost with the block store full
+unsigned long long seriesBlocksDecoded = 0;
+unsigned long long seriesBlocksSummarized = 0; // Answered from the header alone
+
+// Entry waitlist: one FIFO per class, threaded through a fixed pool of entries
+static const char *waitClassNames[] = {"pass", "reserved", "walk_in"};
+static const char *waitClassLabels[] = {"pass holder", "reservation", "walk-in"};
+WaitEntry waitEntries[WAITLIST_MAX];
+int waitHead[NUM_WAIT_CLASSES] = {-1, -1, -1};
+int waitTail[NUM_WAIT_CLASSES] = {-1, -1, -1};
+int waitDepth[NUM_WAIT_CLASSES];
+int waitFreeList = -1;
+int waitEntriesUsed = 0; // Pool entries handed out at least once
+int vehicleWaitEntry[MAX_VEHICLES]; // Entry + 1, or 0 when the vehicle is not waiting
+time_t waitLastRelease = 0;
+double waitReleaseGap = 0.0; // Smoothed seconds between spot releases
+unsigned long long waitQueued[NUM_WAIT_CLASSES];
+unsigned long long waitAdmitted[NUM_WAIT_CLASSES];
+unsigned long long waitLeft[NUM_WAIT_CLASSES];
+unsigned long long waitSeconds[NUM_WAIT_CLASSES]; // Total time the admitted vehicles waited
+unsigned long long waitRefused = 0; // Turned away with the waitlist full
+
+// Search indexes: vehicles by plate, owners by name trigram, parked spots by entry time
+int plateOrder[MAX_VEHICLES]; // Vehicle indexes sorted by plate
+int plateOrderCount = 0;
+int plateOrderStale = 1; // Sorted again on the next search
+int trigramFirst[TRIGRAM_SPACE]; // Posting + 1, or 0 when no owner name has the trigram
+int trigramLast[TRIGRAM_SPACE];
+int trigramCount[TRIGRAM_SPACE];
+TrigramPosting trigramPostings[MAX_TRIGRAM_POSTINGS];
+int numTrigramPostings = 0;
+int entryOrder[MAX_PARKING_SPOTS]; // Occupied spot indexes sorted by entry time
+int entryOrderCount = 0;
+
+// Persistence backend and its chunk buffers
+int ioBackend = IO_BACKEND_SYNC;
+static const char *ioBackendNames[] = {"sync", "thread", "uring"};
+unsigned long long ioChunks = 0;
+unsigned long long ioSyncs = 0;
+unsigned long long ioStalls = 0; // Waits for a chunk to finish before going on
+#ifndef _WIN32
+static _Alignas(4096) char ioBuffers[IO_SLOTS][WRITER_BUFFER_SIZE];
+IoSlot ioSlots[IO_SLOTS];
+int ioQueue[IO_SLOTS]; // Chunks waiting for an I/O thread
+unsigned ioQueueHead = 0;
+unsigned ioQueueTail = 0;
+pthread_mutex_t ioLock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t ioWork = PTHREAD_COND_INITIALIZER;
+pthread_cond_t ioDone = PTHREAD_COND_INITIALIZER;
+#endif
+#ifdef IO_URING_AVAILABLE
+IoRing ioRing;
+#endif
+
+// Aggregator state: the sites it follows and the global plate index
+SiteShard sites[MAX_SITES];
+int numSites = 0;
+SitePlate sitePlates[MAX_SITE_PLATES];
+int numSitePlates = 0;
+IndexSlot sitePlateIndex[SITE_PLATE_INDEX_SIZE]; // Canonical plate -> sitePlates position
+
+// Live count of occupied spots, kept by the gate engine so pricing never scans spots[]
+int occupiedCount = 0;
+#if SPOT_BITMAP
+uint64_t freeSpotBits[SPOT_WORDS]; // Bit i set: spots[i] is free
+#endif
+
+// Occupancy bands end below these percentages; the last band is everything above
+static const int occupancyBandLimits[NUM_OCCUPANCY_BANDS - 1] = {50, 75, 90};
+// Night 22:00-05:59, peak 07:00-09:59 and 16:00-18:59, off-peak otherwise
+static const unsigned char dayPeriodOfHour[24] = {0, 0, 0, 0, 0, 0, 1, 2, 2, 2, 1, 1,
+                                                  1, 1, 1, 1, 2, 2, 2, 1, 1, 1, 0, 0};
+static const char *dayPeriodNames[NUM_DAY_PERIODS] = {"night", "off-peak", "peak"};
+static const double surgeFactor[NUM_DAY_PERIODS][NUM_OCCUPANCY_BANDS] = {
+    {0.80, 0.80, 1.00, 1.20}, // Night
+    {1.00, 1.00, 1.25, 1.50}, // Off-peak
+    {1.00, 1.25, 1.50, 2.00}, // Peak
+};
+
+// Forecast history: bucket totals and the span of time they cover
+HourStats hourStats[HOURS_PER_WEEK];
+time_t forecastFirst = 0;
+time_t forecastLast = 0;
+
+// Pass storage, vehicle ID index and expiry min-heap (ordered by validUntil)
+Pass passes[MAX_PASSES];
+int numPasses = 0;
+IndexSlot passIndex[PASS_INDEX_SIZE];
+int passExpiryHeap[MAX_PASSES];
+int passExpiryCount = 0;
+int passHeapPos[MAX_PASSES]; // Heap position + 1, or 0 when the pass is not in the heap
+
+// Hot-path metrics, exported in Prometheus text format to metrics/metrics.prom
+static const char *opNames[NUM_OPS] = {"park", "unpark", "lookup", "gate", "save", "time_format", "plate_match"};
+static const char *plateResultNames[NUM_PLATE_RESULTS] = {"parked", "unparked", "no_match",
+                                                           "ambiguous", "rejected", "dropped"};
+static const char *saveFileNames[NUM_SAVE_FILES] = {"admin", "vehicles", "owners", "parking", "passes", "forecast"};
+LatencyHistogram opLatency[NUM_OPS];
+LatencyHistogram vehicleLookupProbes;
+LatencyHistogram passLookupProbes;
+LatencyHistogram plateLookupProbes;
+unsigned long long plateReadCount[NUM_PLATE_RESULTS];
+unsigned long long feedPublished = 0;
+unsigned long long feedCoalesced = 0;
+unsigned long long feedOverflows = 0;
+int indexLastProbes = 0; // Probe count of the latest indexFind
+unsigned long long saveCount[NUM_SAVE_FILES];
+unsigned long long bytesWritten[NUM_SAVE_FILES];
+time_t lastMetricsDump = 0;
+
+// Loader diagnostics
+int dataWarnings = 1;      // Off while the self-check feeds the loaders damaged files
+long dataWarningCount = 0; // Records the loaders skipped
+long reconcileFixes = 0;   // Parked-vehicle records corrected by reconcileLot
+
+// Coarse wall clock shared by every time-dependent path (see clockNow)
+time_t clockCurrent = 0;
+int clockIsFake = 0;
+long clockFakeStep = 0; // Seconds a fake clock moves per tick
+
 // Function prototypes
 void initializeSystem();
 void mainMenu();
@@ -115,8 +1007,14 @@ void saveAdminData();
 void loadAdminData();
 void manageVehicles();
 void addVehicle();
+int readOwner();
+void addCoOwner();
 void parkVehicle();
 void unparkVehicle();
+GateResult gateParkVehicle(int vehicleIndex, time_t now);
+void gateOccupySpot(int vehicleIndex, int spotNumber, time_t now, GateResult *result);
+GateResult gateUnparkVehicle(int vehicleIndex, time_t now);
+GateResult gateRemoveVehicle(int vehicleIndex, time_t now);
 void deleteVehicle();
 void saveVehicleData();
 void loadVehicleData();
@@ -127,33 +1025,324 @@ void loadOwnerData();
 void displayOwnerDetails();
 void saveParkingData();
 void loadParkingData();
+void refreshLotState();
+int reconcileLot();
 void displayParkingStatus();
 void generateReport();
+void writeReport(DataWriter *writer, time_t currentTime, int *occupiedOut, double *revenueOut);
 
 // Validation functions
-int isValidName(char *name);
-int isValidEmail(char *email);
-int isValidPhoneNumber(char *phone);
-int isValidPassword(char *password);
-int isValidLicensePlate(char *plate);
+int isValidName(const char *name);
+int isValidEmail(const char *email);
+int isValidPhoneNumber(const char *phone);
+int isValidPassword(const char *password);
+int isValidLicensePlate(const char *plate);
+int isValidVehicleType(const char *type);
+int isValidVehicleId(const char *vehicleId);
+unsigned int validateRecord(const ValidationRecord *record);
+int validateRecords(const ValidationRecord *records, int count, unsigned int *errors);
+void describeValidationErrors(unsigned int errors, char *out, int size);
 void clearInputBuffer();
 int findOwnerById(char *ownerId);
+int findOwnerByPhone(char *phone);
 int findVehicleById(char *vehicleId);
 int findAvailableSpot();
 void generateOwnerId(char *ownerId);
 void generateVehicleId(char *vehicleId);
 double calculateParkingFee(time_t entryTime);
+double calculateParkingFeeAt(time_t entryTime, time_t exitTime, double ratePerHour);
+int occupancyBand(int occupied);
+double entryRatePerHour(time_t now, int occupied);
+int findAvailableSpotInZones(unsigned int zoneMask);
+int getSpotZone(int spotNumber);
+void markSpotFree(int spotIndex, int isFree);
+void rebuildFreeSpots();
+
+// String index functions
+unsigned int hashString(const char *key);
+void indexClear(IndexSlot *slots, int capacity);
+int indexFind(IndexSlot *slots, int capacity, const char *key);
+int indexInsert(IndexSlot *slots, int capacity, const char *key, int value);
+void indexRemove(IndexSlot *slots, int capacity, const char *key);
+
+// Simulator and measurement functions
+void runSimulation(long events, unsigned long long seed, double arrivalsPerHour);
+long runReplay(const char *journal);
+int checkLotInvariants();
+int runSelfCheck(long operations, unsigned long long seed, const char *scratchRoot);
+unsigned long long randomNext(unsigned long long *state);
+double randomUniform(unsigned long long *state);
+double randomExponential(unsigned long long *state, double mean);
+double randomLogNormal(unsigned long long *state, double mean, double sigma);
+long long monotonicNanos();
+time_t clockNow();
+time_t clockTick();
+void clockSet(time_t now);
+int parseFakeClock(const char *text);
+void histogramRecord(LatencyHistogram *hist, unsigned long long value);
+unsigned long long histogramPercentile(LatencyHistogram *hist, double percentile);
+static unsigned long long histogramBucketValue(int bucket);
+void runBenchmarks(long maxFleet, const char *scratchRoot);
+
+// Metrics functions
+void recordSave(int file, long written, long long startNanos);
+void recordOp(int op, long long startNanos);
+void writeMetrics(FILE *fp);
+void dumpMetrics();
+void maybeDumpMetrics();
+
+// Owner <-> vehicle link functions
+void resetOwnerships();
+int addOwnerToIndexes(int ownerIndex);
+int linkOwnerVehicle(int ownerIndex, int vehicleIndex);
+void unlinkVehicleOwners(int vehicleIndex);
+int primaryOwnerOf(int vehicleIndex);
+const char *ownerNameOf(int vehicleIndex);
+int findParkedVehiclesOfOwner(int ownerIndex, int *out, int max);
+void formatOwnerIds(int vehicleIndex, char *out, int size);
+void formatVehicleIds(int ownerIndex, char *out, int size);
+void rebuildVehicleIndex();
+void removeVehicleAt(int vehicleIndex);
+
+// Arena and data file writer functions
+Arena *threadArena();
+void *arenaAlloc(Arena *arena, size_t size);
+ArenaMark arenaMark(Arena *arena);
+void arenaRewind(Arena *arena, ArenaMark mark);
+void arenaReset(Arena *arena);
+int dataWriterOpen(DataWriter *writer, const char *relative, int append);
+void dataWriterPrintf(DataWriter *writer, const char *format, ...);
+void dataWriterBytes(DataWriter *writer, const void *data, size_t size);
+long dataWriterClose(DataWriter *writer);
+
+// Persistence I/O backend functions
+int setIoBackend(const char *name);
+#ifndef _WIN32
+int ioSlotAcquire(DataWriter *writer);
+void ioSubmit(DataWriter *writer, int sync);
+void ioWaitWriter(DataWriter *writer);
+#endif
+
+// Data file reader functions
+int dataReaderOpen(DataReader *reader, const char *relative);
+void dataReaderClose(DataReader *reader);
+int dataReaderNext(DataReader *reader, FieldSpan *fields, int maxFields);
+long dataReaderLastBlock(DataReader *reader);
+void dataReaderWarn(DataReader *reader, const char *problem);
+int spanToText(FieldSpan field, char *out, int size);
+int spanToLong(FieldSpan field, long *out);
+int spanToInt(FieldSpan field, int *out);
+int spanToDouble(FieldSpan field, double *out);
+
+// Bulk registry functions
+void importRegistryMenu();
+void exportRegistryMenu();
+long importRegistryCsv(const char *path);
+long exportRegistryCsv(const char *path);
+
+// Camera plate read functions
+void cameraGateMenu();
+void importPlateReads();
+int enqueuePlateRead(const char *plate, int gate, time_t readAt);
+int processPlateReads(int verbose);
+void canonicalPlate(const char *plate, char *out);
+void plateIndexAdd(int vehicleIndex);
+void invalidatePlateIndex();
+void ensurePlateIndex();
+int matchPlate(const char *plate, int *distanceOut);
+
+// Forecast functions
+int hourOfWeek(time_t t);
+void forecastRecordSession(time_t entryTime, time_t exitTime);
+int forecastWeeks();
+double forecastFreeSpots(time_t now, int minutes, int occupiedNow);
+void saveForecastData();
+void loadForecastData();
+
+// Change feed functions
+int feedSubscribe();
+void feedUnsubscribe(int subscriber);
+void feedPublish(int spotIndex, time_t now);
+void feedResyncAll();
+int feedPoll(int subscriber, SpotEvent *events, int maxEvents);
+void liveDashboardMenu();
+void showDashboardChanges(int fullRedraw);
+
+// Timer wheel and alert functions
+void timerWheelReset(time_t now);
+void timerWheelAdvance(time_t now);
+void timerArm(int t, time_t expiresAt, int kind);
+void timerDisarm(int t);
+void armSpotTimer(int spotIndex, time_t entryTime, time_t now);
+void emitAlert(const AlertEvent *event);
+void alertSinkNone(const AlertEvent *event, const char *line);
+int setAlertSink(const char *target);
+
+// Snapshot and journal functions
+void lotWriteBegin();
+void lotWriteEnd();
+void takeLotSnapshot(LotSnapshot *snapshot);
+void journalRecord(int type, time_t at, int spotNumber, int vehicleIndex, double amount);
+void journalRecordVehicle(int type, time_t at, int spotNumber, const char *vehicleId, const char *licensePlate,
+                          double amount);
+void journalFlush();
+void journalStart();
+long lotStateAsOf(time_t asOf, LotSnapshot *snapshot, time_t *firstEvent);
+void showLotStateAsOf();
+
+// Occupancy history functions
+void recountZones();
+void seriesAdvance(time_t now);
+void seriesReset(time_t now);
+int seriesQuery(int zone, time_t from, time_t to, int bucketMinutes, SeriesPoint *out, int maxPoints);
+void seriesFlush();
+void seriesStart();
+void showOccupancyHistory();
+
+// Entry waitlist functions
+void waitlistClear();
+int waitlistJoin(int vehicleIndex, int waitClass, time_t now);
+void waitlistLeave(int vehicleIndex);
+void waitlistParked(int vehicleIndex, time_t now);
+void waitlistVehicleRemoved(int removed);
+int waitlistPosition(int vehicleIndex);
+long waitlistExpectedWait(int position);
+int waitlistAdmit(time_t now);
+void offerWaitlist(int vehicleIndex, int passStatus, time_t now);
+void announceAdmission(int vehicleIndex);
+void viewWaitlist();
+
+// Search index functions
+void invalidatePlateOrder();
+void ensurePlateOrder();
+void plateOrderAdd(int vehicleIndex);
+void plateOrderRemove(int vehicleIndex);
+int searchPlatePrefix(const char *prefix, int offset, int *out, int max, int *total);
+void ownerTrigramsClear();
+void ownerTrigramsAdd(int ownerIndex);
+int searchOwnerName(const char *text, int offset, int *out, int max, int *total);
+void rebuildEntryOrder();
+void entryOrderAdd(int spotIndex);
+void entryOrderRemove(int spotIndex);
+int searchEntryRange(time_t from, time_t to, int offset, int *out, int max, int *total);
+void searchMenu();
+
+// Site federation functions
+int runShardServer(const char *socketPath);
+int runAggregator(int count, char **paths);
+
+// Monthly pass functions
+void managePasses();
+void viewAllPasses();
+void issuePass();
+void cancelPass();
+void renewPass(int passIdx, int days);
+int allocatePassSlot();
+void activatePass(int passIdx, time_t now, int days);
+void savePassData();
+void loadPassData();
+int quotaPeriodAt(time_t t);
+int checkPassEntitlement(char *vehicleId, time_t now, int *passIdx);
+void sweepExpiredPasses(time_t now);
+void removePass(int passIdx);
+void expirePass(int passIdx);
+void passHeapClear();
+void passHeapPush(int passIdx);
+void passHeapUpdate(int passIdx);
+void passHeapRemove(int passIdx);
+void formatZoneMask(unsigned int zoneMask, char *out);
+unsigned int parseZoneMask(char *text);
+
+// Authentication functions
+void hashPassword(const char *password, char *out);
+int verifyPassword(const char *password, const char *stored);
+void secureRandomBytes(unsigned char *out, int length);
+int createSession(int adminIndex, time_t now, char *tokenOut);
+int authorizeSession(const char *token, time_t now);
+void revokeSession(const char *token);
 
 // Debugging function
 void debugShowAllAdmins();
 
-int main()
+#ifndef FUZZ_LOADERS
+int main(int argc, char *argv[])
 {
+    // One process per site: --site <folder> roots every data file in that folder.
+    // --alerts <none|file|unix:path> picks where overstay alerts go.
+    // --io <sync|thread|uring> picks how data files are written.
+    // --clock <unix time>[+<seconds per tick>] runs on a fake clock.
+    while (argc > 2 && (strcmp(argv[1], "--site") == 0 || strcmp(argv[1], "--alerts") == 0 ||
+                        strcmp(argv[1], "--io") == 0 || strcmp(argv[1], "--clock") == 0))
+    {
+        if (strcmp(argv[1], "--site") == 0)
+        {
+            snprintf(dataRoot, sizeof(dataRoot), "%s", argv[2]);
+        }
+        else if (strcmp(argv[1], "--clock") == 0)
+        {
+            if (!parseFakeClock(argv[2]))
+            {
+                printf("Invalid clock: %s (use <unix time>[+<seconds per tick>])\n", argv[2]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[1], "--io") == 0)
+        {
+            if (!setIoBackend(argv[2]))
+            {
+                printf("Unknown I/O backend: %s (use sync, thread or uring)\n", argv[2]);
+                return 1;
+            }
+        }
+        else if (!setAlertSink(argv[2]))
+        {
+            printf("Unknown alert sink: %s (use none, file or unix:<socket path>)\n", argv[2]);
+            return 1;
+        }
+        argc -= 2;
+        argv += 2;
+    }
+    if (argc > 1 && strcmp(argv[1], "--aggregate") == 0)
+        return runAggregator(argc - 2, argv + 2) < 0;
+
+    // Headless tools run on an in-memory lot and never write the data files
+    if (argc > 1 && strcmp(argv[1], "--simulate") == 0)
+    {
+        long events = argc > 2 ? atol(argv[2]) : 1000000;
+        unsigned long long seed = argc > 3 ? strtoull(argv[3], NULL, 10) : 42;
+        double arrivalsPerHour = argc > 4 ? atof(argv[4]) : 30.0;
+        runSimulation(events, seed, arrivalsPerHour);
+        return 0;
+    }
+    if (argc > 1 && strcmp(argv[1], "--replay") == 0)
+        return runReplay(argc > 2 ? argv[2] : NULL) != 0;
+    if (argc > 1 && strcmp(argv[1], "--selfcheck") == 0)
+    {
+        long operations = argc > 2 ? atol(argv[2]) : 20000;
+        unsigned long long seed = argc > 3 ? strtoull(argv[3], NULL, 10) : 42;
+        return runSelfCheck(operations, seed, argc > 4 ? argv[4] : "selfcheck_data") != 0;
+    }
+    if (argc > 1 && strcmp(argv[1], "--bench") == 0)
+    {
+        long maxFleet = argc > 2 ? atol(argv[2]) : 1000000;
+        runBenchmarks(maxFleet, argc > 3 ? argv[3] : "bench_data");
+        return 0;
+    }
+
     createFolders();
     initializeSystem();
+
+    // Site onboarding: load or dump the registry without going through the menus
+    if (argc > 2 && strcmp(argv[1], "--import") == 0)
+        return importRegistryCsv(argv[2]) < 0;
+    if (argc > 2 && strcmp(argv[1], "--export") == 0)
+        return exportRegistryCsv(argv[2]) < 0;
+    if (argc > 1 && strcmp(argv[1], "--serve") == 0)
+        return runShardServer(argc > 2 ? argv[2] : NULL) < 0;
     mainMenu();
     return 0;
 }
+#endif
 
 // Initialize the system
 void initializeSystem()
@@ -165,13 +1354,32 @@ void initializeSystem()
         strcpy(spots[i].vehicleId, "");
         spots[i].entryTime = 0;
         spots[i].parkingFee = 0.0;
+        spots[i].isPassSession = 0;
+        spots[i].ratePerHour = 0.0;
     }
+    occupiedCount = 0;
+    rebuildFreeSpots();
+    recountZones();
+    rebuildEntryOrder();
+    timerWheelReset(clockNow());
+    for (int i = 0; i < MAX_SESSIONS; i++)
+        sessions[i].adminIndex = -1;
+    indexClear(sessionIndex, SESSION_INDEX_SIZE);
+
     loadAdminData();
     loadOwnerData();
     loadVehicleData();
     loadParkingData();
+    int fixes = reconcileLot();
+    if (fixes > 0)
+        printf("WARNING: %d parked-vehicle record(s) disagreed with the parking file and were corrected.\n", fixes);
+    loadPassData();
+    loadForecastData();
+    journalStart();
+    seriesStart();
 
     printf("=== Parking Lot Management System Initialized ===\n");
+    printf("Lot Profile: %s (%d zone(s)%s)\n", LOT_PROFILE_NAME, NUM_ZONES, SURGE_PRICING ? "" : ", flat rate");
     printf("Total Parking Spots: %d\n", MAX_PARKING_SPOTS);
     printf("Registered Admins: %d\n", numAdmins);
     printf("Registered Vehicles: %d\n", numVehicles);
@@ -210,6 +1418,7 @@ void mainMenu()
             registerAdmin();
             break;
         case 3:
+            dumpMetrics();
             printf("Goodbye.!\n");
             exit(0);
         default:
@@ -319,7 +1528,8 @@ void registerAdmin()
 
         if (isValidPassword(temp_input))
         {
-            strcpy(admins[numAdmins].password, temp_input);
+            hashPassword(temp_input, admins[numAdmins].passwordHash);
+            memset(temp_input, 0, sizeof(temp_input));
             break;
         }
         else
@@ -376,14 +1586,25 @@ int loginAdmin()
     }
     input_password[strcspn(input_password, "\n")] = 0;
 
-    for (int i = 0; i < numAdmins; i++)
+    // Only the named admin is hashed; unknown names hash against a dummy so timing matches
+    static char dummyHash[PASSWORD_HASH_LEN] = "";
+    if (dummyHash[0] == 0)
+        hashPassword("dummy password", dummyHash);
+
+    int matched = -1;
+    for (int i = 0; i < numAdmins && matched == -1; i++)
     {
-        if (strcmp(admins[i].name, input_name) == 0 &&
-            strcmp(admins[i].password, input_password) == 0)
-        {
-            printf("Login successful! Welcome, %s!\n", admins[i].name);
-            return 1;
-        }
+        if (strcmp(admins[i].name, input_name) == 0)
+            matched = i;
+    }
+    int verified = verifyPassword(input_password, matched != -1 ? admins[matched].passwordHash : dummyHash);
+    memset(input_password, 0, sizeof(input_password));
+
+    if (matched != -1 && verified)
+    {
+        createSession(matched, clockTick(), currentSessionToken);
+        printf("Login successful! Welcome, %s!\n", admins[matched].name);
+        return 1;
     }
     printf("ERROR: No matching admin found.\n");
     printf("Please check your owner name and password.\n");
@@ -396,12 +1617,22 @@ void adminMenu()
     int choice;
     while (1)
     {
+        // Each request starts with an empty arena; nothing outlives the request that made it
+        arenaReset(threadArena());
+        timerWheelAdvance(clockNow());
         printf("\n========== ADMIN PANEL ==========\n");
         printf("1. Manage Vehicles\n");
         printf("2. View Parking Status\n");
         printf("3. Generate Report\n");
         printf("4. View All Owners\n");
-        printf("5. Logout\n");
+        printf("5. Manage Passes\n");
+        printf("6. Owner Details\n");
+        printf("7. Camera Plate Reads\n");
+        printf("8. Live Dashboard\n");
+        printf("9. Lot State At A Past Time\n");
+        printf("10. Occupancy History\n");
+        printf("11. Search\n");
+        printf("12. Logout\n");
         printf("=================================\n");
         printf("Enter your choice: ");
 
@@ -412,6 +1643,14 @@ void adminMenu()
             continue;
         }
         clearInputBuffer();
+
+        // Every action is authorized by a cached session lookup, not a password hash
+        if (authorizeSession(currentSessionToken, clockTick()) == -1)
+        {
+            printf("Session expired. Please login again.\n");
+            return;
+        }
+
         switch (choice)
         {
         case 1:
@@ -427,6 +1666,29 @@ void adminMenu()
             viewAllOwners();
             break;
         case 5:
+            managePasses();
+            break;
+        case 6:
+            displayOwnerDetails();
+            break;
+        case 7:
+            cameraGateMenu();
+            break;
+        case 8:
+            liveDashboardMenu();
+            break;
+        case 9:
+            showLotStateAsOf();
+            break;
+        case 10:
+            showOccupancyHistory();
+            break;
+        case 11:
+            searchMenu();
+            break;
+        case 12:
+            dumpMetrics();
+            revokeSession(currentSessionToken);
             printf("Logged out successfully.\n");
             return;
         default:
@@ -435,74 +1697,80 @@ void adminMenu()
     }
 }
 
-// Admin Data Append
+// Admin Data Write (rewritten in full so no old clear-text snapshot survives)
 void saveAdminData()
 {
-    FILE *fp = fopen("admin/data.txt", "a");
-    if (fp == NULL)
+    long long t0 = monotonicNanos();
+    DataWriter writer;
+    if (!dataWriterOpen(&writer, "admin/data.txt", 0))
     {
         printf("ERROR: Cannot create/open admin data file!\n");
         return;
     }
-
-    fprintf(fp, "%d\n", numAdmins);
+    dataWriterPrintf(&writer, "%d\n", numAdmins);
     for (int i = 0; i < numAdmins; i++)
     {
-        fprintf(fp, "%s|%s|%s|%s\n",
+        dataWriterPrintf(&writer, "%s|%s|%s|%s\n",
                 admins[i].name,
                 admins[i].phoneNumber,
                 admins[i].email,
-                admins[i].password);
+                admins[i].passwordHash);
     }
 
-    fclose(fp);
+    long written = dataWriterClose(&writer);
+    recordSave(SAVE_ADMIN, written, t0);
 }
 
 // Admin Data Read
 void loadAdminData()
 {
-    FILE *fp = fopen("admin/data.txt", "r");
-    if (fp == NULL)
+    numAdmins = 0;
+
+    DataReader reader;
+    if (!dataReaderOpen(&reader, "admin/data.txt"))
     {
-        numAdmins = 0;
         return;
     }
 
-    if (fscanf(fp, "%d", &numAdmins) != 1)
+    // Older versions appended a full snapshot per save; the last block is the current one
+    // name|phone|email|password hash
+    FieldSpan field[4];
+    long count = dataReaderLastBlock(&reader);
+    for (long n = 0; n < count && numAdmins < MAX_ADMINS; n++)
     {
-        numAdmins = 0;
-        fclose(fp);
-        return;
+        int fields = dataReaderNext(&reader, field, 4);
+        Admin *admin = &admins[numAdmins];
+        if (fields < 4 || field[0].length == 0 ||
+            !spanToText(field[0], admin->name, sizeof(admin->name)) ||
+            !spanToText(field[1], admin->phoneNumber, sizeof(admin->phoneNumber)) ||
+            !spanToText(field[2], admin->email, sizeof(admin->email)) ||
+            !spanToText(field[3], admin->passwordHash, sizeof(admin->passwordHash)))
+        {
+            dataReaderWarn(&reader, "missing or oversized field");
+            continue;
+        }
+        numAdmins++;
     }
 
-    char line[500];
-    fgets(line, sizeof(line), fp); // consume newline
+    dataReaderClose(&reader);
 
+    // Files from older versions hold clear-text passwords: hash them and rewrite
+    int migrated = 0;
     for (int i = 0; i < numAdmins; i++)
     {
-        if (fgets(line, sizeof(line), fp) == NULL)
-            break;
-
-        line[strcspn(line, "\n")] = 0;
-
-        char *token = strtok(line, "|");
-        if (token)
-            strcpy(admins[i].name, token);
-
-        token = strtok(NULL, "|");
-        if (token)
-            strcpy(admins[i].phoneNumber, token);
-
-        token = strtok(NULL, "|");
-        if (token)
-            strcpy(admins[i].email, token);
-
-        token = strtok(NULL, "|");
-        if (token)
-            strcpy(admins[i].password, token);
+        if (strncmp(admins[i].passwordHash, "pbkdf2$", 7) != 0)
+        {
+            char plain[PASSWORD_HASH_LEN];
+            strcpy(plain, admins[i].passwordHash);
+            hashPassword(plain, admins[i].passwordHash);
+            memset(plain, 0, sizeof(plain));
+            migrated = 1;
+        }
+    }
+    if (migrated)
+    {
+        saveAdminData();
     }
-
-    fclose(fp);
 }
 
 // Manage vehicles menu
@@ -517,7 +1785,11 @@ void manageVehicles()
         printf("3. Park Vehicle\n");
         printf("4. Unpark Vehicle\n");
         printf("5. Delete Vehicles\n");
-        printf("6. Back to Admin Menu\n");
+        printf("6. Add Co-Owner to Vehicle\n");
+        printf("7. Import Vehicles From CSV\n");
+        printf("8. Export Vehicles To CSV\n");
+        printf("9. Entry Waitlist\n");
+        printf("10. Back to Admin Menu\n");
         printf("Enter choice: ");
 
         if (scanf("%d", &choice) != 1)
@@ -546,6 +1818,18 @@ void manageVehicles()
             deleteVehicle();
             break;
         case 6:
+            addCoOwner();
+            break;
+        case 7:
+            importRegistryMenu();
+            break;
+        case 8:
+            exportRegistryMenu();
+            break;
+        case 9:
+            viewWaitlist();
+            break;
+        case 10:
             return;
         default:
             printf("Invalid choice.\n");
@@ -559,10 +1843,13 @@ void addVehicle()
 
     char vehicleId[VEHICLE_ID_LEN];
     char licensePlate[LICENSE_PLATE_LEN];
-    char ownerName[NAME_LEN];
     char vehicleType[VEHICLE_TYPE_LEN];
-    int ownerId;
-    char temp_input[200];
+
+    if (numVehicles >= MAX_VEHICLES)
+    {
+        printf("ERROR: Maximum number of vehicles reached.\n");
+        return;
+    }
 
     // Get license plate
     printf("Enter License Plate: ");
@@ -580,81 +1867,146 @@ void addVehicle()
     fgets(vehicleType, sizeof(vehicleType), stdin);
     vehicleType[strcspn(vehicleType, "\n")] = 0;
 
-    // Get owner name
-    while (1)
+    // Owner is looked up by phone number, so one owner can register many vehicles
+    int ownerIndex = readOwner();
+    if (ownerIndex == -1)
     {
-        printf("Enter Owner Name: ");
-        if (fgets(temp_input, sizeof(temp_input), stdin) == NULL)
-        {
-            printf("Error reading input. Please try again.\n");
-            continue;
-        }
-
-        // Remove newline character
-        temp_input[strcspn(temp_input, "\n")] = 0;
+        return;
+    }
 
-        // Trim leading spaces
-        char *start = temp_input;
-        while (*start == ' ')
-            start++;
-        char *end = start + strlen(start) - 1;
-        while (end > start && *end == ' ')
-            end--;
-        *(end + 1) = 0;
+    // Generate unique vehicle ID
+    generateVehicleId(vehicleId);
+    strcpy(vehicles[numVehicles].vehicleId, vehicleId);
+    strcpy(vehicles[numVehicles].licensePlate, licensePlate);
+    strcpy(vehicles[numVehicles].vehicleType, vehicleType);
 
-        if (isValidName(start))
+    vehicles[numVehicles].isParked = 0;
+    vehicles[numVehicles].spotNumber = 0;
+    vehicles[numVehicles].entryTime = 0;
+    vehicleFirstLink[numVehicles] = -1;
+    indexInsert(vehicleIdIndex, VEHICLE_INDEX_SIZE, vehicleId, numVehicles);
+    plateIndexAdd(numVehicles);
+    plateOrderAdd(numVehicles);
+    linkOwnerVehicle(ownerIndex, numVehicles); // Link vehicle to owner
+
+    numVehicles++;
+    saveVehicleData();
+    saveOwnerData();
+
+    printf("Vehicle added successfully. ID: %s\n", vehicleId);
+}
+
+// Ask for an owner's phone number; reuse the registered owner or create a new one.
+// Returns the owner index, or -1 when no owner can be created.
+int readOwner()
+{
+    char temp_input[200];
+    char phone[CONTACT_LEN];
+
+    // Get owner phone number
+    while (1)
+    {
+        printf("Enter Owner Phone Number (exactly 11 digits starting with '01'): ");
+        if (fgets(temp_input, sizeof(temp_input), stdin) == NULL)
         {
-            strcpy(owners[numOwners].name, start);
+            printf("Error reading input. Please try again.\n");
+            continue;
+        }
+        temp_input[strcspn(temp_input, "\n")] = 0;
+
+        if (isValidPhoneNumber(temp_input))
+        {
+            strcpy(phone, temp_input);
             break;
         }
         else
         {
-            printf("Invalid name. Please enter a valid name (letters and spaces only).\n");
+            printf("Invalid phone number. Must be exactly 11 digits starting with '01'.\n");
         }
     }
-    generateOwnerId(owners[numOwners].ownerId);
 
-    // Get owner phone number
+    int ownerIndex = findOwnerByPhone(phone);
+    if (ownerIndex != -1)
+    {
+        printf("Existing owner found: %s (%s)\n", owners[ownerIndex].name, owners[ownerIndex].ownerId);
+        return ownerIndex;
+    }
+
+    if (numOwners >= MAX_OWNERS)
+    {
+        printf("ERROR: Maximum number of owners reached.\n");
+        return -1;
+    }
+
+    // Get owner name
     while (1)
     {
-        printf("Enter Phone Number (exactly 11 digits starting with '01'): ");
+        printf("Enter Owner Name: ");
         if (fgets(temp_input, sizeof(temp_input), stdin) == NULL)
         {
             printf("Error reading input. Please try again.\n");
             continue;
         }
+
+        // Remove newline character
         temp_input[strcspn(temp_input, "\n")] = 0;
 
-        if (isValidPhoneNumber(temp_input))
+        // Trim leading spaces
+        char *start = temp_input;
+        while (*start == ' ')
+            start++;
+        char *end = start + strlen(start) - 1;
+        while (end > start && *end == ' ')
+            end--;
+        *(end + 1) = 0;
+
+        if (isValidName(start))
         {
-            strcpy(owners[numOwners].phoneNumber, temp_input);
+            strcpy(owners[numOwners].name, start);
             break;
         }
         else
         {
-            printf("Invalid phone number. Must be exactly 11 digits starting with '01'.\n");
+            printf("Invalid name. Please enter a valid name (letters and spaces only).\n");
         }
     }
+    generateOwnerId(owners[numOwners].ownerId);
+    strcpy(owners[numOwners].phoneNumber, phone);
+    return addOwnerToIndexes(numOwners++);
+}
 
-    // Generate unique vehicle ID
-    generateVehicleId(vehicleId);
-    strcpy(vehicles[numVehicles].vehicleId, vehicleId);
-    strcpy(vehicles[numVehicles].licensePlate, licensePlate);
-    strcpy(vehicles[numVehicles].ownerName, owners[numOwners].name);
-    strcpy(vehicles[numVehicles].vehicleType, vehicleType);
-    strcpy(vehicles[numVehicles].ownerPhoneNumber, owners[numOwners].phoneNumber);
-    strcpy(vehicles[numVehicles].ownerId, owners[numOwners].ownerId); // Link vehicle to owner
+// Link one more owner to an existing vehicle (co-ownership, fleet accounts)
+void addCoOwner()
+{
+    char vehicleId[VEHICLE_ID_LEN];
+    printf("Enter Vehicle ID: ");
+    if (fgets(vehicleId, sizeof(vehicleId), stdin) == NULL)
+    {
+        printf("Error reading vehicle ID.\n");
+        return;
+    }
+    vehicleId[strcspn(vehicleId, "\n")] = 0;
 
-    numOwners++;
-    vehicles[numVehicles].isParked = 0;
-    vehicles[numVehicles].spotNumber = 0;
-    vehicles[numVehicles].entryTime = 0;
+    int vehicleIndex = findVehicleById(vehicleId);
+    if (vehicleIndex == -1)
+    {
+        printf("ERROR: Vehicle not found.\n");
+        return;
+    }
 
-    numVehicles++;
+    int ownerIndex = readOwner();
+    if (ownerIndex == -1)
+    {
+        return;
+    }
+    if (!linkOwnerVehicle(ownerIndex, vehicleIndex))
+    {
+        printf("ERROR: Owner is already linked or no link space left.\n");
+        return;
+    }
     saveVehicleData();
     saveOwnerData();
-
-    printf("Vehicle added successfully. ID: %s\n", vehicleId);
+    printf("Owner %s linked to vehicle %s.\n", owners[ownerIndex].ownerId, vehicleId);
 }
 
 // Park a vehicle
@@ -676,42 +2028,80 @@ void parkVehicle()
     }
     vehicleId[strcspn(vehicleId, "\n")] = 0;
 
+    long long t0 = monotonicNanos();
     int vehicleIndex = findVehicleById(vehicleId);
+    recordOp(OP_LOOKUP, t0);
     if (vehicleIndex == -1)
     {
         printf("ERROR: Vehicle not found.\n");
         return;
     }
 
-    if (vehicles[vehicleIndex].isParked)
+    long long gateStart = monotonicNanos();
+    time_t now = clockTick();
+    GateResult result = gateParkVehicle(vehicleIndex, now);
+    recordOp(OP_GATE, gateStart);
+
+    if (result.passStatus == PASS_OK && !result.isPassSession && result.status == GATE_OK)
     {
-        printf("ERROR: Vehicle is already parked in spot %d.\n", vehicles[vehicleIndex].spotNumber);
-        return;
+        printf("NOTE: No free spot in the pass zones, regular fee applies.\n");
+    }
+    else if (result.passStatus == PASS_QUOTA_EXHAUSTED)
+    {
+        printf("NOTE: Monthly pass quota used up, regular fee applies.\n");
+    }
+    else if (result.passStatus == PASS_NOT_YET_VALID)
+    {
+        printf("NOTE: Monthly pass is not valid yet, regular fee applies.\n");
     }
 
-    int availableSpot = findAvailableSpot();
-    if (availableSpot == -1)
+    if (result.status == GATE_ALREADY_PARKED)
+    {
+        printf("ERROR: Vehicle is already parked in spot %d.\n", result.spotNumber);
+        return;
+    }
+    if (result.status == GATE_LOT_FULL)
     {
         printf("ERROR: No available parking spots.\n");
+        offerWaitlist(vehicleIndex, result.passStatus, now);
         return;
     }
 
-    // Mark vehicle as parked
-    vehicles[vehicleIndex].isParked = 1;
-    vehicles[vehicleIndex].spotNumber = availableSpot;
-    vehicles[vehicleIndex].entryTime = time(NULL);
-
-    spots[availableSpot - 1].isOccupied = 1;
-    strcpy(spots[availableSpot - 1].vehicleId, vehicleId);
-    spots[availableSpot - 1].entryTime = time(NULL);
+    if (result.isPassSession)
+    {
+        savePassData();
+    }
     saveVehicleData();
     saveParkingData();
 
+    int passIdx = result.passIdx;
     printf("*** VEHICLE PARKED SUCCESSFULLY! ***\n");
     printf("Vehicle ID: %s\n", vehicleId);
     printf("License Plate: %s\n", vehicles[vehicleIndex].licensePlate);
-    printf("Parking Spot: %d\n", availableSpot);
-    printf("Entry Time: %s", ctime(&vehicles[vehicleIndex].entryTime));
+    printf("Parking Spot: %d (Zone %c)\n", result.spotNumber, 'A' + getSpotZone(result.spotNumber));
+    if (result.isPassSession)
+    {
+        if (passes[passIdx].monthlyQuota > 0)
+        {
+            printf("Pass: %s (entry %d of %d this month)\n", passes[passIdx].holderName,
+                   passes[passIdx].entriesThisMonth, passes[passIdx].monthlyQuota);
+        }
+        else
+        {
+            printf("Pass: %s (unlimited entries)\n", passes[passIdx].holderName);
+        }
+    }
+    long long formatStart = monotonicNanos();
+    char *entryText = ctime(&vehicles[vehicleIndex].entryTime);
+    recordOp(OP_TIME_FORMAT, formatStart);
+    printf("Entry Time: %s", entryText);
+    if (!result.isPassSession)
+    {
+        printf("Hourly Rate: TK- %.2f/= (locked until exit)\n", result.ratePerHour);
+    }
+
+    recordOp(OP_PARK, t0);
+    maybeDumpMetrics();
 }
 
 // Unpark a vehicle
@@ -728,40 +2118,158 @@ void unparkVehicle()
     }
     vehicleId[strcspn(vehicleId, "\n")] = 0;
 
+    long long t0 = monotonicNanos();
     int vehicleIndex = findVehicleById(vehicleId);
+    recordOp(OP_LOOKUP, t0);
     if (vehicleIndex == -1)
     {
         printf("ERROR: Vehicle not found.\n");
         return;
     }
 
-    if (!vehicles[vehicleIndex].isParked)
+    long long gateStart = monotonicNanos();
+    GateResult result = gateUnparkVehicle(vehicleIndex, clockTick());
+    recordOp(OP_GATE, gateStart);
+    if (result.status == GATE_NOT_PARKED)
     {
         printf("ERROR: Vehicle is not currently parked.\n");
         return;
     }
-    int spotNumber = vehicles[vehicleIndex].spotNumber;
-    double parkingFee = calculateParkingFee(vehicles[vehicleIndex].entryTime);
-
-    // Mark vehicle as unparked
-    vehicles[vehicleIndex].isParked = 0;
-    int oldSpotNumber = vehicles[vehicleIndex].spotNumber;
-    vehicles[vehicleIndex].spotNumber = 0;
-    vehicles[vehicleIndex].entryTime = 0;
-
-    spots[oldSpotNumber - 1].isOccupied = 0;
-    strcpy(spots[oldSpotNumber - 1].vehicleId, "");
-    spots[oldSpotNumber - 1].entryTime = 0;
-    spots[oldSpotNumber - 1].parkingFee = parkingFee;
     saveVehicleData();
     saveParkingData();
+    saveForecastData();
 
     printf("*** VEHICLE UNPARKED SUCCESSFULLY! ***\n");
     printf("Vehicle ID: %s\n", vehicleId);
     printf("License Plate: %s\n", vehicles[vehicleIndex].licensePlate);
-    printf("Parking Spot: %d (now available)\n", spotNumber);
-    printf("Parking Fee: TK- %.2f/=\n", parkingFee);
+    printf("Parking Spot: %d (now available)\n", result.spotNumber);
+    if (!result.isPassSession)
+    {
+        printf("Hourly Rate: TK- %.2f/= (locked at entry)\n", result.ratePerHour);
+    }
+    printf("Parking Fee: TK- %.2f/=\n", result.fee);
     printf("Thank you for using our parking service!\n");
+    announceAdmission(result.admittedIndex);
+
+    recordOp(OP_UNPARK, t0);
+    maybeDumpMetrics();
+}
+
+// Gate engine: state changes only, no console or file I/O (shared by menus and simulator)
+GateResult gateParkVehicle(int vehicleIndex, time_t now)
+{
+    GateResult result = {GATE_OK, 0, -1, PASS_NONE, 0, 0.0, 0.0, -1};
+
+    if (vehicles[vehicleIndex].isParked)
+    {
+        result.status = GATE_ALREADY_PARKED;
+        result.spotNumber = vehicles[vehicleIndex].spotNumber;
+        return result;
+    }
+
+    // Pass holders are parked inside their entitled zones free of charge
+    int availableSpot = -1;
+    result.passStatus = checkPassEntitlement(vehicles[vehicleIndex].vehicleId, now, &result.passIdx);
+    if (result.passStatus == PASS_OK)
+    {
+        availableSpot = findAvailableSpotInZones(passes[result.passIdx].zoneMask);
+        result.isPassSession = availableSpot != -1;
+    }
+    if (availableSpot == -1)
+    {
+        availableSpot = findAvailableSpot();
+    }
+    if (availableSpot == -1)
+    {
+        result.status = GATE_LOT_FULL;
+        return result;
+    }
+
+    if (result.isPassSession)
+    {
+        passes[result.passIdx].entriesThisMonth++;
+    }
+
+    gateOccupySpot(vehicleIndex, availableSpot, now, &result);
+    return result;
+}
+
+// Parks a vehicle in a spot already chosen and known to be free. The caller
+// sets result->isPassSession; the rate and spot number are filled in here.
+void gateOccupySpot(int vehicleIndex, int spotNumber, time_t now, GateResult *result)
+{
+    // Mark vehicle as parked
+    seriesAdvance(now);
+    lotWriteBegin();
+    vehicles[vehicleIndex].isParked = 1;
+    vehicles[vehicleIndex].spotNumber = spotNumber;
+    vehicles[vehicleIndex].entryTime = now;
+
+    spots[spotNumber - 1].isOccupied = 1;
+    markSpotFree(spotNumber - 1, 0);
+    strcpy(spots[spotNumber - 1].vehicleId, vehicles[vehicleIndex].vehicleId);
+    spots[spotNumber - 1].entryTime = now;
+    spots[spotNumber - 1].isPassSession = result->isPassSession;
+    entryOrderAdd(spotNumber - 1);
+
+    // The rate is fixed now, from the occupancy the driver sees at the gate
+    result->ratePerHour = result->isPassSession ? 0.0 : entryRatePerHour(now, occupiedCount);
+    spots[spotNumber - 1].ratePerHour = result->ratePerHour;
+    occupiedCount++;
+    zoneOccupied[getSpotZone(spotNumber)]++;
+    feedPublish(spotNumber - 1, now);
+    armSpotTimer(spotNumber - 1, now, now);
+    lotWriteEnd();
+    journalRecord(JOURNAL_PARK, now, spotNumber, vehicleIndex, result->ratePerHour);
+    waitlistParked(vehicleIndex, now);
+
+    result->spotNumber = spotNumber;
+}
+
+GateResult gateUnparkVehicle(int vehicleIndex, time_t now)
+{
+    GateResult result = {GATE_OK, 0, -1, PASS_NONE, 0, 0.0, 0.0, -1};
+
+    if (!vehicles[vehicleIndex].isParked)
+    {
+        result.status = GATE_NOT_PARKED;
+        return result;
+    }
+    int spotNumber = vehicles[vehicleIndex].spotNumber;
+    result.spotNumber = spotNumber;
+    result.isPassSession = spots[spotNumber - 1].isPassSession;
+    if (!result.isPassSession)
+    {
+        result.ratePerHour = spots[spotNumber - 1].ratePerHour;
+        result.fee = calculateParkingFeeAt(vehicles[vehicleIndex].entryTime, now, result.ratePerHour);
+    }
+    forecastRecordSession(vehicles[vehicleIndex].entryTime, now);
+
+    // Mark vehicle as unparked
+    seriesAdvance(now);
+    lotWriteBegin();
+    vehicles[vehicleIndex].isParked = 0;
+    vehicles[vehicleIndex].spotNumber = 0;
+    vehicles[vehicleIndex].entryTime = 0;
+
+    entryOrderRemove(spotNumber - 1);
+    spots[spotNumber - 1].isOccupied = 0;
+    markSpotFree(spotNumber - 1, 1);
+    strcpy(spots[spotNumber - 1].vehicleId, "");
+    spots[spotNumber - 1].entryTime = 0;
+    spots[spotNumber - 1].parkingFee = result.fee;
+    spots[spotNumber - 1].isPassSession = 0;
+    spots[spotNumber - 1].ratePerHour = 0.0;
+    occupiedCount--;
+    zoneOccupied[getSpotZone(spotNumber)]--;
+    feedPublish(spotNumber - 1, now);
+    timerDisarm(SPOT_TIMER(spotNumber - 1));
+    lotWriteEnd();
+    journalRecord(JOURNAL_UNPARK, now, spotNumber, vehicleIndex, result.fee);
+
+    // The released spot goes straight to the next waiting car
+    result.admittedIndex = waitlistAdmit(now);
+    return result;
 }
 
 // Delete Vehicle
@@ -798,23 +2306,14 @@ void deleteVehicle()
 
     if (confirm == 'y' || confirm == 'Y')
     {
-        if (vehicles[vehicleIndex].isParked)
-        {
-            spots[vehicles[vehicleIndex].spotNumber - 1].isOccupied = 0;
-            strcpy(spots[vehicles[vehicleIndex].spotNumber - 1].vehicleId, "");
-        }
-
-        // Shift vehicles array
-        for (int i = vehicleIndex; i < numVehicles - 1; i++)
-        {
-            vehicles[i] = vehicles[i + 1];
-        }
-        numVehicles--;
-
+        GateResult result = gateRemoveVehicle(vehicleIndex, clockTick());
+        if (result.passIdx != -1)
+            savePassData();
         saveVehicleData();
         saveOwnerData();
         saveParkingData();
         printf("Vehicle deleted successfully.\n");
+        announceAdmission(result.admittedIndex);
     }
     else
     {
@@ -822,95 +2321,179 @@ void deleteVehicle()
     }
 }
 
+// Removes a vehicle from the registry, freeing its spot (for the next waiting
+// car) and dropping its pass. No I/O, like the rest of the gate engine.
+GateResult gateRemoveVehicle(int vehicleIndex, time_t now)
+{
+    GateResult result = {GATE_OK, 0, -1, PASS_NONE, 0, 0.0, 0.0, -1};
+    int wasParked = vehicles[vehicleIndex].isParked;
+    // The journal entry is queued after the write section, when the vehicle is gone
+    char vehicleId[VEHICLE_ID_LEN], licensePlate[LICENSE_PLATE_LEN];
+    strcpy(vehicleId, vehicles[vehicleIndex].vehicleId);
+    strcpy(licensePlate, vehicles[vehicleIndex].licensePlate);
+    seriesAdvance(now);
+    lotWriteBegin();
+    if (wasParked)
+    {
+        result.spotNumber = vehicles[vehicleIndex].spotNumber;
+        entryOrderRemove(result.spotNumber - 1);
+        spots[result.spotNumber - 1].isOccupied = 0;
+        markSpotFree(result.spotNumber - 1, 1);
+        strcpy(spots[result.spotNumber - 1].vehicleId, "");
+        spots[result.spotNumber - 1].entryTime = 0;
+        spots[result.spotNumber - 1].isPassSession = 0;
+        spots[result.spotNumber - 1].ratePerHour = 0.0;
+        occupiedCount--;
+        zoneOccupied[getSpotZone(result.spotNumber)]--;
+        feedPublish(result.spotNumber - 1, now);
+        timerDisarm(SPOT_TIMER(result.spotNumber - 1));
+    }
+
+    // A deleted vehicle loses its pass
+    result.passIdx = indexFind(passIndex, PASS_INDEX_SIZE, vehicles[vehicleIndex].vehicleId);
+    if (result.passIdx != -1)
+        removePass(result.passIdx);
+
+    removeVehicleAt(vehicleIndex);
+    lotWriteEnd();
+    if (wasParked)
+    {
+        journalRecordVehicle(JOURNAL_REMOVE, now, result.spotNumber, vehicleId, licensePlate, 0.0);
+        result.admittedIndex = waitlistAdmit(now);
+    }
+    return result;
+}
+
 // Vehicle Data Append
 void saveVehicleData()
 {
-    FILE *fp = fopen("vehicles/data.txt", "a");
-    if (fp == NULL)
+    long long t0 = monotonicNanos();
+    DataWriter writer;
+    if (!dataWriterOpen(&writer, "vehicles/data.txt", 1))
     {
         printf("ERROR: Cannot create/open vehicle data file!\n");
         return;
     }
-
-    fprintf(fp, "%d\n", numVehicles);
+    // Owners are linked by ID only; their names and phones live in the owner file
+    dataWriterPrintf(&writer, "%d\n", numVehicles);
     for (int i = 0; i < numVehicles; i++)
     {
-        fprintf(fp, "%s|%s|%s|%s|%d|%d|%s|%ld\n",
+        char ownerIds[200];
+        formatOwnerIds(i, ownerIds, sizeof(ownerIds));
+        dataWriterPrintf(&writer, "%s|%s|%s|%d|%d|%ld|%s\n",
                 vehicles[i].vehicleId,
                 vehicles[i].licensePlate,
-                vehicles[i].ownerName,
                 vehicles[i].vehicleType,
                 vehicles[i].isParked,
                 vehicles[i].spotNumber,
-                vehicles[i].ownerPhoneNumber,
-                vehicles[i].entryTime);
+                vehicles[i].entryTime,
+                ownerIds);
     }
 
-    fclose(fp);
+    long written = dataWriterClose(&writer);
+    recordSave(SAVE_VEHICLES, written, t0);
 }
 
-// Vehicle Data Read
+// Vehicle Data Read (owners must be loaded first, links are rebuilt here)
 void loadVehicleData()
 {
-    FILE *fp = fopen("vehicles/data.txt", "r");
-    if (fp == NULL)
-    {
-        numVehicles = 0;
-        return;
-    }
-
-    if (fscanf(fp, "%d", &numVehicles) != 1)
+    lotWriteBegin();
+    resetOwnerships();
+    waitlistClear(); // Waiting places refer to vehicle positions, which a load renumbers
+    indexClear(vehicleIdIndex, VEHICLE_INDEX_SIZE);
+    numVehicles = 0;
+
+    DataReader reader;
+    if (!dataReaderOpen(&reader, "vehicles/data.txt"))
     {
-        numVehicles = 0;
-        fclose(fp);
+        lotWriteEnd();
         return;
     }
 
-    char line[1000];
-    fgets(line, sizeof(line), fp); // consume newline
-
-    for (int i = 0; i < numVehicles; i++)
+    // id|plate|type|parked|spot|entry time|owner ids
+    // Older files carry the owner's name and phone instead of (or besides) the IDs:
+    // id|plate|owner name|type|parked|spot|owner phone|entry time[|owner ids]
+    FieldSpan field[9];
+    long count = dataReaderLastBlock(&reader);
+    for (long n = 0; n < count && numVehicles < MAX_VEHICLES; n++)
     {
-        if (fgets(line, sizeof(line), fp) == NULL)
-            break;
-
-        line[strcspn(line, "\n")] = 0;
-
-        char *token = strtok(line, "|");
-        if (token)
-            strcpy(vehicles[i].vehicleId, token);
-
-        token = strtok(NULL, "|");
-        if (token)
-            strcpy(vehicles[i].licensePlate, token);
-
-        token = strtok(NULL, "|");
-        if (token)
-            strcpy(vehicles[i].ownerName, token);
-
-        token = strtok(NULL, "|");
-        if (token)
-            strcpy(vehicles[i].vehicleType, token);
-
-        token = strtok(NULL, "|");
-        if (token)
-            vehicles[i].isParked = atoi(token);
-
-        token = strtok(NULL, "|");
-        if (token)
-            vehicles[i].spotNumber = atoi(token);
+        int fields = dataReaderNext(&reader, field, 9);
+        int legacy = fields != 7;
+        int typeField = legacy ? 3 : 2, parkedField = legacy ? 4 : 3, spotField = legacy ? 5 : 4;
+        int entryField = legacy ? 7 : 5, idsField = legacy ? 8 : 6;
+        int i = numVehicles;
+        Vehicle *vehicle = &vehicles[i];
+        memset(vehicle, 0, sizeof(Vehicle));
+
+        char ownerName[NAME_LEN] = "";
+        char ownerPhone[CONTACT_LEN] = "";
+        if (fields < 4 || field[0].length == 0 ||
+            !spanToText(field[0], vehicle->vehicleId, sizeof(vehicle->vehicleId)) ||
+            !spanToText(field[1], vehicle->licensePlate, sizeof(vehicle->licensePlate)) ||
+            !spanToText(field[typeField], vehicle->vehicleType, sizeof(vehicle->vehicleType)) ||
+            (legacy && !spanToText(field[2], ownerName, sizeof(ownerName))) ||
+            (legacy && fields > 6 && !spanToText(field[6], ownerPhone, sizeof(ownerPhone))))
+        {
+            dataReaderWarn(&reader, "missing or oversized field");
+            continue;
+        }
+        long entryTime = 0;
+        if (fields > parkedField)
+            spanToInt(field[parkedField], &vehicle->isParked);
+        if (fields > spotField)
+            spanToInt(field[spotField], &vehicle->spotNumber);
+        if (fields > entryField && spanToLong(field[entryField], &entryTime))
+            vehicle->entryTime = (time_t)entryTime;
+        if (vehicle->isParked && (vehicle->spotNumber < 1 || vehicle->spotNumber > MAX_PARKING_SPOTS))
+        {
+            dataReaderWarn(&reader, "spot out of range");
+            continue;
+        }
+        if (indexFind(vehicleIdIndex, VEHICLE_INDEX_SIZE, vehicle->vehicleId) != -1)
+        {
+            dataReaderWarn(&reader, "duplicate vehicle ID");
+            continue;
+        }
 
-        token = strtok(NULL, "|");
-        // if (token) strcpy(vehicles[i].ownerPhonenumber, token);
-        if (token)
-            strcpy(vehicles[i].ownerPhoneNumber, token);
+        vehicleFirstLink[i] = -1;
+        indexInsert(vehicleIdIndex, VEHICLE_INDEX_SIZE, vehicle->vehicleId, i);
+        numVehicles++;
 
-        token = strtok(NULL, "|");
-        if (token)
-            vehicles[i].entryTime = atol(token);
+        // Link by owner IDs; files written before the link column match by phone
+        if (fields > idsField)
+        {
+            const char *p = field[idsField].start;
+            const char *end = p + field[idsField].length;
+            while (p < end)
+            {
+                const char *comma = memchr(p, ',', end - p);
+                FieldSpan idSpan = {p, (int)((comma ? comma : end) - p)};
+                char ownerId[OWNER_ID_LEN];
+                int ownerIndex = spanToText(idSpan, ownerId, sizeof(ownerId)) ? findOwnerById(ownerId) : -1;
+                if (ownerIndex != -1)
+                    linkOwnerVehicle(ownerIndex, i);
+                p = comma ? comma + 1 : end;
+            }
+        }
+        if (vehicleFirstLink[i] == -1 && ownerPhone[0] != 0)
+        {
+            int ownerIndex = findOwnerByPhone(ownerPhone);
+            if (ownerIndex == -1 && numOwners < MAX_OWNERS)
+            {
+                strcpy(owners[numOwners].name, ownerName);
+                strcpy(owners[numOwners].phoneNumber, ownerPhone);
+                generateOwnerId(owners[numOwners].ownerId);
+                ownerIndex = addOwnerToIndexes(numOwners++);
+            }
+            if (ownerIndex != -1)
+                linkOwnerVehicle(ownerIndex, i);
+        }
     }
 
-    fclose(fp);
+    dataReaderClose(&reader);
+    invalidatePlateIndex();
+    invalidatePlateOrder();
+    lotWriteEnd();
 }
 
 void viewAllVehicles()
@@ -928,86 +2511,84 @@ void viewAllVehicles()
 
     for (int i = 0; i < numVehicles; i++)
     {
+        int ownerIndex = primaryOwnerOf(i);
         printf("%-15s %-15s %-20s %-15s %-8s %-5d %-11s\n",
                vehicles[i].vehicleId,
                vehicles[i].licensePlate,
-               vehicles[i].ownerName,
+               ownerIndex != -1 ? owners[ownerIndex].name : "-",
                vehicles[i].vehicleType,
                vehicles[i].isParked ? "Yes" : "No",
                vehicles[i].spotNumber,
-               vehicles[i].ownerPhoneNumber);
+               ownerIndex != -1 ? owners[ownerIndex].phoneNumber : "-");
     }
 }
 
 // Owner Data Append
 void saveOwnerData()
 {
-    FILE *fp = fopen("owners/data.txt", "a");
-    if (fp == NULL)
+    long long t0 = monotonicNanos();
+    DataWriter writer;
+    if (!dataWriterOpen(&writer, "owners/data.txt", 1))
     {
         printf("ERROR: Cannot create/open owner data file!\n");
         return;
     }
-    // fprintf(fp, "%s %s %s %s\n", ownerID, name, contact, vehicleID); //hjkljkjkkkkjkkk
-    fprintf(fp, "%d\n", numOwners);
+    // Last column lists the owner's vehicle IDs for reading only, links load from the vehicle file
+    dataWriterPrintf(&writer, "%d\n", numOwners);
     for (int i = 0; i < numOwners; i++)
     {
-        fprintf(fp, "%s|%s|%s|%s\n",
+        char vehicleIds[200];
+        formatVehicleIds(i, vehicleIds, sizeof(vehicleIds));
+        dataWriterPrintf(&writer, "%s|%s|%s|%s\n",
                 owners[i].ownerId,
                 owners[i].name,
                 owners[i].phoneNumber,
-                owners[i].vehicleID);
+                vehicleIds);
     }
 
-    fclose(fp);
+    long written = dataWriterClose(&writer);
+    recordSave(SAVE_OWNERS, written, t0);
 }
 
 // Owner Data Read
 void loadOwnerData()
 {
-    FILE *fp = fopen("owners/data.txt", "r");
-    if (fp == NULL)
-    {
-        numOwners = 0;
-        return;
-    }
+    indexClear(ownerIdIndex, OWNER_INDEX_SIZE);
+    indexClear(ownerPhoneIndex, OWNER_INDEX_SIZE);
+    ownerTrigramsClear();
+    numOwners = 0;
 
-    if (fscanf(fp, "%d", &numOwners) != 1)
+    DataReader reader;
+    if (!dataReaderOpen(&reader, "owners/data.txt"))
     {
-        numOwners = 0;
-        fclose(fp);
         return;
     }
 
-    char line[1000];
-    fgets(line, sizeof(line), fp); // consume newline
-
-    for (int i = 0; i < numOwners; i++)
+    // id|name|phone|vehicle ids (the last column is informational)
+    FieldSpan field[3];
+    long count = dataReaderLastBlock(&reader);
+    for (long n = 0; n < count && numOwners < MAX_OWNERS; n++)
     {
-        if (fgets(line, sizeof(line), fp) == NULL)
-            break;
-
-        line[strcspn(line, "\n")] = 0;
+        int fields = dataReaderNext(&reader, field, 3);
+        Owner *owner = &owners[numOwners];
+        if (fields < 3 || field[0].length == 0 ||
+            !spanToText(field[0], owner->ownerId, sizeof(owner->ownerId)) ||
+            !spanToText(field[1], owner->name, sizeof(owner->name)) ||
+            !spanToText(field[2], owner->phoneNumber, sizeof(owner->phoneNumber)))
+        {
+            dataReaderWarn(&reader, "missing or oversized field");
+            continue;
+        }
+        if (findOwnerById(owner->ownerId) != -1)
+        {
+            dataReaderWarn(&reader, "duplicate owner ID");
+            continue;
+        }
+        addOwnerToIndexes(numOwners++);
+    }
 
-        char *token = strtok(line, "|");
-        if (token)
-            strcpy(owners[i].ownerId, token);
-
-        token = strtok(NULL, "|");
-        if (token)
-            strcpy(owners[i].name, token);
-
-        token = strtok(NULL, "|");
-        if (token)
-            strcpy(owners[i].phoneNumber, token);
-
-        token = strtok(NULL, "|");
-        if (token)
-            strcpy(owners[i].vehicleID, token);
-    }
-
-    fclose(fp);
-}
+    dataReaderClose(&reader);
+}
 
 // View all registered owners
 /*void viewAllOwners() {
@@ -1044,83 +2625,258 @@ void viewAllOwners()
 
     printf("\n===== Registered Owners =====\n");
     printf("%-5s %-15s %-25s %-15s %-15s\n",
-           "No.", "Owner ID", "Name", "Contact", "Vehicle ID");
+           "No.", "Owner ID", "Name", "Contact", "Vehicle IDs");
     printf("--------------------------------------------------------------------------\n");
 
     for (int i = 0; i < numOwners; i++)
     {
+        char vehicleIds[200];
+        formatVehicleIds(i, vehicleIds, sizeof(vehicleIds));
         printf("%-5d %-15s %-25s %-15s %-15s\n",
                i + 1,
                owners[i].ownerId,
                owners[i].name,
                owners[i].phoneNumber,
-               owners[i].vehicleID);
+               vehicleIds);
+    }
+}
+
+// Show one owner with all linked vehicles, found by owner ID or phone number
+void displayOwnerDetails()
+{
+    char input[50];
+    printf("Enter Owner ID or Phone Number: ");
+    if (fgets(input, sizeof(input), stdin) == NULL)
+    {
+        printf("Error reading input.\n");
+        return;
+    }
+    input[strcspn(input, "\n")] = 0;
+
+    int ownerIndex = findOwnerById(input);
+    if (ownerIndex == -1)
+        ownerIndex = findOwnerByPhone(input);
+    if (ownerIndex == -1)
+    {
+        printf("ERROR: Owner not found.\n");
+        return;
+    }
+
+    printf("\n========== OWNER DETAILS ==========\n");
+    printf("Owner ID: %s\n", owners[ownerIndex].ownerId);
+    printf("Name: %s\n", owners[ownerIndex].name);
+    printf("Phone: %s\n", owners[ownerIndex].phoneNumber);
+    printf("\n%-15s %-15s %-15s %-8s %-5s\n", "Vehicle ID", "License", "Type", "Parked", "Spot");
+    printf("-------------------------------------------------------------\n");
+
+    int total = 0;
+    for (int link = ownerFirstLink[ownerIndex]; link != -1; link = ownerships[link].nextOfOwner)
+    {
+        Vehicle *vehicle = &vehicles[ownerships[link].vehicleIndex];
+        printf("%-15s %-15s %-15s %-8s %-5d\n",
+               vehicle->vehicleId,
+               vehicle->licensePlate,
+               vehicle->vehicleType,
+               vehicle->isParked ? "Yes" : "No",
+               vehicle->spotNumber);
+        total++;
     }
+
+    static int parked[MAX_VEHICLES];
+    int numParked = findParkedVehiclesOfOwner(ownerIndex, parked, MAX_VEHICLES);
+    printf("\nVehicles: %d   Currently parked: %d\n", total, numParked);
 }
 
 // Parking Data Append
 void saveParkingData()
 {
-    FILE *fp = fopen("parking/data.txt", "a");
-    if (fp == NULL)
+    long long t0 = monotonicNanos();
+    DataWriter writer;
+    if (!dataWriterOpen(&writer, "parking/data.txt", 1))
     {
         printf("ERROR: Cannot create/open parking data file!\n");
         return;
     }
-
     for (int i = 0; i < MAX_PARKING_SPOTS; i++)
     {
-        fprintf(fp, "%d|%d|%s|%ld|%.2f\n",
+        dataWriterPrintf(&writer, "%d|%d|%s|%ld|%.2f|%d|%.2f\n",
                 spots[i].spotNumber,
                 spots[i].isOccupied,
                 spots[i].vehicleId,
                 spots[i].entryTime,
-                spots[i].parkingFee);
+                spots[i].parkingFee,
+                spots[i].isPassSession,
+                spots[i].ratePerHour);
     }
 
-    fclose(fp);
+    long written = dataWriterClose(&writer);
+    recordSave(SAVE_PARKING, written, t0);
+    journalFlush();
+    seriesFlush();
 }
 
 // Parking Data Read
 void loadParkingData()
 {
-    FILE *fp = fopen("parking/data.txt", "r");
-    if (fp == NULL)
+    DataReader reader;
+    if (!dataReaderOpen(&reader, "parking/data.txt"))
     {
         return;
     }
+    lotWriteBegin();
 
-    char line[200];
-    int i = 0;
-
-    while (fgets(line, sizeof(line), fp) != NULL && i < MAX_PARKING_SPOTS)
+    // No count line here: every appended snapshot starts again at spot 1
+    FieldSpan field[7];
+    size_t snapshotPos = 0;
+    long snapshotLine = 0;
+    while (1)
     {
-        line[strcspn(line, "\n")] = 0;
-
-        char *token = strtok(line, "|");
-        if (token)
-            spots[i].spotNumber = atoi(token);
+        size_t linePos = reader.pos;
+        long lineNumber = reader.line;
+        if (dataReaderNext(&reader, field, 1) < 0)
+            break;
+        if (field[0].length == 1 && field[0].start[0] == '1')
+        {
+            snapshotPos = linePos;
+            snapshotLine = lineNumber;
+        }
+    }
+    reader.pos = snapshotPos;
+    reader.line = snapshotLine;
 
-        token = strtok(NULL, "|");
-        if (token)
-            spots[i].isOccupied = atoi(token);
+    // spot|occupied|vehicle id|entry time|fee|pass session|rate per hour
+    int fields;
+    while ((fields = dataReaderNext(&reader, field, 7)) >= 0)
+    {
+        int spotNumber;
+        if (fields == 1 && field[0].length == 0)
+            continue; // Blank line
+        if (fields < 5 || !spanToInt(field[0], &spotNumber) || spotNumber < 1 || spotNumber > MAX_PARKING_SPOTS)
+        {
+            dataReaderWarn(&reader, "bad spot number");
+            continue;
+        }
 
-        token = strtok(NULL, "|");
-        if (token)
-            strcpy(spots[i].vehicleId, token);
+        ParkingSpot *spot = &spots[spotNumber - 1];
+        long entryTime = 0;
+        if (!spanToText(field[2], spot->vehicleId, sizeof(spot->vehicleId)))
+        {
+            dataReaderWarn(&reader, "oversized vehicle ID");
+            continue;
+        }
+        spot->spotNumber = spotNumber;
+        spot->isOccupied = 0;
+        spanToInt(field[1], &spot->isOccupied);
+        spot->entryTime = spanToLong(field[3], &entryTime) ? (time_t)entryTime : 0;
+        if (!spanToDouble(field[4], &spot->parkingFee))
+            spot->parkingFee = 0.0;
+        spot->isPassSession = 0;
+        if (fields > 5)
+            spanToInt(field[5], &spot->isPassSession);
+
+        // Sessions saved before surge pricing keep the flat rate they started under
+        if (fields < 7 || !spanToDouble(field[6], &spot->ratePerHour))
+            spot->ratePerHour = spot->isOccupied && !spot->isPassSession ? BASE_RATE_PER_HOUR : 0.0;
+    }
 
-        token = strtok(NULL, "|");
-        if (token)
-            spots[i].entryTime = atol(token);
+    dataReaderClose(&reader);
+    refreshLotState();
+    lotWriteEnd();
+    feedResyncAll();
+}
 
-        token = strtok(NULL, "|");
-        if (token)
-            spots[i].parkingFee = atof(token);
+// Counters, free map and alert timers from spots[], after a bulk change
+void refreshLotState()
+{
+    // Stages already passed were alerted before the restart; only later ones are armed
+    occupiedCount = 0;
+    time_t now = clockNow();
+    for (int i = 0; i < MAX_PARKING_SPOTS; i++)
+    {
+        if (spots[i].isOccupied)
+        {
+            occupiedCount++;
+            armSpotTimer(i, spots[i].entryTime, now);
+        }
+        else
+        {
+            timerDisarm(SPOT_TIMER(i));
+        }
+        spotChangedAt[i] = spots[i].entryTime;
+    }
+    rebuildFreeSpots();
+    recountZones();
+    rebuildEntryOrder();
+}
 
-        i++;
+// The vehicle and parking files are written one after the other, so a crash
+// between them (or a hand edit) leaves them disagreeing. The parking file is
+// written last and wins: a vehicle is parked only where a spot names it, and a
+// spot naming an unknown vehicle, or one already placed, is freed. Returns the
+// number of records corrected.
+int reconcileLot()
+{
+    static int claimedSpot[MAX_VEHICLES];
+    int fixes = 0;
+    lotWriteBegin();
+    for (int i = 0; i < numVehicles; i++)
+    {
+        claimedSpot[i] = vehicles[i].isParked ? vehicles[i].spotNumber : 0;
+        vehicles[i].isParked = 0;
+        vehicles[i].spotNumber = 0;
     }
+    for (int s = 0; s < MAX_PARKING_SPOTS; s++)
+    {
+        ParkingSpot *spot = &spots[s];
+        int vehicleIndex = spot->isOccupied ? indexFind(vehicleIdIndex, VEHICLE_INDEX_SIZE, spot->vehicleId) : -1;
+        if (spot->isOccupied && (vehicleIndex == -1 || vehicles[vehicleIndex].isParked))
+        {
+            fixes++;
+            vehicleIndex = -1;
+        }
+        if (!isfinite(spot->parkingFee))
+            spot->parkingFee = 0.0;
+        if (vehicleIndex == -1)
+        {
+            spot->isOccupied = 0;
+            strcpy(spot->vehicleId, "");
+            spot->entryTime = 0;
+            spot->isPassSession = 0;
+            spot->ratePerHour = 0.0;
+            continue;
+        }
 
-    fclose(fp);
+        spot->isOccupied = 1;
+        spot->isPassSession = spot->isPassSession != 0;
+        if (spot->isPassSession)
+            spot->ratePerHour = 0.0;
+        else if (!isfinite(spot->ratePerHour) || spot->ratePerHour < 0.0)
+        {
+            spot->ratePerHour = BASE_RATE_PER_HOUR;
+            fixes++;
+        }
+        Vehicle *vehicle = &vehicles[vehicleIndex];
+        if (claimedSpot[vehicleIndex] != s + 1 || vehicle->entryTime != spot->entryTime)
+            fixes++;
+        vehicle->isParked = 1;
+        vehicle->spotNumber = s + 1;
+        vehicle->entryTime = spot->entryTime;
+    }
+    for (int i = 0; i < numVehicles; i++)
+    {
+        if (vehicles[i].isParked)
+            continue;
+        if (claimedSpot[i] != 0)
+            fixes++;
+        vehicles[i].entryTime = 0;
+    }
+    if (fixes > 0)
+        refreshLotState();
+    lotWriteEnd();
+    if (fixes > 0)
+        feedResyncAll();
+    reconcileFixes += fixes;
+    return fixes;
 }
 
 // Display current parking status
@@ -1128,16 +2884,42 @@ void displayParkingStatus()
 {
     printf("\n========== PARKING STATUS ==========\n");
 
-    int occupied = 0;
-    for (int i = 0; i < MAX_PARKING_SPOTS; i++)
-    {
-        if (spots[i].isOccupied)
-            occupied++;
-    }
+    int occupied = occupiedCount;
     printf("Total Spots: %d\n", MAX_PARKING_SPOTS);
     printf("Occupied: %d\n", occupied);
     printf("Available: %d\n", MAX_PARKING_SPOTS - occupied);
     printf("Occupancy Rate: %.1f%%\n", (float)occupied / MAX_PARKING_SPOTS * 100);
+    time_t statusTime = clockNow();
+    printf("Current Entry Rate: TK- %.2f/= per hour (%s)\n", entryRatePerHour(statusTime, occupiedCount),
+           dayPeriodNames[dayPeriodOfHour[hourOfWeek(statusTime) % 24]]);
+
+    int weeks = forecastWeeks();
+    if (weeks > 0)
+    {
+        printf("Expected Free Spots: %.0f in 15 min, %.0f in 30 min, %.0f in 60 min (%d week(s) of history)\n",
+               forecastFreeSpots(statusTime, 15, occupied), forecastFreeSpots(statusTime, 30, occupied),
+               forecastFreeSpots(statusTime, 60, occupied), weeks);
+    }
+    else
+    {
+        printf("Expected Free Spots: no session history yet\n");
+    }
+    if (recentAlertCount > 0)
+    {
+        printf("\n--- Recent Alerts ---\n");
+        unsigned long long first = recentAlertCount > 5 ? recentAlertCount - 5 : 0;
+        for (unsigned long long a = recentAlertCount; a > first; a--)
+        {
+            AlertEvent *alert = &recentAlerts[(a - 1) % RECENT_ALERTS];
+            char atText[30];
+            strftime(atText, sizeof(atText), "%Y-%m-%d %H:%M", localtime(&alert->at));
+            if (alert->spotNumber > 0)
+                printf("%s  %-13s spot %d, %s, %s\n", atText, alertKindNames[alert->kind], alert->spotNumber,
+                       alert->vehicleId, alert->detail);
+            else
+                printf("%s  %-13s %s, %s\n", atText, alertKindNames[alert->kind], alert->vehicleId, alert->detail);
+        }
+    }
     printf("\n--- Spot Details ---\n");
     printf("%-4s %-10s %-15s %-20s %-15s\n", "Spot", "Status", "Vehicle ID", "License Plate", "Duration");
     printf("-----------------------------------------------------------------------\n");
@@ -1151,8 +2933,7 @@ void displayParkingStatus()
             int vehicleIndex = findVehicleById(spots[i].vehicleId);
             if (vehicleIndex != -1)
             {
-                time_t currentTime = time(NULL);
-                double duration = difftime(currentTime, spots[i].entryTime) / 3600.0; // in hours
+                double duration = difftime(statusTime, spots[i].entryTime) / 3600.0; // in hours
                 printf(" %-15s %-20s %.1f hrs",
                        spots[i].vehicleId,
                        vehicles[vehicleIndex].licensePlate,
@@ -1168,78 +2949,86 @@ void generateReport()
 {
     printf("\n========== PARKING REPORT ==========\n");
 
-    time_t currentTime = time(NULL);
+    time_t currentTime = clockNow();
     char filename[100];
     sprintf(filename, "reports/report_%ld.txt", currentTime);
 
-    FILE *fp = fopen(filename, "a");
-    if (fp == NULL)
+    DataWriter writer;
+    if (!dataWriterOpen(&writer, filename, 1))
     {
         printf("Error creating report file.\n");
         return;
     }
 
-    fprintf(fp, "=== PARKING LOT MANAGEMENT REPORT ===\n");
-    fprintf(fp, "Generated on: %s\n", ctime(&currentTime));
-    fprintf(fp, "==========================================\n\n");
+    int occupied = 0;
+    double totalRevenue = 0.0;
+    writeReport(&writer, currentTime, &occupied, &totalRevenue);
+    dataWriterClose(&writer);
+
+    printf("Report generated successfully!\n");
+    printf("Report saved as: %s\n", filename);
+    // Display summary on screen
+    printf("\nREPORT SUMMARY:\n");
+    printf("Total Spots: %d\n", MAX_PARKING_SPOTS);
+    printf("Occupied: %d\n", occupied);
+    printf("Available: %d\n", MAX_PARKING_SPOTS - occupied);
+    printf("Occupancy Rate: %.1f%%\n", (float)occupied / MAX_PARKING_SPOTS * 100);
+    printf("Current Revenue: TK- %.2f/=\n", totalRevenue);
+}
+
+// Write the report body, returns occupancy and revenue for the summary
+void writeReport(DataWriter *writer, time_t currentTime, int *occupiedOut, double *revenueOut)
+{
+    dataWriterPrintf(writer, "=== PARKING LOT MANAGEMENT REPORT ===\n");
+    dataWriterPrintf(writer, "Generated on: %s\n", ctime(&currentTime));
+    dataWriterPrintf(writer, "==========================================\n\n");
+
+    // Everything below comes from one consistent copy of the lot
+    LotSnapshot snapshot;
+    takeLotSnapshot(&snapshot);
 
     // Count occupied spots and calculate revenue
-    int occupied = 0;
+    int occupied = snapshot.count;
     double totalRevenue = 0.0;
 
-    for (int i = 0; i < MAX_PARKING_SPOTS; i++)
+    for (int i = 0; i < snapshot.count; i++)
     {
-        if (spots[i].isOccupied)
-        {
-            occupied++;
-            totalRevenue += calculateParkingFee(spots[i].entryTime);
-        }
+        if (!snapshot.rows[i].isPassSession)
+            totalRevenue += calculateParkingFeeAt(snapshot.rows[i].entryTime, currentTime, snapshot.rows[i].ratePerHour);
     }
-    fprintf(fp, "SYSTEM STATISTICS:\n");
-    fprintf(fp, "Total Parking Spots: %d\n", MAX_PARKING_SPOTS);
-    fprintf(fp, "Occupied Spots: %d\n", occupied);
-    fprintf(fp, "Available Spots: %d\n", MAX_PARKING_SPOTS - occupied);
-    fprintf(fp, "Occupancy Rate: %.1f%%\n", (float)occupied / MAX_PARKING_SPOTS * 100);
-    fprintf(fp, "Estimated Current Revenue: TK- %.2f/=\n\n", totalRevenue);
-    fprintf(fp, "OWNER STATISTICS:\n");
-    fprintf(fp, "Registered Vehicles: %d\n", numVehicles);
-    fprintf(fp, "Registered Admins: %d\n\n", numAdmins);
+    dataWriterPrintf(writer, "SYSTEM STATISTICS:\n");
+    dataWriterPrintf(writer, "Total Parking Spots: %d\n", MAX_PARKING_SPOTS);
+    dataWriterPrintf(writer, "Occupied Spots: %d\n", occupied);
+    dataWriterPrintf(writer, "Available Spots: %d\n", MAX_PARKING_SPOTS - occupied);
+    dataWriterPrintf(writer, "Occupancy Rate: %.1f%%\n", (float)occupied / MAX_PARKING_SPOTS * 100);
+    dataWriterPrintf(writer, "Estimated Current Revenue: TK- %.2f/=\n\n", totalRevenue);
+    dataWriterPrintf(writer, "OWNER STATISTICS:\n");
+    dataWriterPrintf(writer, "Registered Vehicles: %d\n", numVehicles);
+    dataWriterPrintf(writer, "Registered Admins: %d\n\n", numAdmins);
     // Write currently parked vehicles`
-    fprintf(fp, "CURRENTLY PARKED VEHICLES:\n");
-    fprintf(fp, "%-4s %-15s %-15s %-20s %-10s %-15s\n",
+    dataWriterPrintf(writer, "CURRENTLY PARKED VEHICLES:\n");
+    dataWriterPrintf(writer, "%-4s %-15s %-15s %-20s %-10s %-15s\n",
             "Spot", "Vehicle ID", "License", "Owner", "Type", "Duration(hrs)");
-    fprintf(fp, "--------------------------------------------------------------------------------\n");
+    dataWriterPrintf(writer, "--------------------------------------------------------------------------------\n");
 
-    for (int i = 0; i < MAX_PARKING_SPOTS; i++)
+    for (int i = 0; i < snapshot.count; i++)
     {
-        if (spots[i].isOccupied)
+        SnapshotRow *row = &snapshot.rows[i];
+        if (row->registered)
         {
-            int vehicleIndex = findVehicleById(spots[i].vehicleId);
-            if (vehicleIndex != -1)
-            {
-                double duration = difftime(currentTime, spots[i].entryTime) / 3600.0;
-                fprintf(fp, "%-4d %-15s %-15s %-20s %-10s %.1f\n",
-                        spots[i].spotNumber,
-                        spots[i].vehicleId,
-                        vehicles[vehicleIndex].licensePlate,
-                        vehicles[vehicleIndex].ownerName,
-                        vehicles[vehicleIndex].vehicleType,
-                        duration);
-            }
+            double duration = difftime(currentTime, row->entryTime) / 3600.0;
+            dataWriterPrintf(writer, "%-4d %-15s %-15s %-20s %-10s %.1f\n",
+                    row->spotNumber,
+                    row->vehicleId,
+                    row->licensePlate,
+                    row->ownerName,
+                    row->vehicleType,
+                    duration);
         }
     }
 
-    fclose(fp);
-
-    printf("Report generated successfully!\n");
-    printf("Report saved as: %s\n", filename);
-    // Display summary on screen
-    printf("\nREPORT SUMMARY:\n");
-    printf("Total Spots: %d\n", MAX_PARKING_SPOTS);
-    printf("Occupied: %d\n", occupied);
-    printf("Available: %d\n", MAX_PARKING_SPOTS - occupied);
-    printf("Occupancy Rate: %.1f%%\n", (float)occupied / MAX_PARKING_SPOTS * 100);
-    printf("Current Revenue: TK- %.2f/=\n", totalRevenue);
+    *occupiedOut = occupied;
+    *revenueOut = totalRevenue;
 }
 
 // Debugging Functions
@@ -1260,160 +3049,7739 @@ void debugShowAllAdmins()
         printf("  Name: '%s'\n", admins[i].name);
         printf("  Phone: '%s'\n", admins[i].phoneNumber);
         printf("  Email: '%s'\n", admins[i].email);
-        printf("  Password: '%s'\n", admins[i].password);
+        printf("  Password: (salted hash, not shown)\n");
         printf("---\n");
     }
 }
 
-// Utility functions (For Validations)
-
-// Validate Name
-int isValidName(char *name)
+// Owner <-> Vehicle Links
+void resetOwnerships()
 {
-    if (strlen(name) > 20 || strlen(name) < 2)
-    {
-        return 0; // Invalid name length
-    }
-    for (int i = 0; i < strlen(name); i++)
+    numOwnerships = 0;
+    freeOwnership = -1;
+    for (int i = 0; i < numOwners; i++)
     {
-        if (!isalpha(name[i]) && name[i] != ' ')
-        {
-            return 0; // Contains non-alphabetic characters
-        }
+        ownerFirstLink[i] = -1;
+        ownerLastLink[i] = -1;
     }
-    return 1;
+    for (int i = 0; i < numVehicles; i++)
+        vehicleFirstLink[i] = -1;
 }
 
-// Validate Email
-int isValidEmail(char *email)
+// Registers a filled-in owner slot in the ID and phone indexes
+int addOwnerToIndexes(int ownerIndex)
 {
-    if (strlen(email) > 20 || strlen(email) < 5)
+    ownerFirstLink[ownerIndex] = -1;
+    ownerLastLink[ownerIndex] = -1;
+    indexInsert(ownerIdIndex, OWNER_INDEX_SIZE, owners[ownerIndex].ownerId, ownerIndex);
+    if (owners[ownerIndex].phoneNumber[0] != 0)
+        indexInsert(ownerPhoneIndex, OWNER_INDEX_SIZE, owners[ownerIndex].phoneNumber, ownerIndex);
+    ownerTrigramsAdd(ownerIndex);
+    return ownerIndex;
+}
+
+// Appends the link to both adjacency lists, returns 0 if it exists or no slot is free
+int linkOwnerVehicle(int ownerIndex, int vehicleIndex)
+{
+    int *tail = &vehicleFirstLink[vehicleIndex];
+    while (*tail != -1)
     {
-        return 0; // Invalid email length
+        if (ownerships[*tail].ownerIndex == ownerIndex)
+            return 0;
+        tail = &ownerships[*tail].nextOfVehicle;
+    }
+
+    int link;
+    if (freeOwnership != -1)
+    {
+        link = freeOwnership;
+        freeOwnership = ownerships[link].nextOfOwner;
     }
-    if (strstr(email, "@gmail.com") == NULL)
+    else if (numOwnerships < MAX_OWNERSHIPS)
     {
-        return 0; // Does not contain "@gmail.com"
+        link = numOwnerships++;
+    }
+    else
+    {
+        return 0;
     }
+
+    ownerships[link].ownerIndex = ownerIndex;
+    ownerships[link].vehicleIndex = vehicleIndex;
+    ownerships[link].nextOfOwner = -1;
+    ownerships[link].nextOfVehicle = -1;
+    *tail = link;
+
+    if (ownerLastLink[ownerIndex] == -1)
+        ownerFirstLink[ownerIndex] = link;
+    else
+        ownerships[ownerLastLink[ownerIndex]].nextOfOwner = link;
+    ownerLastLink[ownerIndex] = link;
     return 1;
 }
 
-// Validate Phone Number
-int isValidPhoneNumber(char *phone)
+// Drops every link of a vehicle from its owners' lists
+void unlinkVehicleOwners(int vehicleIndex)
 {
-    if (strlen(phone) != 11)
+    int link = vehicleFirstLink[vehicleIndex];
+    while (link != -1)
     {
-        return 0; // Not exactly 11 digits
-    }
-    for (int i = 0; i < 11; i++)
-    {
-        if (!isdigit(phone[i]))
+        int next = ownerships[link].nextOfVehicle;
+        int ownerIndex = ownerships[link].ownerIndex;
+        int *prev = &ownerFirstLink[ownerIndex];
+        int prevLink = -1;
+        while (*prev != link)
         {
-            return 0; // Contains non-digit characters
+            prevLink = *prev;
+            prev = &ownerships[*prev].nextOfOwner;
         }
+        *prev = ownerships[link].nextOfOwner;
+        if (ownerLastLink[ownerIndex] == link)
+            ownerLastLink[ownerIndex] = prevLink;
+
+        ownerships[link].nextOfOwner = freeOwnership;
+        freeOwnership = link;
+        link = next;
     }
-    return 1;
+    vehicleFirstLink[vehicleIndex] = -1;
 }
 
-// Validate Password
-int isValidPassword(char *password)
+// First registered owner of a vehicle, -1 if none
+int primaryOwnerOf(int vehicleIndex)
 {
-    if (strlen(password) < 8)
-    {
-        return 0; // Less than 8 characters
-    }
-    return 1;
+    int link = vehicleFirstLink[vehicleIndex];
+    return link == -1 ? -1 : ownerships[link].ownerIndex;
 }
 
-// Validate License Plate
-int isValidLicensePlate(char *plate)
+const char *ownerNameOf(int vehicleIndex)
 {
-    char letters[4];
-    int digits;
+    int ownerIndex = primaryOwnerOf(vehicleIndex);
+    return ownerIndex == -1 ? "-" : owners[ownerIndex].name;
+}
 
-    // 3 Uppercase Letters, 1 Dash, And 4 Digits
-    if (sscanf(plate, "%3[A-Z]-%4d", letters, &digits) != 2)
+// Walks only the owner's own list, never the vehicle table
+int findParkedVehiclesOfOwner(int ownerIndex, int *out, int max)
+{
+    int count = 0;
+    for (int link = ownerFirstLink[ownerIndex]; link != -1 && count < max; link = ownerships[link].nextOfOwner)
     {
-        if (strlen(plate) != 8)
-        {
-            printf("Invalid License Plate.\n");
-            return 0;
-        }
+        if (vehicles[ownerships[link].vehicleIndex].isParked)
+            out[count++] = ownerships[link].vehicleIndex;
     }
-    return 1;
+    return count;
 }
 
-void clearInputBuffer()
+void formatOwnerIds(int vehicleIndex, char *out, int size)
 {
-    int c;
-    while ((c = getchar()) != '\n' && c != EOF)
-        ;
+    int used = 0;
+    out[0] = 0;
+    for (int link = vehicleFirstLink[vehicleIndex]; link != -1; link = ownerships[link].nextOfVehicle)
+    {
+        int n = snprintf(out + used, size - used, "%s%s", used ? "," : "",
+                         owners[ownerships[link].ownerIndex].ownerId);
+        if (n < 0 || n >= size - used)
+        {
+            out[used] = 0;
+            break;
+        }
+        used += n;
+    }
 }
 
-int findOwnerById(char *ownerId)
+void formatVehicleIds(int ownerIndex, char *out, int size)
 {
-    for (int i = 0; i < numOwners; i++)
+    int used = 0;
+    out[0] = 0;
+    for (int link = ownerFirstLink[ownerIndex]; link != -1; link = ownerships[link].nextOfOwner)
     {
-        if (strcmp(owners[i].ownerId, ownerId) == 0)
+        int n = snprintf(out + used, size - used, "%s%s", used ? "," : "",
+                         vehicles[ownerships[link].vehicleIndex].vehicleId);
+        if (n < 0 || n >= size - used)
         {
-            return i;
+            out[used] = 0;
+            break;
         }
+        used += n;
     }
-    return -1;
 }
 
-int findVehicleById(char *vehicleId)
+void rebuildVehicleIndex()
 {
+    indexClear(vehicleIdIndex, VEHICLE_INDEX_SIZE);
     for (int i = 0; i < numVehicles; i++)
+        indexInsert(vehicleIdIndex, VEHICLE_INDEX_SIZE, vehicles[i].vehicleId, i);
+    invalidatePlateIndex();
+}
+
+// Removes a vehicle, keeping the table order; later positions shift down by one
+void removeVehicleAt(int vehicleIndex)
+{
+    unlinkVehicleOwners(vehicleIndex);
+    waitlistLeave(vehicleIndex);
+    plateOrderRemove(vehicleIndex);
+    for (int i = vehicleIndex; i < numVehicles - 1; i++)
     {
-        if (strcmp(vehicles[i].vehicleId, vehicleId) == 0)
+        vehicles[i] = vehicles[i + 1];
+        vehicleFirstLink[i] = vehicleFirstLink[i + 1];
+        vehicleWaitEntry[i] = vehicleWaitEntry[i + 1];
+    }
+    numVehicles--;
+    vehicleWaitEntry[numVehicles] = 0;
+    waitlistVehicleRemoved(vehicleIndex);
+
+    for (int o = 0; o < numOwners; o++)
+    {
+        for (int link = ownerFirstLink[o]; link != -1; link = ownerships[link].nextOfOwner)
         {
-            return i;
+            if (ownerships[link].vehicleIndex > vehicleIndex)
+                ownerships[link].vehicleIndex--;
         }
     }
-    return -1;
+    rebuildVehicleIndex();
 }
 
-int findAvailableSpot()
+// Bulk Registry Import / Export
+// The CSV file is read in large chunks and split in place: fields are pointers
+// into the read buffer, terminated by overwriting the separators. Complete
+// lines are gathered into batches, validated across threads, then applied in
+// file order. Indexes are updated as rows land; the plate index is rebuilt and
+// the data files are written once, after the last batch.
+
+void importRegistryMenu()
 {
-    for (int i = 0; i < MAX_PARKING_SPOTS; i++)
+    char path[200];
+    printf("Enter CSV File Path: ");
+    if (fgets(path, sizeof(path), stdin) == NULL)
+        return;
+    path[strcspn(path, "\n")] = 0;
+    importRegistryCsv(path);
+}
+
+void exportRegistryMenu()
+{
+    char path[200];
+    printf("Enter CSV File Path: ");
+    if (fgets(path, sizeof(path), stdin) == NULL)
+        return;
+    path[strcspn(path, "\n")] = 0;
+    exportRegistryCsv(path);
+}
+
+// Splits one line in place. Quoted fields may hold commas and "" escapes.
+// Returns the number of fields, at most maxFields (the rest of the line is ignored).
+static int csvSplitLine(char *line, char **fields, int maxFields)
+{
+    int count = 0;
+    char *p = line;
+    while (count < maxFields)
     {
-        if (!spots[i].isOccupied)
+        if (*p == '"')
         {
-            return spots[i].spotNumber;
+            // Unescape into the same storage; the text only ever shrinks
+            char *out = ++p;
+            fields[count++] = out;
+            while (*p != 0)
+            {
+                if (*p == '"' && p[1] == '"')
+                {
+                    *out++ = '"';
+                    p += 2;
+                }
+                else if (*p == '"')
+                {
+                    p++;
+                    break;
+                }
+                else
+                {
+                    *out++ = *p++;
+                }
+            }
+            while (*p != 0 && *p != ',')
+                p++;
+            char separator = *p;
+            *out = 0;
+            if (separator == 0)
+                break;
+            p++;
+        }
+        else
+        {
+            fields[count++] = p;
+            while (*p != 0 && *p != ',')
+                p++;
+            if (*p == 0)
+                break;
+            *p++ = 0;
         }
     }
-    return -1;
+    return count;
 }
 
-void generateOwnerId(char *ownerId)
+static void *importValidateSlice(void *arg)
 {
-    static int ownerCounter = 1;
-    sprintf(ownerId, "OWN%04d", ownerCounter++);
+    ImportSlice *slice = (ImportSlice *)arg;
+    for (int i = 0; i < slice->count; i++)
+    {
+        ImportRow *row = &slice->rows[i];
+        row->errors = validateRecord(&row->check);
+        // The plate rule does not bound the length, and a '|' would split the vehicle row
+        if (strlen(row->check.plate) >= LICENSE_PLATE_LEN || strchr(row->check.plate, '|') != NULL)
+            row->errors |= INVALID_PLATE;
+    }
+    return NULL;
 }
 
-void generateVehicleId(char *vehicleId)
+// Validation is pure, so rows split across threads freely; small batches stay inline
+static void importValidateBatch(ImportRow *rows, int count)
 {
-    static int vehicleCounter = 1;
-    sprintf(vehicleId, "VH%04d", vehicleCounter++);
+    ImportSlice whole = {rows, count};
+#ifndef _WIN32
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int threads = cpus < 1 ? 1 : cpus > IMPORT_MAX_THREADS ? IMPORT_MAX_THREADS : (int)cpus;
+    if (count >= IMPORT_PARALLEL_MIN && threads > 1)
+    {
+        pthread_t workers[IMPORT_MAX_THREADS];
+        ImportSlice slices[IMPORT_MAX_THREADS];
+        int started = 0, offset = 0;
+        for (int t = 0; t < threads; t++)
+        {
+            int share = (count - offset) / (threads - t);
+            slices[t].rows = rows + offset;
+            slices[t].count = share;
+            offset += share;
+            if (pthread_create(&workers[t], NULL, importValidateSlice, &slices[t]) != 0)
+            {
+                importValidateSlice(&slices[t]); // Out of threads: finish this slice here
+                continue;
+            }
+            started |= 1 << t;
+        }
+        for (int t = 0; t < threads; t++)
+        {
+            if (started & (1 << t))
+                pthread_join(workers[t], NULL);
+        }
+        return;
+    }
+#endif
+    importValidateSlice(&whole);
 }
 
-double calculateParkingFee(time_t entryTime)
+// Registers one validated row; a plate already in the registry gains the row's owner as co-owner
+static void importApplyRow(ImportRow *row, ImportStats *stats)
 {
-    time_t exitTime = time(NULL);
+    if (row->errors != 0)
+    {
+        char fieldsText[80];
+        describeValidationErrors(row->errors, fieldsText, sizeof(fieldsText));
+        if (stats->rejected++ < IMPORT_MAX_REPORTED)
+            printf("Line %ld: invalid %s\n", row->line, fieldsText);
+        return;
+    }
 
-    // Calculate difference in seconds
-    double secondsParked = difftime(exitTime, entryTime);
-    double hoursParked = secondsParked / 3600.0;
-    double ratePerHour = 100.0;
+    int ownerIndex = findOwnerByPhone((char *)row->check.phone);
+    if (ownerIndex == -1)
+    {
+        if (numOwners >= MAX_OWNERS)
+        {
+            stats->full++;
+            return;
+        }
+        strcpy(owners[numOwners].name, row->check.name);
+        strcpy(owners[numOwners].phoneNumber, row->check.phone);
+        generateOwnerId(owners[numOwners].ownerId);
+        ownerIndex = addOwnerToIndexes(numOwners++);
+        stats->ownersAdded++;
+    }
 
-    // Minimum hours
-    if (hoursParked < 1)
+    int vehicleIndex = indexFind(importPlateIndex, VEHICLE_INDEX_SIZE, row->check.plate);
+    if (vehicleIndex != -1)
     {
-        hoursParked = 1;
+        if (linkOwnerVehicle(ownerIndex, vehicleIndex))
+            stats->coOwners++;
+        else
+            stats->duplicates++;
+        return;
+    }
+    if (numVehicles >= MAX_VEHICLES)
+    {
+        stats->full++;
+        return;
     }
-    // Calculate total fee
-    double totalFee = hoursParked * ratePerHour;
 
-    return totalFee;
-}
\ No newline at end of file
+    Vehicle *vehicle = &vehicles[numVehicles];
+    memset(vehicle, 0, sizeof(Vehicle));
+    if (row->vehicleId != NULL && isValidVehicleId(row->vehicleId) &&
+        indexFind(vehicleIdIndex, VEHICLE_INDEX_SIZE, row->vehicleId) == -1)
+        strcpy(vehicle->vehicleId, row->vehicleId); // Keep exported IDs on re-import
+    else
+        generateVehicleId(vehicle->vehicleId);
+    strcpy(vehicle->licensePlate, row->check.plate);
+    strcpy(vehicle->vehicleType, row->check.vehicleType);
+
+    vehicleFirstLink[numVehicles] = -1;
+    indexInsert(vehicleIdIndex, VEHICLE_INDEX_SIZE, vehicle->vehicleId, numVehicles);
+    indexInsert(importPlateIndex, VEHICLE_INDEX_SIZE, vehicle->licensePlate, numVehicles);
+    linkOwnerVehicle(ownerIndex, numVehicles);
+    numVehicles++;
+    stats->vehiclesAdded++;
+}
+
+// Header names the columns, in any order: license_plate, vehicle_type,
+// owner_name, owner_phone, and optionally vehicle_id. Returns rows read, -1 on error.
+long importRegistryCsv(const char *path)
+{
+    static char buffer[CSV_CHUNK_SIZE + 1];
+    static ImportRow rows[IMPORT_BATCH];
+
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL)
+    {
+        printf("ERROR: Cannot open %s\n", path);
+        return -1;
+    }
+
+    long long t0 = monotonicNanos();
+    ImportStats stats = {0};
+    int column[IMPORT_COLUMNS];
+    int haveHeader = 0;
+    long lineNumber = 0;
+    size_t filled = 0;
+    int atEnd = 0;
+
+    indexClear(importPlateIndex, VEHICLE_INDEX_SIZE);
+    for (int i = 0; i < numVehicles; i++)
+        indexInsert(importPlateIndex, VEHICLE_INDEX_SIZE, vehicles[i].licensePlate, i);
+
+    while (!atEnd)
+    {
+        size_t got = fread(buffer + filled, 1, CSV_CHUNK_SIZE - filled, fp);
+        filled += got;
+        atEnd = got == 0 || feof(fp);
+
+        char *p = buffer;
+        char *end = buffer + filled;
+        int numRows = 0;
+        while (p < end)
+        {
+            char *newline = memchr(p, '\n', end - p);
+            if (newline == NULL)
+            {
+                if (!atEnd)
+                    break; // Partial line, completed by the next read
+                newline = end;
+            }
+            *newline = 0;
+            if (newline > p && newline[-1] == '\r')
+                newline[-1] = 0;
+            char *line = p;
+            p = newline + 1;
+            lineNumber++;
+            if (line[0] == 0)
+                continue;
+
+            char *fields[IMPORT_MAX_FIELDS];
+            int numFields = csvSplitLine(line, fields, IMPORT_MAX_FIELDS);
+            if (!haveHeader)
+            {
+                static const char *names[IMPORT_COLUMNS] = {"license_plate", "vehicle_type", "owner_name",
+                                                            "owner_phone", "vehicle_id"};
+                for (int c = 0; c < IMPORT_COLUMNS; c++)
+                {
+                    column[c] = -1;
+                    for (int f = 0; f < numFields; f++)
+                    {
+                        if (strcmp(fields[f], names[c]) == 0)
+                            column[c] = f;
+                    }
+                    if (column[c] == -1 && c != IMPORT_COL_VEHICLE_ID)
+                    {
+                        printf("ERROR: Header has no '%s' column.\n", names[c]);
+                        fclose(fp);
+                        return -1;
+                    }
+                }
+                haveHeader = 1;
+                continue;
+            }
+
+            ImportRow *row = &rows[numRows++];
+            static const char *missing = "";
+            row->line = lineNumber;
+            row->check.plate = column[IMPORT_COL_PLATE] < numFields ? fields[column[IMPORT_COL_PLATE]] : missing;
+            row->check.vehicleType = column[IMPORT_COL_TYPE] < numFields ? fields[column[IMPORT_COL_TYPE]] : missing;
+            row->check.name = column[IMPORT_COL_NAME] < numFields ? fields[column[IMPORT_COL_NAME]] : missing;
+            row->check.phone = column[IMPORT_COL_PHONE] < numFields ? fields[column[IMPORT_COL_PHONE]] : missing;
+            row->check.email = NULL;
+            row->check.password = NULL;
+            row->vehicleId = column[IMPORT_COL_VEHICLE_ID] != -1 && column[IMPORT_COL_VEHICLE_ID] < numFields
+                                 ? fields[column[IMPORT_COL_VEHICLE_ID]]
+                                 : NULL;
+
+            if (numRows == IMPORT_BATCH)
+            {
+                importValidateBatch(rows, numRows);
+                for (int r = 0; r < numRows; r++)
+                    importApplyRow(&rows[r], &stats);
+                numRows = 0;
+            }
+        }
+        importValidateBatch(rows, numRows);
+        for (int r = 0; r < numRows; r++)
+            importApplyRow(&rows[r], &stats);
+
+        // Carry the partial last line over to the front of the buffer
+        filled = end - p > 0 ? (size_t)(end - p) : 0;
+        memmove(buffer, p, filled);
+        if (filled == CSV_CHUNK_SIZE)
+        {
+            printf("ERROR: Line %ld is longer than %d bytes.\n", lineNumber + 1, CSV_CHUNK_SIZE);
+            break;
+        }
+    }
+    fclose(fp);
+
+    // Single persistence commit for the whole file
+    if (stats.vehiclesAdded > 0 || stats.ownersAdded > 0 || stats.coOwners > 0)
+    {
+        invalidatePlateIndex();
+        invalidatePlateOrder();
+        saveVehicleData();
+        saveOwnerData();
+    }
+
+    if (stats.rejected > IMPORT_MAX_REPORTED)
+        printf("... %ld more invalid line(s) not shown\n", stats.rejected - IMPORT_MAX_REPORTED);
+    if (stats.full > 0)
+        printf("WARNING: %ld row(s) skipped, registry is full.\n", stats.full);
+    printf("Imported %ld vehicle(s), %ld new owner(s), %ld co-owner link(s); %ld duplicate(s), %ld invalid.\n",
+           stats.vehiclesAdded, stats.ownersAdded, stats.coOwners, stats.duplicates, stats.rejected);
+    printf("Import took %.1f ms\n", (monotonicNanos() - t0) / 1e6);
+    return lineNumber;
+}
+
+// Writes a field, quoting it when it holds a separator or a quote
+static void csvWriteField(FILE *fp, const char *text, int last)
+{
+    if (strpbrk(text, ",\"") == NULL)
+    {
+        fputs(text, fp);
+    }
+    else
+    {
+        fputc('"', fp);
+        for (; *text != 0; text++)
+        {
+            if (*text == '"')
+                fputc('"', fp);
+            fputc(*text, fp);
+        }
+        fputc('"', fp);
+    }
+    fputc(last ? '\n' : ',', fp);
+}
+
+// One row per owner link, primary owner first, in the layout importRegistryCsv reads
+long exportRegistryCsv(const char *path)
+{
+    FILE *fp = fopen(path, "w");
+    if (fp == NULL)
+    {
+        printf("ERROR: Cannot create %s\n", path);
+        return -1;
+    }
+    setvbuf(fp, NULL, _IOFBF, 1 << 16);
+
+    long rows = 0;
+    fprintf(fp, "license_plate,vehicle_type,owner_name,owner_phone,vehicle_id\n");
+    for (int i = 0; i < numVehicles; i++)
+    {
+        int link = vehicleFirstLink[i];
+        do
+        {
+            const Owner *owner = link == -1 ? NULL : &owners[ownerships[link].ownerIndex];
+            csvWriteField(fp, vehicles[i].licensePlate, 0);
+            csvWriteField(fp, vehicles[i].vehicleType, 0);
+            csvWriteField(fp, owner ? owner->name : "", 0);
+            csvWriteField(fp, owner ? owner->phoneNumber : "", 0);
+            csvWriteField(fp, vehicles[i].vehicleId, 1);
+            rows++;
+            if (link != -1)
+                link = ownerships[link].nextOfVehicle;
+        } while (link != -1);
+    }
+    fclose(fp);
+    printf("Exported %ld row(s) for %d vehicle(s) to %s\n", rows, numVehicles, path);
+    return rows;
+}
+
+// Camera Plate Reads
+// Reads are queued by the cameras and drained in batches. Each plate is matched
+// against the registry in three tiers: an exact lookup on its canonical form
+// (OCR look-alikes folded together), a deletion-neighbourhood lookup for one
+// edit, and a BK-tree search for up to PLATE_MAX_DISTANCE edits.
+
+void cameraGateMenu()
+{
+    int choice;
+    while (1)
+    {
+        printf("\n========== CAMERA PLATE READS ==========\n");
+        printf("Queued reads: %u of %d\n", plateQueueTail - plateQueueHead, PLATE_QUEUE_SIZE);
+        printf("1. Queue Entry Read\n");
+        printf("2. Queue Exit Read\n");
+        printf("3. Import Reads From File\n");
+        printf("4. Process Queued Reads\n");
+        printf("5. Match Plate\n");
+        printf("6. Back to Admin Menu\n");
+        printf("Enter choice: ");
+
+        if (scanf("%d", &choice) != 1)
+        {
+            printf("Invalid input.\n");
+            clearInputBuffer();
+            return;
+        }
+        clearInputBuffer();
+
+        char plate[LICENSE_PLATE_LEN];
+        switch (choice)
+        {
+        case 1:
+        case 2:
+            printf("Enter Plate As Read: ");
+            if (fgets(plate, sizeof(plate), stdin) == NULL)
+                break;
+            plate[strcspn(plate, "\n")] = 0;
+            if (!enqueuePlateRead(plate, choice == 1 ? GATE_ENTRY : GATE_EXIT, clockTick()))
+            {
+                printf("ERROR: Read queue is full, process it first.\n");
+            }
+            break;
+        case 3:
+            importPlateReads();
+            break;
+        case 4:
+            processPlateReads(1);
+            break;
+        case 5:
+        {
+            printf("Enter Plate: ");
+            if (fgets(plate, sizeof(plate), stdin) == NULL)
+                break;
+            plate[strcspn(plate, "\n")] = 0;
+
+            int distance;
+            long long t0 = monotonicNanos();
+            int vehicleIndex = matchPlate(plate, &distance);
+            long long elapsed = monotonicNanos() - t0;
+            if (vehicleIndex == PLATE_NO_MATCH)
+                printf("No registered plate within %d edits.\n", PLATE_MAX_DISTANCE);
+            else if (vehicleIndex == PLATE_AMBIGUOUS)
+                printf("Several plates match equally well (%d edits), no decision.\n", distance);
+            else
+                printf("Best match: %s (%s, %s), %d edit(s)\n", vehicles[vehicleIndex].licensePlate,
+                       vehicles[vehicleIndex].vehicleId, vehicles[vehicleIndex].isParked ? "parked" : "not parked",
+                       distance);
+            printf("Lookup took %.1f us\n", elapsed / 1000.0);
+            break;
+        }
+        case 6:
+            return;
+        default:
+            printf("Invalid choice.\n");
+        }
+    }
+}
+
+// Pipe-delimited lines: ENTRY|<plate>[|<unix time>] or EXIT|<plate>[|<unix time>]
+void importPlateReads()
+{
+    char path[200];
+    printf("Enter Reads File Path: ");
+    if (fgets(path, sizeof(path), stdin) == NULL)
+        return;
+    path[strcspn(path, "\n")] = 0;
+
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL)
+    {
+        printf("ERROR: Cannot open %s\n", path);
+        return;
+    }
+
+    // Reads without a timestamp all take the time the batch started
+    time_t batchTime = clockTick();
+    char line[200];
+    int queued = 0, skipped = 0;
+    while (fgets(line, sizeof(line), fp) != NULL)
+    {
+        line[strcspn(line, "\r\n")] = 0;
+        char *gateText = strtok(line, "|");
+        char *plate = strtok(NULL, "|");
+        char *timeText = strtok(NULL, "|");
+        if (gateText == NULL || plate == NULL || strlen(plate) >= LICENSE_PLATE_LEN ||
+            (strcmp(gateText, "ENTRY") != 0 && strcmp(gateText, "EXIT") != 0))
+        {
+            skipped++;
+            continue;
+        }
+        time_t readAt = timeText ? (time_t)atol(timeText) : batchTime;
+        if (!enqueuePlateRead(plate, strcmp(gateText, "ENTRY") == 0 ? GATE_ENTRY : GATE_EXIT, readAt))
+        {
+            printf("Read queue is full; processing before continuing.\n");
+            processPlateReads(1);
+            enqueuePlateRead(plate, strcmp(gateText, "ENTRY") == 0 ? GATE_ENTRY : GATE_EXIT, readAt);
+        }
+        queued++;
+    }
+    fclose(fp);
+    printf("Queued %d read(s), skipped %d malformed line(s).\n", queued, skipped);
+}
+
+// Returns 0 and counts a drop when the ring is full
+int enqueuePlateRead(const char *plate, int gate, time_t readAt)
+{
+    if (plateQueueTail - plateQueueHead >= PLATE_QUEUE_SIZE)
+    {
+        plateReadCount[PLATE_READ_DROPPED]++;
+        return 0;
+    }
+    PlateRead *read = &plateQueue[plateQueueTail & (PLATE_QUEUE_SIZE - 1)];
+    snprintf(read->plate, sizeof(read->plate), "%s", plate);
+    read->gate = gate;
+    read->readAt = readAt;
+    plateQueueTail++;
+    return 1;
+}
+
+// Drains the queue through the gate engine; data files are saved once per batch
+int processPlateReads(int verbose)
+{
+    int processed = 0, changed = 0, passChanged = 0, departed = 0;
+    while (plateQueueHead != plateQueueTail)
+    {
+        PlateRead *read = &plateQueue[plateQueueHead & (PLATE_QUEUE_SIZE - 1)];
+        plateQueueHead++;
+        processed++;
+
+        long long t0 = monotonicNanos();
+        int distance;
+        int vehicleIndex = matchPlate(read->plate, &distance);
+        recordOp(OP_PLATE_MATCH, t0);
+
+        const char *gateName = read->gate == GATE_ENTRY ? "ENTRY" : "EXIT";
+        if (vehicleIndex == PLATE_NO_MATCH || vehicleIndex == PLATE_AMBIGUOUS)
+        {
+            int outcome = vehicleIndex == PLATE_NO_MATCH ? PLATE_READ_NO_MATCH : PLATE_READ_AMBIGUOUS;
+            plateReadCount[outcome]++;
+            if (verbose)
+                printf("[%s] %-14s -> %s\n", gateName, read->plate,
+                       outcome == PLATE_READ_NO_MATCH ? "no match" : "ambiguous, needs an attendant");
+            continue;
+        }
+
+        long long gateStart = monotonicNanos();
+        GateResult result = read->gate == GATE_ENTRY ? gateParkVehicle(vehicleIndex, read->readAt)
+                                                     : gateUnparkVehicle(vehicleIndex, read->readAt);
+        recordOp(OP_GATE, gateStart);
+
+        if (result.status != GATE_OK)
+        {
+            plateReadCount[PLATE_READ_REJECTED]++;
+            // A full lot queues the car instead of refusing it at every read;
+            // an exit read of a car still waiting means the driver gave up
+            if (result.status == GATE_LOT_FULL)
+                waitlistJoin(vehicleIndex, result.passStatus == PASS_OK ? WAIT_PASS : WAIT_WALK_IN, read->readAt);
+            else if (result.status == GATE_NOT_PARKED)
+                waitlistLeave(vehicleIndex);
+            if (verbose && result.status == GATE_LOT_FULL && waitlistPosition(vehicleIndex) != 0)
+                printf("[%s] %-14s -> %s: lot full, waitlist position %d\n", gateName, read->plate,
+                       vehicles[vehicleIndex].vehicleId, waitlistPosition(vehicleIndex));
+            else if (verbose)
+                printf("[%s] %-14s -> %s: %s\n", gateName, read->plate, vehicles[vehicleIndex].vehicleId,
+                       result.status == GATE_LOT_FULL ? "lot full, waitlist full"
+                       : result.status == GATE_ALREADY_PARKED ? "already parked"
+                                                               : "not parked");
+            continue;
+        }
+
+        changed = 1;
+        passChanged |= result.isPassSession;
+        departed |= read->gate == GATE_EXIT;
+        plateReadCount[read->gate == GATE_ENTRY ? PLATE_READ_PARKED : PLATE_READ_UNPARKED]++;
+        if (verbose)
+        {
+            if (read->gate == GATE_ENTRY)
+                printf("[%s] %-14s -> %s (%s, %d edit(s)): spot %d\n", gateName, read->plate,
+                       vehicles[vehicleIndex].vehicleId, vehicles[vehicleIndex].licensePlate, distance,
+                       result.spotNumber);
+            else
+                printf("[%s] %-14s -> %s (%s, %d edit(s)): spot %d freed, fee TK- %.2f/=\n", gateName,
+                       read->plate, vehicles[vehicleIndex].vehicleId, vehicles[vehicleIndex].licensePlate,
+                       distance, result.spotNumber, result.fee);
+        }
+        if (result.admittedIndex != -1)
+        {
+            int admittedSpot = vehicles[result.admittedIndex].spotNumber;
+            passChanged |= spots[admittedSpot - 1].isPassSession;
+            if (verbose)
+                printf("[WAITLIST] %s (%s): spot %d\n", vehicles[result.admittedIndex].vehicleId,
+                       vehicles[result.admittedIndex].licensePlate, admittedSpot);
+        }
+    }
+
+    if (changed)
+    {
+        if (passChanged)
+            savePassData();
+        saveVehicleData();
+        saveParkingData();
+        if (departed)
+            saveForecastData();
+    }
+    if (verbose)
+        printf("Processed %d read(s).\n", processed);
+    maybeDumpMetrics();
+    return processed;
+}
+
+// Upper case, separators dropped, OCR look-alikes folded onto one symbol
+void canonicalPlate(const char *plate, char *out)
+{
+    int used = 0;
+    for (int i = 0; plate[i] != 0 && used < LICENSE_PLATE_LEN - 1; i++)
+    {
+        char c = (char)toupper((unsigned char)plate[i]);
+        if (!isalnum((unsigned char)c))
+            continue;
+        switch (c)
+        {
+        case 'O':
+        case 'Q':
+        case 'D':
+            c = '0';
+            break;
+        case 'I':
+        case 'L':
+            c = '1';
+            break;
+        case 'Z':
+            c = '2';
+            break;
+        case 'S':
+            c = '5';
+            break;
+        case 'G':
+            c = '6';
+            break;
+        case 'B':
+            c = '8';
+            break;
+        }
+        out[used++] = c;
+    }
+    out[used] = 0;
+}
+
+// Bit-parallel edit distance (Myers/Hyyro): one pass over the text, a handful of
+// word operations per character. peq holds the pattern's match masks per byte.
+static int plateDistance(const unsigned long long *peq, int patternLength, const char *text)
+{
+    if (patternLength == 0)
+        return (int)strlen(text);
+
+    unsigned long long high = 1ULL << (patternLength - 1);
+    unsigned long long pv = ~0ULL, mv = 0;
+    int score = patternLength;
+    for (int j = 0; text[j] != 0; j++)
+    {
+        unsigned long long eq = peq[(unsigned char)text[j]];
+        unsigned long long xv = eq | mv;
+        unsigned long long xh = (((eq & pv) + pv) ^ pv) | eq;
+        unsigned long long ph = mv | ~(xh | pv);
+        unsigned long long mh = pv & xh;
+        if (ph & high)
+            score++;
+        else if (mh & high)
+            score--;
+        ph = (ph << 1) | 1;
+        mh <<= 1;
+        pv = mh | ~(xv | ph);
+        mv = ph & xv;
+    }
+    return score;
+}
+
+static void plateBuildPeq(const char *pattern, unsigned long long *peq)
+{
+    memset(peq, 0, 256 * sizeof(unsigned long long));
+    for (int i = 0; pattern[i] != 0; i++)
+        peq[(unsigned char)pattern[i]] |= 1ULL << i;
+}
+
+void plateIndexAdd(int vehicleIndex)
+{
+    if (plateIndexStale)
+        return; // The next full build picks this vehicle up
+
+    PlateNode *node = &plateNodes[numPlateNodes];
+    canonicalPlate(vehicles[vehicleIndex].licensePlate, node->key);
+    node->vehicleIndex = vehicleIndex;
+    node->firstChild = -1;
+    node->nextSibling = -1;
+    node->duplicates = 0;
+
+    // The same canonical plate twice stays out of the tree and marks the first as ambiguous
+    int existing = indexFind(plateIndex, VEHICLE_INDEX_SIZE, node->key);
+    if (existing != -1)
+    {
+        plateNodes[existing].duplicates++;
+        return;
+    }
+    int nodeIndex = numPlateNodes++;
+    indexInsert(plateIndex, VEHICLE_INDEX_SIZE, node->key, nodeIndex);
+
+    // Every plate one deletion away; a run of equal characters yields one variant
+    char variant[LICENSE_PLATE_LEN];
+    int keyLength = (int)strlen(node->key);
+    for (int i = 0; i < keyLength; i++)
+    {
+        if (i > 0 && node->key[i] == node->key[i - 1])
+            continue;
+        memcpy(variant, node->key, i);
+        strcpy(variant + i, node->key + i + 1);
+        PlateVariant *entry = &plateVariants[numPlateVariants];
+        entry->hash = hashString(variant);
+        entry->node = nodeIndex;
+        entry->next = plateVariantHead[entry->hash % PLATE_VARIANT_BUCKETS];
+        plateVariantHead[entry->hash % PLATE_VARIANT_BUCKETS] = numPlateVariants++;
+    }
+    if (nodeIndex == 0)
+        return;
+
+    unsigned long long peq[256];
+    plateBuildPeq(node->key, peq);
+    int current = 0;
+    while (1)
+    {
+        int distance = plateDistance(peq, keyLength, plateNodes[current].key);
+        int child = plateNodes[current].firstChild;
+        while (child != -1 && plateNodes[child].distance != distance)
+            child = plateNodes[child].nextSibling;
+        if (child == -1)
+        {
+            node->distance = distance;
+            node->nextSibling = plateNodes[current].firstChild;
+            plateNodes[current].firstChild = nodeIndex;
+            return;
+        }
+        current = child;
+    }
+}
+
+// Loads, imports and removals only mark the index; the BK-tree build costs far
+// more than parsing the vehicle file, and many sessions never match a plate
+void invalidatePlateIndex()
+{
+    plateIndexStale = 1;
+}
+
+void ensurePlateIndex()
+{
+    if (!plateIndexStale)
+        return;
+    plateIndexStale = 0;
+    numPlateNodes = 0;
+    numPlateVariants = 0;
+    indexClear(plateIndex, VEHICLE_INDEX_SIZE);
+    for (int i = 0; i < PLATE_VARIANT_BUCKETS; i++)
+        plateVariantHead[i] = -1;
+    for (int i = 0; i < numVehicles; i++)
+        plateIndexAdd(i);
+}
+
+// Keeps the best one-edit candidate; a second distinct one makes the read ambiguous
+static void plateConsiderOneEdit(const unsigned long long *peq, int keyLength, int node, int *bestNode, int *tied)
+{
+    if (node == *bestNode || plateDistance(peq, keyLength, plateNodes[node].key) != 1)
+        return;
+    if (*bestNode == -1)
+    {
+        *bestNode = node;
+        *tied = plateNodes[node].duplicates > 0;
+    }
+    else
+    {
+        *tied = 1;
+    }
+}
+
+// Best registered vehicle for a camera read. Returns the vehicle index,
+// PLATE_NO_MATCH, or PLATE_AMBIGUOUS when two plates tie for the best distance.
+int matchPlate(const char *plate, int *distanceOut)
+{
+    static int stack[MAX_VEHICLES];
+    char key[LICENSE_PLATE_LEN];
+    ensurePlateIndex();
+    canonicalPlate(plate, key);
+    *distanceOut = 0;
+
+    int exact = indexFind(plateIndex, VEHICLE_INDEX_SIZE, key);
+    if (exact != -1)
+    {
+        histogramRecord(&plateLookupProbes, indexLastProbes);
+        return plateNodes[exact].duplicates ? PLATE_AMBIGUOUS : plateNodes[exact].vehicleIndex;
+    }
+    if (numPlateNodes == 0)
+        return PLATE_NO_MATCH;
+
+    unsigned long long peq[256];
+    plateBuildPeq(key, peq);
+    int keyLength = (int)strlen(key);
+
+    // One edit: a substitution leaves equal variants on both sides, an extra
+    // character in the registered plate leaves the read itself as its variant,
+    // a missing one leaves a variant of the read in the exact index
+    int bestNode = -1, tied = 0, visited = 0;
+    char variant[LICENSE_PLATE_LEN];
+    for (int i = 0; i <= keyLength; i++)
+    {
+        if (i > 0 && i < keyLength && key[i] == key[i - 1])
+            continue;
+        memcpy(variant, key, i);
+        strcpy(variant + i, i < keyLength ? key + i + 1 : "");
+        if (i == keyLength)
+            strcpy(variant, key);
+
+        unsigned int hash = hashString(variant);
+        for (int e = plateVariantHead[hash % PLATE_VARIANT_BUCKETS]; e != -1; e = plateVariants[e].next)
+        {
+            visited++;
+            if (plateVariants[e].hash == hash)
+                plateConsiderOneEdit(peq, keyLength, plateVariants[e].node, &bestNode, &tied);
+        }
+        if (i < keyLength)
+        {
+            int node = indexFind(plateIndex, VEHICLE_INDEX_SIZE, variant);
+            visited += indexLastProbes;
+            if (node != -1)
+                plateConsiderOneEdit(peq, keyLength, node, &bestNode, &tied);
+        }
+    }
+    if (bestNode != -1)
+    {
+        histogramRecord(&plateLookupProbes, visited);
+        *distanceOut = 1;
+        return tied ? PLATE_AMBIGUOUS : plateNodes[bestNode].vehicleIndex;
+    }
+
+    // The radius shrinks to the best distance found so far; equal distances are
+    // still visited so that ties are detected
+    int best = PLATE_MAX_DISTANCE + 1;
+    int depth = 0;
+    stack[depth++] = 0;
+    while (depth > 0)
+    {
+        int current = stack[--depth];
+        int distance = plateDistance(peq, keyLength, plateNodes[current].key);
+        visited++;
+        if (distance < best)
+        {
+            best = distance;
+            bestNode = current;
+            tied = plateNodes[current].duplicates > 0;
+        }
+        else if (distance == best)
+        {
+            tied = 1;
+        }
+
+        for (int child = plateNodes[current].firstChild; child != -1; child = plateNodes[child].nextSibling)
+        {
+            int edge = plateNodes[child].distance;
+            if (edge >= distance - best && edge <= distance + best)
+                stack[depth++] = child;
+        }
+    }
+    histogramRecord(&plateLookupProbes, visited);
+
+    if (bestNode == -1)
+        return PLATE_NO_MATCH;
+    *distanceOut = best;
+    return tied ? PLATE_AMBIGUOUS : plateNodes[bestNode].vehicleIndex;
+}
+
+// Occupancy Forecast
+// Every closed session adds one arrival to the hour of week it started in and
+// one departure to the hour of week it ended in. A forecast reads at most two
+// of those buckets, so it costs the same whatever the length of the history.
+
+// Monday 00:00-00:59 local time is bucket 0. Answers are cached for the rest
+// of their hour in a few slots (entry and exit of a session usually fall in
+// different hours), so the gate path rarely needs localtime, which allocates.
+// The reentrant form is used because glibc's localtime re-checks the zone file
+// on every call, which dominated journal replays.
+int hourOfWeek(time_t t)
+{
+    static struct
+    {
+        time_t start;
+        time_t end;
+        int bucket;
+    } cache[HOUR_CACHE_SLOTS];
+    int slot = (int)((unsigned long long)(t / 3600) & (HOUR_CACHE_SLOTS - 1));
+    if (t >= cache[slot].start && t < cache[slot].end)
+        return cache[slot].bucket;
+
+    struct tm localTime;
+#ifdef _WIN32
+    struct tm *local = localtime_s(&localTime, &t) == 0 ? &localTime : NULL;
+#else
+    struct tm *local = localtime_r(&t, &localTime);
+#endif
+    if (local == NULL)
+        return 0;
+    cache[slot].bucket = (local->tm_wday + 6) % 7 * 24 + local->tm_hour;
+    cache[slot].start = t - local->tm_min * 60 - local->tm_sec;
+    cache[slot].end = cache[slot].start + 3600;
+    return cache[slot].bucket;
+}
+
+void forecastRecordSession(time_t entryTime, time_t exitTime)
+{
+    if (entryTime <= 0 || exitTime < entryTime)
+        return;
+    hourStats[hourOfWeek(entryTime)].arrivals++;
+    hourStats[hourOfWeek(exitTime)].departures++;
+    if (forecastFirst == 0 || entryTime < forecastFirst)
+        forecastFirst = entryTime;
+    if (exitTime > forecastLast)
+        forecastLast = exitTime;
+}
+
+// Weeks of history behind each bucket, 0 when nothing has been recorded
+int forecastWeeks()
+{
+    if (forecastFirst == 0)
+        return 0;
+    return (int)((forecastLast - forecastFirst) / (7 * 24 * 3600)) + 1;
+}
+
+// Expected free spots `minutes` from now (up to 60): free spots now, plus the
+// average departures minus arrivals of the hour buckets the window overlaps
+double forecastFreeSpots(time_t now, int minutes, int occupiedNow)
+{
+    int weeks = forecastWeeks();
+    double freeNow = MAX_PARKING_SPOTS - occupiedNow;
+    if (weeks == 0)
+        return freeNow;
+
+    int bucket = hourOfWeek(now);
+    struct tm *local = localtime(&now);
+    double minutesLeftInHour = local ? 60 - local->tm_min - local->tm_sec / 60.0 : 60;
+    double firstPart = minutes < minutesLeftInHour ? minutes : minutesLeftInHour;
+    double secondPart = minutes - firstPart;
+    int next = (bucket + 1) % HOURS_PER_WEEK;
+
+    double arrivals = (hourStats[bucket].arrivals * firstPart + hourStats[next].arrivals * secondPart) / 60.0 / weeks;
+    double departures =
+        (hourStats[bucket].departures * firstPart + hourStats[next].departures * secondPart) / 60.0 / weeks;
+    if (departures > occupiedNow + arrivals)
+        departures = occupiedNow + arrivals; // Cannot free more spots than will be taken
+
+    double expected = freeNow + departures - arrivals;
+    if (expected < 0)
+        expected = 0;
+    if (expected > MAX_PARKING_SPOTS)
+        expected = MAX_PARKING_SPOTS;
+    return expected;
+}
+
+// Forecast Data Write
+void saveForecastData()
+{
+    long long t0 = monotonicNanos();
+    DataWriter writer;
+    if (!dataWriterOpen(&writer, "forecast/data.txt", 0))
+    {
+        printf("ERROR: Cannot create/open forecast data file!\n");
+        return;
+    }
+    dataWriterPrintf(&writer, "%ld|%ld\n", (long)forecastFirst, (long)forecastLast);
+    dataWriterPrintf(&writer, "%d\n", HOURS_PER_WEEK);
+    for (int b = 0; b < HOURS_PER_WEEK; b++)
+    {
+        dataWriterPrintf(&writer, "%d|%u|%u\n", b, hourStats[b].arrivals, hourStats[b].departures);
+    }
+
+    long written = dataWriterClose(&writer);
+    recordSave(SAVE_FORECAST, written, t0);
+}
+
+// Forecast Data Read
+void loadForecastData()
+{
+    memset(hourStats, 0, sizeof(hourStats));
+    forecastFirst = 0;
+    forecastLast = 0;
+
+    DataReader reader;
+    if (!dataReaderOpen(&reader, "forecast/data.txt"))
+    {
+        return;
+    }
+
+    // first observed|last observed, then <count> and bucket|arrivals|departures
+    FieldSpan field[3];
+    long first, last, count;
+    if (dataReaderNext(&reader, field, 2) < 2 || !spanToLong(field[0], &first) || !spanToLong(field[1], &last) ||
+        dataReaderNext(&reader, field, 1) < 1 || !spanToLong(field[0], &count))
+    {
+        dataReaderWarn(&reader, "bad forecast header");
+        dataReaderClose(&reader);
+        return;
+    }
+    forecastFirst = (time_t)first;
+    forecastLast = (time_t)last;
+
+    for (long n = 0; n < count; n++)
+    {
+        int bucket;
+        long arrivals, departures;
+        if (dataReaderNext(&reader, field, 3) < 3 || !spanToInt(field[0], &bucket) || bucket < 0 ||
+            bucket >= HOURS_PER_WEEK || !spanToLong(field[1], &arrivals) || !spanToLong(field[2], &departures) ||
+            arrivals < 0 || departures < 0)
+        {
+            dataReaderWarn(&reader, "bad forecast bucket");
+            continue;
+        }
+        hourStats[bucket].arrivals = (unsigned int)arrivals;
+        hourStats[bucket].departures = (unsigned int)departures;
+    }
+
+    dataReaderClose(&reader);
+}
+
+// Live Change Feed
+// Wallboards follow the lot through spot deltas instead of redrawing every spot.
+// Each subscriber has a bounded ring of changed spots and a bitmap of the spots
+// already queued, so a spot that changes again before the display polls costs a
+// bit test. When the ring is full the subscriber is flagged for a full redraw
+// instead of growing or blocking the gate.
+
+void liveDashboardMenu()
+{
+    int choice;
+    while (1)
+    {
+        printf("\n========== LIVE DASHBOARD ==========\n");
+        printf("Displays following the lot: %d of %d\n", numFeedSubscribers, MAX_FEED_SUBSCRIBERS);
+        printf("1. Show Changes Since Last View\n");
+        printf("2. Full Redraw\n");
+        printf("3. Back to Admin Menu\n");
+        printf("Enter choice: ");
+
+        if (scanf("%d", &choice) != 1)
+        {
+            printf("Invalid input.\n");
+            clearInputBuffer();
+            return;
+        }
+        clearInputBuffer();
+
+        switch (choice)
+        {
+        case 1:
+        case 2:
+            showDashboardChanges(choice == 2);
+            break;
+        case 3:
+            return;
+        default:
+            printf("Invalid choice.\n");
+        }
+    }
+}
+
+// The console is a subscriber like any wallboard; its first view is a full redraw
+void showDashboardChanges(int fullRedraw)
+{
+    if (dashboardSubscriber == -1)
+    {
+        dashboardSubscriber = feedSubscribe();
+        if (dashboardSubscriber == -1)
+        {
+            printf("ERROR: No free display slot.\n");
+            return;
+        }
+    }
+    if (fullRedraw)
+        feedSubscribers[dashboardSubscriber].needsResync = 1;
+
+    SpotEvent events[FEED_POLL_BATCH];
+    char timeText[30];
+    int count = feedPoll(dashboardSubscriber, events, FEED_POLL_BATCH);
+    if (count == FEED_RESYNC)
+    {
+        printf("\n--- Full Redraw: %d of %d spots occupied ---\n", occupiedCount, MAX_PARKING_SPOTS);
+        for (int i = 0; i < MAX_PARKING_SPOTS; i++)
+        {
+            if (spots[i].isOccupied)
+                printf("Spot %-4d OCCUPIED  %s\n", spots[i].spotNumber, spots[i].vehicleId);
+        }
+        printf("All other spots are free.\n");
+        return;
+    }
+
+    int total = 0;
+    while (count > 0)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            strftime(timeText, sizeof(timeText), "%Y-%m-%d %H:%M:%S", localtime(&events[i].changedAt));
+            if (events[i].isOccupied)
+                printf("%s  Spot %-4d OCCUPIED  %s\n", timeText, events[i].spotNumber, events[i].vehicleId);
+            else
+                printf("%s  Spot %-4d FREED\n", timeText, events[i].spotNumber);
+        }
+        total += count;
+        count = feedPoll(dashboardSubscriber, events, FEED_POLL_BATCH);
+    }
+    printf("%d spot(s) changed since the last view (%d of %d occupied).\n", total, occupiedCount,
+           MAX_PARKING_SPOTS);
+}
+
+// Returns the subscriber slot, or -1 when all slots are taken
+int feedSubscribe()
+{
+    for (int i = 0; i < MAX_FEED_SUBSCRIBERS; i++)
+    {
+        if (feedSubscribers[i].active)
+            continue;
+        memset(&feedSubscribers[i], 0, sizeof(FeedSubscriber));
+        feedSubscribers[i].active = 1;
+        feedSubscribers[i].needsResync = 1; // Starts from a full picture of the lot
+        if (i >= feedSubscriberLimit)
+            feedSubscriberLimit = i + 1;
+        numFeedSubscribers++;
+        return i;
+    }
+    return -1;
+}
+
+void feedUnsubscribe(int subscriber)
+{
+    if (subscriber < 0 || subscriber >= feedSubscriberLimit || !feedSubscribers[subscriber].active)
+        return;
+    feedSubscribers[subscriber].active = 0;
+    numFeedSubscribers--;
+    while (feedSubscriberLimit > 0 && !feedSubscribers[feedSubscriberLimit - 1].active)
+        feedSubscriberLimit--;
+}
+
+// Called by the gate engine after a spot changed. O(subscribers), no allocation.
+void feedPublish(int spotIndex, time_t now)
+{
+    spotChangedAt[spotIndex] = now;
+    feedPublished++;
+
+    unsigned long long bit = 1ULL << (spotIndex & 63);
+    for (int i = 0; i < feedSubscriberLimit; i++)
+    {
+        FeedSubscriber *sub = &feedSubscribers[i];
+        if (!sub->active || sub->needsResync)
+            continue;
+        if (sub->queued[spotIndex >> 6] & bit)
+        {
+            feedCoalesced++;
+            continue;
+        }
+        if (sub->tail - sub->head >= FEED_RING_SIZE)
+        {
+            // Dropping deltas would leave the display wrong; make it redraw instead
+            sub->needsResync = 1;
+            feedOverflows++;
+            continue;
+        }
+        sub->ring[sub->tail & (FEED_RING_SIZE - 1)] = spotIndex;
+        sub->tail++;
+        sub->queued[spotIndex >> 6] |= bit;
+    }
+}
+
+// After a reload or reset no delta stream is meaningful; every display redraws
+void feedResyncAll()
+{
+    for (int i = 0; i < feedSubscriberLimit; i++)
+    {
+        if (feedSubscribers[i].active)
+            feedSubscribers[i].needsResync = 1;
+    }
+}
+
+// Pops up to maxEvents changed spots with their current state. Returns the
+// count, or FEED_RESYNC when the display must redraw the lot from spots[];
+// the feed carries on with deltas from that point.
+int feedPoll(int subscriber, SpotEvent *events, int maxEvents)
+{
+    FeedSubscriber *sub = &feedSubscribers[subscriber];
+    if (sub->needsResync)
+    {
+        sub->needsResync = 0;
+        sub->head = sub->tail = 0;
+        memset(sub->queued, 0, sizeof(sub->queued));
+        return FEED_RESYNC;
+    }
+
+    int count = 0;
+    while (count < maxEvents && sub->head != sub->tail)
+    {
+        int spotIndex = sub->ring[sub->head & (FEED_RING_SIZE - 1)];
+        sub->head++;
+        sub->queued[spotIndex >> 6] &= ~(1ULL << (spotIndex & 63));
+
+        SpotEvent *event = &events[count++];
+        event->spotNumber = spots[spotIndex].spotNumber;
+        event->isOccupied = spots[spotIndex].isOccupied;
+        strcpy(event->vehicleId, spots[spotIndex].vehicleId);
+        event->changedAt = spotChangedAt[spotIndex];
+    }
+    return count;
+}
+
+// Overstay Alerts (Timer Wheel)
+// Every parked spot and every pass owns one timer slot. A spot's timer walks
+// through the stages long dwell -> overstay -> grace expired, re-armed as each
+// stage fires; a pass timer fires once at the end of its validity. Timers sit
+// in a hierarchical wheel of TIMER_LEVELS levels of TIMER_WHEEL_SLOTS slots
+// (one minute per level-0 slot, about 32 years at the top), so arming,
+// disarming and each tick are O(1) and nothing ever scans the lot. Fired
+// alerts go to the configured sink.
+
+static int timerListOf(int level, int slot)
+{
+    return level * TIMER_WHEEL_SLOTS + slot;
+}
+
+static void timerUnlink(int t)
+{
+    Timer *timer = &timers[t];
+    if (timer->prev != -1)
+        timers[timer->prev].next = timer->next;
+    else
+        timerListHead[timer->list] = timer->next;
+    if (timer->next != -1)
+        timers[timer->next].prev = timer->prev;
+    timer->armed = 0;
+    numTimersArmed--;
+}
+
+static void timerLink(int t, int list)
+{
+    Timer *timer = &timers[t];
+    timer->list = list;
+    timer->prev = -1;
+    timer->next = timerListHead[list];
+    if (timer->next != -1)
+        timers[timer->next].prev = t;
+    timerListHead[list] = t;
+    timer->armed = 1;
+    numTimersArmed++;
+}
+
+// Level = the highest block of TIMER_WHEEL_BITS bits in which the expiry differs from now
+static void timerPlace(int t)
+{
+    unsigned long long expiryTick = (unsigned long long)timers[t].expiresAt / TIMER_TICK_SECONDS;
+    if (timers[t].expiresAt <= 0 || expiryTick <= timerCurrentTick)
+    {
+        timerLink(t, TIMER_DUE_LIST);
+        return;
+    }
+    int level = 0;
+    while (level < TIMER_LEVELS - 1 &&
+           (expiryTick >> (TIMER_WHEEL_BITS * (level + 1))) != (timerCurrentTick >> (TIMER_WHEEL_BITS * (level + 1))))
+        level++;
+    int slot = (int)((expiryTick >> (TIMER_WHEEL_BITS * level)) & (TIMER_WHEEL_SLOTS - 1));
+    timerLink(t, timerListOf(level, slot));
+}
+
+void timerArm(int t, time_t expiresAt, int kind)
+{
+    if (timers[t].armed)
+        timerUnlink(t);
+    timers[t].expiresAt = expiresAt;
+    timers[t].kind = kind;
+    timerPlace(t);
+}
+
+void timerDisarm(int t)
+{
+    if (timers[t].armed)
+        timerUnlink(t);
+}
+
+// Empties the wheel and starts counting from `now` (startup, simulator, bench)
+void timerWheelReset(time_t now)
+{
+    for (int i = 0; i < TIMER_LISTS; i++)
+        timerListHead[i] = -1;
+    for (int i = 0; i < MAX_TIMERS; i++)
+        timers[i].armed = 0;
+    numTimersArmed = 0;
+    timerCurrentTick = (unsigned long long)now / TIMER_TICK_SECONDS;
+}
+
+// Stage timers for a car that entered at entryTime: the first stage still ahead of `now`
+void armSpotTimer(int spotIndex, time_t entryTime, time_t now)
+{
+    if (entryTime + LONG_DWELL_SECONDS > now)
+        timerArm(SPOT_TIMER(spotIndex), entryTime + LONG_DWELL_SECONDS, ALERT_LONG_DWELL);
+    else if (entryTime + OVERSTAY_SECONDS > now)
+        timerArm(SPOT_TIMER(spotIndex), entryTime + OVERSTAY_SECONDS, ALERT_OVERSTAY);
+    else if (entryTime + OVERSTAY_SECONDS + OVERSTAY_GRACE_SECONDS > now)
+        timerArm(SPOT_TIMER(spotIndex), entryTime + OVERSTAY_SECONDS + OVERSTAY_GRACE_SECONDS, ALERT_GRACE_EXPIRED);
+    else
+        timerDisarm(SPOT_TIMER(spotIndex));
+}
+
+static void timerFire(int t)
+{
+    Timer *timer = &timers[t];
+    AlertEvent event;
+    memset(&event, 0, sizeof(event));
+    event.kind = timer->kind;
+    event.at = timer->expiresAt;
+
+    if (t < MAX_PARKING_SPOTS)
+    {
+        ParkingSpot *spot = &spots[t];
+        if (!spot->isOccupied)
+            return;
+        event.spotNumber = spot->spotNumber;
+        strcpy(event.vehicleId, spot->vehicleId);
+        snprintf(event.detail, sizeof(event.detail), "parked %.1f hours",
+                 difftime(event.at, spot->entryTime) / 3600.0);
+        emitAlert(&event);
+
+        // Next stage of the same stay
+        if (timer->kind == ALERT_LONG_DWELL)
+            timerArm(t, spot->entryTime + OVERSTAY_SECONDS, ALERT_OVERSTAY);
+        else if (timer->kind == ALERT_OVERSTAY)
+            timerArm(t, spot->entryTime + OVERSTAY_SECONDS + OVERSTAY_GRACE_SECONDS, ALERT_GRACE_EXPIRED);
+        return;
+    }
+
+    // The gate may already have swept the lapsed pass; renewals and cancellations re-arm or disarm
+    Pass *pass = &passes[t - MAX_PARKING_SPOTS];
+    if (pass->validUntil != timer->expiresAt)
+        return;
+    strcpy(event.vehicleId, pass->vehicleId);
+    snprintf(event.detail, sizeof(event.detail), "pass of %s", pass->holderName);
+    emitAlert(&event);
+}
+
+static void timerFireList(int list)
+{
+    while (timerListHead[list] != -1)
+    {
+        int t = timerListHead[list];
+        timerUnlink(t);
+        timerFire(t); // May re-arm t, possibly straight onto the due list
+    }
+}
+
+// Moves the timers of one upper-level slot down to the levels below
+static void timerCascade(int level)
+{
+    int list = timerListOf(level, (int)((timerCurrentTick >> (TIMER_WHEEL_BITS * level)) & (TIMER_WHEEL_SLOTS - 1)));
+    int t = timerListHead[list];
+    timerListHead[list] = -1;
+    while (t != -1)
+    {
+        int next = timers[t].next;
+        numTimersArmed--;
+        timerPlace(t);
+        t = next;
+    }
+}
+
+// Fires everything due up to `now`. Cheap when called with the same minute again.
+void timerWheelAdvance(time_t now)
+{
+    unsigned long long targetTick = (unsigned long long)now / TIMER_TICK_SECONDS;
+    timerFireList(TIMER_DUE_LIST);
+    if (numTimersArmed == 0 && targetTick > timerCurrentTick)
+        timerCurrentTick = targetTick;
+
+    while (timerCurrentTick < targetTick)
+    {
+        timerCurrentTick++;
+        for (int level = TIMER_LEVELS - 1; level > 0; level--)
+        {
+            if ((timerCurrentTick & ((1ULL << (TIMER_WHEEL_BITS * level)) - 1)) == 0)
+                timerCascade(level);
+        }
+        timerFireList(timerListOf(0, (int)(timerCurrentTick & (TIMER_WHEEL_SLOTS - 1))));
+        timerFireList(TIMER_DUE_LIST);
+        if (numTimersArmed == 0)
+            timerCurrentTick = targetTick;
+    }
+}
+
+// Alert sinks. emitAlert keeps the counters and the console's recent list, the
+// sink decides where the line goes: the alert log file, a Unix datagram
+// socket, or nowhere (simulator and bench).
+
+void emitAlert(const AlertEvent *event)
+{
+    alertCount[event->kind]++;
+    recentAlerts[recentAlertCount % RECENT_ALERTS] = *event;
+    recentAlertCount++;
+
+    char line[160];
+    snprintf(line, sizeof(line), "%ld|%s|%d|%s|%s\n", (long)event->at, alertKindNames[event->kind],
+             event->spotNumber, event->vehicleId, event->detail);
+    alertSink(event, line);
+}
+
+void alertSinkNone(const AlertEvent *event, const char *line)
+{
+    (void)event;
+    (void)line;
+}
+
+void alertSinkFile(const AlertEvent *event, const char *line)
+{
+    (void)event;
+    DataWriter writer;
+    if (!dataWriterOpen(&writer, "alerts/alerts.log", 1))
+    {
+        alertsDropped++;
+        return;
+    }
+    dataWriterPrintf(&writer, "%s", line);
+    if (dataWriterClose(&writer) < 0)
+        alertsDropped++;
+}
+
+#ifndef _WIN32
+// Never blocks the caller: a reader that is missing or behind loses the line
+void alertSinkSocket(const AlertEvent *event, const char *line)
+{
+    static int fd = -1;
+    (void)event;
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", alertSocketPath);
+    if (fd < 0)
+        fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+    if (fd < 0 || sendto(fd, line, strlen(line), MSG_DONTWAIT, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+        alertsDropped++;
+}
+#endif
+
+// "none", "file" (alerts/alerts.log, the default) or "unix:<socket path>"
+int setAlertSink(const char *target)
+{
+    if (strcmp(target, "none") == 0)
+    {
+        alertSink = alertSinkNone;
+        return 1;
+    }
+    if (strcmp(target, "file") == 0)
+    {
+        alertSink = alertSinkFile;
+        return 1;
+    }
+#ifndef _WIN32
+    if (strncmp(target, "unix:", 5) == 0 && target[5] != 0)
+    {
+        snprintf(alertSocketPath, sizeof(alertSocketPath), "%s", target + 5);
+        alertSink = alertSinkSocket;
+        return 1;
+    }
+#endif
+    return 0;
+}
+
+// Lot Snapshots and Event Journal
+// Readers never lock the lot. Writers of spots[] (the gate engine, deletes,
+// loads) bump lotVersion before and after a change, so it is odd while one is
+// in progress (a seqlock). A report copies the occupied spots into an arena
+// snapshot and retries if the version moved meanwhile; the copy is cheap
+// compared with formatting, and the report then works on it alone.
+//
+// Every park, unpark and removal is also queued by the gate engine and
+// appended to journal/events.log with the next parking save:
+//   <unix time>|PARK|<spot>|<vehicle id>|<plate>|<hourly rate>
+//   <unix time>|UNPARK|<spot>|<vehicle id>|<plate>|<fee>
+//   <unix time>|REMOVE|<spot>|<vehicle id>|<plate>|0.00
+// Replaying it up to a time T gives the lot as it was at T.
+
+void lotWriteBegin()
+{
+    SEQ_STORE(lotVersion, lotVersion + 1);
+    SEQ_FENCE();
+}
+
+void lotWriteEnd()
+{
+    SEQ_FENCE();
+    SEQ_STORE(lotVersion, lotVersion + 1);
+}
+
+// Consistent copy of the occupied spots; rows come from the thread's arena
+void takeLotSnapshot(LotSnapshot *snapshot)
+{
+    snapshot->rows = arenaAlloc(threadArena(), sizeof(SnapshotRow) * MAX_PARKING_SPOTS);
+    while (1)
+    {
+        unsigned long version = SEQ_LOAD(lotVersion);
+        if (version & 1)
+        {
+            snapshotRetries++;
+            continue;
+        }
+
+        int count = 0;
+        for (int i = 0; i < MAX_PARKING_SPOTS && snapshot->rows != NULL; i++)
+        {
+            if (!spots[i].isOccupied)
+                continue;
+            SnapshotRow *row = &snapshot->rows[count++];
+            row->spotNumber = spots[i].spotNumber;
+            row->entryTime = spots[i].entryTime;
+            row->isPassSession = spots[i].isPassSession;
+            row->ratePerHour = spots[i].ratePerHour;
+            memcpy(row->vehicleId, spots[i].vehicleId, VEHICLE_ID_LEN);
+            row->vehicleId[VEHICLE_ID_LEN - 1] = 0;
+            int vehicleIndex = findVehicleById(row->vehicleId);
+            row->registered = vehicleIndex != -1;
+            if (row->registered)
+            {
+                memcpy(row->licensePlate, vehicles[vehicleIndex].licensePlate, LICENSE_PLATE_LEN);
+                memcpy(row->vehicleType, vehicles[vehicleIndex].vehicleType, VEHICLE_TYPE_LEN);
+                snprintf(row->ownerName, sizeof(row->ownerName), "%s", ownerNameOf(vehicleIndex));
+            }
+        }
+
+        SEQ_FENCE();
+        if (SEQ_LOAD(lotVersion) == version)
+        {
+            snapshot->count = count;
+            snapshot->version = version;
+            return;
+        }
+        snapshotRetries++;
+    }
+}
+
+// Queued by the gate engine, written by journalFlush (no I/O on the gate path)
+void journalRecord(int type, time_t at, int spotNumber, int vehicleIndex, double amount)
+{
+    journalRecordVehicle(type, at, spotNumber, vehicles[vehicleIndex].vehicleId, vehicles[vehicleIndex].licensePlate,
+                         amount);
+}
+
+// Same, for a vehicle that may already be gone from the registry
+void journalRecordVehicle(int type, time_t at, int spotNumber, const char *vehicleId, const char *licensePlate,
+                          double amount)
+{
+    if (!journalEnabled)
+        return;
+    if (journalPendingCount >= JOURNAL_PENDING_MAX)
+    {
+        journalDropped++;
+        return;
+    }
+    JournalEntry *entry = &journalPending[journalPendingCount++];
+    entry->type = type;
+    entry->at = at;
+    entry->spotNumber = spotNumber;
+    entry->amount = amount;
+    strcpy(entry->vehicleId, vehicleId);
+    strcpy(entry->licensePlate, licensePlate);
+}
+
+void journalFlush()
+{
+    if (journalPendingCount == 0)
+        return;
+    DataWriter writer;
+    if (!dataWriterOpen(&writer, "journal/events.log", 1))
+    {
+        printf("ERROR: Cannot open the event journal!\n");
+        return;
+    }
+    writer.durable = 1; // A flushed event survives a crash
+    for (int i = 0; i < journalPendingCount; i++)
+    {
+        JournalEntry *entry = &journalPending[i];
+        dataWriterPrintf(&writer, "%ld|%s|%d|%s|%s|%.2f\n", (long)entry->at, journalTypeNames[entry->type],
+                         entry->spotNumber, entry->vehicleId, entry->licensePlate, entry->amount);
+    }
+    if (dataWriterClose(&writer) >= 0)
+        journalEvents += journalPendingCount;
+    journalPendingCount = 0;
+}
+
+// Starts journaling; a new journal opens with the cars already parked, so replays start from a full lot
+void journalStart()
+{
+    DataReader reader;
+    if (dataReaderOpen(&reader, "journal/events.log"))
+    {
+        dataReaderClose(&reader);
+    }
+    else
+    {
+        DataWriter writer;
+        if (dataWriterOpen(&writer, "journal/events.log", 1))
+        {
+            for (int i = 0; i < MAX_PARKING_SPOTS; i++)
+            {
+                if (!spots[i].isOccupied)
+                    continue;
+                int vehicleIndex = findVehicleById(spots[i].vehicleId);
+                dataWriterPrintf(&writer, "%ld|PARK|%d|%s|%s|%.2f\n", (long)spots[i].entryTime, spots[i].spotNumber,
+                                 spots[i].vehicleId, vehicleIndex != -1 ? vehicles[vehicleIndex].licensePlate : "",
+                                 spots[i].ratePerHour);
+            }
+            dataWriterClose(&writer);
+        }
+    }
+    journalEnabled = 1;
+}
+
+// Replays the journal up to and including asOf. Returns the number of events
+// applied, or -1 when there is no journal. Rows come from the thread's arena.
+long lotStateAsOf(time_t asOf, LotSnapshot *snapshot, time_t *firstEvent)
+{
+    DataReader reader;
+    snapshot->count = 0;
+    *firstEvent = 0;
+    if (!dataReaderOpen(&reader, "journal/events.log"))
+        return -1;
+
+    SnapshotRow *state = arenaAlloc(threadArena(), sizeof(SnapshotRow) * MAX_PARKING_SPOTS);
+    snapshot->rows = arenaAlloc(threadArena(), sizeof(SnapshotRow) * MAX_PARKING_SPOTS);
+    if (state == NULL || snapshot->rows == NULL)
+    {
+        dataReaderClose(&reader);
+        return -1;
+    }
+    memset(state, 0, sizeof(SnapshotRow) * MAX_PARKING_SPOTS);
+
+    FieldSpan field[6];
+    long applied = 0;
+    int fields;
+    while ((fields = dataReaderNext(&reader, field, 6)) >= 0)
+    {
+        long at;
+        int spotNumber;
+        if (fields < 6 || !spanToLong(field[0], &at) || !spanToInt(field[2], &spotNumber) || spotNumber < 1 ||
+            spotNumber > MAX_PARKING_SPOTS)
+        {
+            dataReaderWarn(&reader, "malformed journal line");
+            continue;
+        }
+        if (*firstEvent == 0 || at < *firstEvent)
+            *firstEvent = at;
+        if (at > asOf)
+            continue;
+
+        SnapshotRow *row = &state[spotNumber - 1];
+        if (field[1].length == 4 && memcmp(field[1].start, "PARK", 4) == 0)
+        {
+            memset(row, 0, sizeof(SnapshotRow));
+            row->spotNumber = spotNumber;
+            row->entryTime = at;
+            row->registered = 1; // Marks the spot occupied while replaying
+            spanToText(field[3], row->vehicleId, sizeof(row->vehicleId));
+            spanToText(field[4], row->licensePlate, sizeof(row->licensePlate));
+            if (!spanToDouble(field[5], &row->ratePerHour))
+                row->ratePerHour = 0.0;
+            row->isPassSession = row->ratePerHour == 0.0;
+        }
+        else
+        {
+            row->registered = 0;
+        }
+        applied++;
+    }
+    dataReaderClose(&reader);
+
+    for (int i = 0; i < MAX_PARKING_SPOTS; i++)
+    {
+        if (state[i].registered)
+            snapshot->rows[snapshot->count++] = state[i];
+    }
+    snapshot->version = 0;
+    return applied;
+}
+
+void showLotStateAsOf()
+{
+    char text[40];
+    printf("Enter date and time (YYYY-MM-DD HH:MM): ");
+    if (fgets(text, sizeof(text), stdin) == NULL)
+        return;
+
+    struct tm when;
+    memset(&when, 0, sizeof(when));
+    if (sscanf(text, "%d-%d-%d %d:%d", &when.tm_year, &when.tm_mon, &when.tm_mday, &when.tm_hour, &when.tm_min) != 5)
+    {
+        printf("Invalid date and time.\n");
+        return;
+    }
+    when.tm_year -= 1900;
+    when.tm_mon -= 1;
+    when.tm_isdst = -1;
+    time_t asOf = mktime(&when);
+
+    LotSnapshot snapshot;
+    time_t firstEvent;
+    long applied = lotStateAsOf(asOf, &snapshot, &firstEvent);
+    if (applied < 0)
+    {
+        printf("No event journal yet.\n");
+        return;
+    }
+
+    char timeText[30];
+    strftime(timeText, sizeof(timeText), "%Y-%m-%d %H:%M", localtime(&asOf));
+    printf("\n========== LOT AS OF %s ==========\n", timeText);
+    if (firstEvent == 0 || asOf < firstEvent)
+    {
+        printf("The journal has no events before this time.\n");
+        return;
+    }
+    printf("Occupied: %d of %d (%ld event(s) replayed)\n", snapshot.count, MAX_PARKING_SPOTS, applied);
+    printf("%-4s %-15s %-15s %-17s %s\n", "Spot", "Vehicle ID", "License Plate", "Since", "Rate/hr");
+    for (int i = 0; i < snapshot.count; i++)
+    {
+        SnapshotRow *row = &snapshot.rows[i];
+        strftime(timeText, sizeof(timeText), "%Y-%m-%d %H:%M", localtime(&row->entryTime));
+        if (row->isPassSession)
+            printf("%-4d %-15s %-15s %-17s %s\n", row->spotNumber, row->vehicleId, row->licensePlate, timeText, "pass");
+        else
+            printf("%-4d %-15s %-15s %-17s %.2f\n", row->spotNumber, row->vehicleId, row->licensePlate, timeText,
+                   row->ratePerHour);
+    }
+}
+
+// Occupancy History
+// Every zone keeps one sample a minute: how many of its spots were taken when
+// the minute ended. The gate engine closes the minutes up to each park or
+// unpark (no I/O), and every SERIES_BLOCK_SAMPLES samples are sealed into a
+// block: the first value, then the zigzag-coded deltas packed at the bit width
+// of the largest one. Quiet stretches pack to a few bits a minute and
+// unchanged ones to the header alone. Each header also carries the block's
+// minimum, maximum and sum, so a chart bucket that covers whole blocks is
+// answered from the headers without unpacking anything.
+//
+// history/occupancy.dat holds the sealed blocks (header, then packed deltas,
+// in native byte order); history/open.dat the blocks still being filled.
+
+static int bitWidth(uint32_t value)
+{
+    int width = 0;
+    while (value >> width)
+        width++;
+    return width;
+}
+
+// Encodes count samples into header and payload; returns the payload size
+static int seriesEncode(int zone, int32_t startMinute, const uint16_t *values, int count, SeriesBlock *block,
+                        unsigned char *payload)
+{
+    memset(block, 0, sizeof(SeriesBlock));
+    block->startMinute = startMinute;
+    block->count = (uint16_t)count;
+    block->zone = (uint8_t)zone;
+    block->first = values[0];
+    block->minValue = values[0];
+    block->maxValue = values[0];
+
+    uint32_t zigzag[SERIES_BLOCK_SAMPLES];
+    uint32_t widest = 0;
+    for (int i = 0; i < count; i++)
+    {
+        block->sum += values[i];
+        if (values[i] < block->minValue)
+            block->minValue = values[i];
+        if (values[i] > block->maxValue)
+            block->maxValue = values[i];
+        if (i > 0)
+        {
+            int32_t delta = (int32_t)values[i] - (int32_t)values[i - 1];
+            zigzag[i] = delta >= 0 ? (uint32_t)delta << 1 : ((uint32_t)-delta << 1) - 1;
+            widest |= zigzag[i];
+        }
+    }
+    block->width = (uint8_t)bitWidth(widest);
+
+    uint64_t bits = 0;
+    int pending = 0, size = 0;
+    for (int i = 1; i < count; i++)
+    {
+        bits |= (uint64_t)zigzag[i] << pending;
+        pending += block->width;
+        while (pending >= 8)
+        {
+            payload[size++] = (unsigned char)bits;
+            bits >>= 8;
+            pending -= 8;
+        }
+    }
+    if (pending > 0)
+        payload[size++] = (unsigned char)bits;
+    return size;
+}
+
+static int seriesPayloadSize(const SeriesBlock *block)
+{
+    return (block->width * (block->count - 1) + 7) / 8;
+}
+
+static void seriesDecode(const SeriesBlock *block, const unsigned char *payload, uint16_t *values)
+{
+    uint32_t mask = (1u << block->width) - 1;
+    uint64_t bits = 0;
+    int pending = 0, used = 0;
+    values[0] = block->first;
+    for (int i = 1; i < block->count; i++)
+    {
+        while (pending < block->width)
+        {
+            bits |= (uint64_t)payload[used++] << pending;
+            pending += 8;
+        }
+        uint32_t zigzag = (uint32_t)bits & mask;
+        bits >>= block->width;
+        pending -= block->width;
+        int32_t delta = zigzag & 1 ? -(int32_t)((zigzag + 1) >> 1) : (int32_t)(zigzag >> 1);
+        values[i] = (uint16_t)(values[i - 1] + delta);
+    }
+    seriesBlocksDecoded++;
+}
+
+static void seriesSeal(int zone)
+{
+    SeriesStage *stage = &seriesStages[zone];
+    if (stage->count == 0)
+        return;
+    if (numSeriesBlocks >= SERIES_MAX_BLOCKS ||
+        seriesDataUsed + SERIES_BLOCK_SAMPLES * 3 > SERIES_DATA_BYTES) // Widest payload: 17 bits a delta
+    {
+        seriesDropped += stage->count;
+    }
+    else
+    {
+        SeriesBlock *block = &seriesBlocks[numSeriesBlocks++];
+        int size = seriesEncode(zone, stage->startMinute, stage->values, stage->count, block,
+                                seriesData + seriesDataUsed);
+        block->dataOffset = (uint32_t)seriesDataUsed;
+        seriesDataUsed += (size_t)size;
+    }
+    stage->startMinute += stage->count;
+    stage->count = 0;
+}
+
+void recountZones()
+{
+    memset(zoneOccupied, 0, sizeof(zoneOccupied));
+    for (int i = 0; i < MAX_PARKING_SPOTS; i++)
+    {
+        if (spots[i].isOccupied)
+            zoneOccupied[getSpotZone(spots[i].spotNumber)]++;
+    }
+}
+
+// Closes every minute before now with the current zone counts. The gate engine
+// calls it before it changes a spot, so a minute ends with the value it had.
+void seriesAdvance(time_t now)
+{
+    if (!seriesEnabled)
+        return;
+    int32_t minute = (int32_t)(now / 60);
+    for (int zone = 0; zone < NUM_ZONES; zone++)
+    {
+        SeriesStage *stage = &seriesStages[zone];
+        int32_t next = stage->startMinute + stage->count;
+        if (minute - next > SERIES_MAX_GAP_MINUTES)
+        {
+            // Down for longer than the series is worth filling in: start again from now
+            seriesSeal(zone);
+            stage->startMinute = minute;
+            continue;
+        }
+        for (; next < minute; next++)
+        {
+            stage->values[stage->count++] = (uint16_t)zoneOccupied[zone];
+            if (stage->count == SERIES_BLOCK_SAMPLES)
+                seriesSeal(zone);
+        }
+    }
+}
+
+void seriesReset(time_t now)
+{
+    numSeriesBlocks = 0;
+    numSeriesPersisted = 0;
+    seriesDataUsed = 0;
+    for (int zone = 0; zone < NUM_ZONES; zone++)
+    {
+        seriesStages[zone].startMinute = (int32_t)(now / 60);
+        seriesStages[zone].count = 0;
+    }
+}
+
+static void seriesAddSample(SeriesPoint *point, int value)
+{
+    if (point->samples == 0 || value < point->minValue)
+        point->minValue = value;
+    if (point->samples == 0 || value > point->maxValue)
+        point->maxValue = value;
+    point->sum += value;
+    point->samples++;
+}
+
+// Adds one block (or the open stage) to the buckets it overlaps
+static void seriesQueryBlock(const SeriesBlock *block, const unsigned char *payload, const uint16_t *values,
+                             int32_t fromMinute, int32_t toMinute, int bucketMinutes, SeriesPoint *out)
+{
+    int32_t start = block->startMinute;
+    int32_t end = start + block->count;
+    if (end <= fromMinute || start >= toMinute)
+        return;
+    if (start >= fromMinute && end <= toMinute &&
+        (start - fromMinute) / bucketMinutes == (end - 1 - fromMinute) / bucketMinutes)
+    {
+        // The whole block falls in one bucket: its header has all the bucket needs
+        SeriesPoint *point = &out[(start - fromMinute) / bucketMinutes];
+        if (point->samples == 0 || block->minValue < point->minValue)
+            point->minValue = block->minValue;
+        if (point->samples == 0 || block->maxValue > point->maxValue)
+            point->maxValue = block->maxValue;
+        point->sum += block->sum;
+        point->samples += block->count;
+        seriesBlocksSummarized++;
+        return;
+    }
+
+    uint16_t decoded[SERIES_BLOCK_SAMPLES];
+    if (values == NULL)
+    {
+        seriesDecode(block, payload, decoded);
+        values = decoded;
+    }
+    int32_t first = start > fromMinute ? start : fromMinute;
+    int32_t last = end < toMinute ? end : toMinute;
+    for (int32_t minute = first; minute < last; minute++)
+        seriesAddSample(&out[(minute - fromMinute) / bucketMinutes], values[minute - start]);
+}
+
+// Downsamples one zone over [from, to) into buckets of bucketMinutes, straight
+// from the compressed blocks. Returns the number of buckets filled in out.
+int seriesQuery(int zone, time_t from, time_t to, int bucketMinutes, SeriesPoint *out, int maxPoints)
+{
+    int32_t fromMinute = (int32_t)(from / 60);
+    int32_t toMinute = (int32_t)(to / 60);
+    if (toMinute <= fromMinute || bucketMinutes <= 0)
+        return 0;
+    int points = (toMinute - fromMinute + bucketMinutes - 1) / bucketMinutes;
+    if (points > maxPoints)
+    {
+        points = maxPoints;
+        toMinute = fromMinute + points * bucketMinutes;
+    }
+    memset(out, 0, sizeof(SeriesPoint) * points);
+
+    for (int b = 0; b < numSeriesBlocks; b++)
+    {
+        if (seriesBlocks[b].zone == zone)
+            seriesQueryBlock(&seriesBlocks[b], seriesData + seriesBlocks[b].dataOffset, NULL, fromMinute, toMinute,
+                             bucketMinutes, out);
+    }
+    SeriesStage *stage = &seriesStages[zone];
+    if (stage->count > 0)
+    {
+        SeriesBlock open;
+        unsigned char payload[SERIES_BLOCK_SAMPLES * 3];
+        seriesEncode(zone, stage->startMinute, stage->values, stage->count, &open, payload);
+        seriesQueryBlock(&open, NULL, stage->values, fromMinute, toMinute, bucketMinutes, out);
+    }
+    return points;
+}
+
+// Sealed blocks are appended once; the open ones are rewritten on every save
+void seriesFlush()
+{
+    if (!seriesEnabled)
+        return;
+    DataWriter writer;
+    if (numSeriesPersisted < numSeriesBlocks && dataWriterOpen(&writer, "history/occupancy.dat", 1))
+    {
+        for (int b = numSeriesPersisted; b < numSeriesBlocks; b++)
+        {
+            dataWriterBytes(&writer, &seriesBlocks[b], sizeof(SeriesBlock));
+            dataWriterBytes(&writer, seriesData + seriesBlocks[b].dataOffset, seriesPayloadSize(&seriesBlocks[b]));
+        }
+        if (dataWriterClose(&writer) >= 0)
+            numSeriesPersisted = numSeriesBlocks;
+    }
+
+    if (!dataWriterOpen(&writer, "history/open.dat", 0))
+        return;
+    for (int zone = 0; zone < NUM_ZONES; zone++)
+    {
+        SeriesStage *stage = &seriesStages[zone];
+        if (stage->count == 0)
+            continue;
+        SeriesBlock open;
+        unsigned char payload[SERIES_BLOCK_SAMPLES * 3];
+        int size = seriesEncode(zone, stage->startMinute, stage->values, stage->count, &open, payload);
+        dataWriterBytes(&writer, &open, sizeof(SeriesBlock));
+        dataWriterBytes(&writer, payload, size);
+    }
+    dataWriterClose(&writer);
+}
+
+// Calls fn for every well-formed block of a history file; returns 0 if the file is missing
+static int seriesReadFile(const char *relative, void (*fn)(const SeriesBlock *, const unsigned char *))
+{
+    DataReader reader;
+    if (!dataReaderOpen(&reader, relative))
+        return 0;
+    size_t pos = 0;
+    while (pos + sizeof(SeriesBlock) <= reader.size)
+    {
+        SeriesBlock block;
+        memcpy(&block, reader.data + pos, sizeof(SeriesBlock));
+        pos += sizeof(SeriesBlock);
+        int size = block.count > 0 ? seriesPayloadSize(&block) : 0;
+        if (block.count == 0 || block.count > SERIES_BLOCK_SAMPLES || block.zone >= NUM_ZONES || block.width > 17 ||
+            pos + (size_t)size > reader.size)
+        {
+            printf("WARNING: %s: damaged history block, the rest is skipped\n", relative);
+            break;
+        }
+        fn(&block, (const unsigned char *)reader.data + pos);
+        pos += (size_t)size;
+    }
+    dataReaderClose(&reader);
+    return 1;
+}
+
+static void seriesLoadSealed(const SeriesBlock *block, const unsigned char *payload)
+{
+    int size = seriesPayloadSize(block);
+    if (numSeriesBlocks >= SERIES_MAX_BLOCKS || seriesDataUsed + (size_t)size > SERIES_DATA_BYTES)
+    {
+        seriesDropped += block->count;
+        return;
+    }
+    SeriesBlock *copy = &seriesBlocks[numSeriesBlocks++];
+    *copy = *block;
+    copy->dataOffset = (uint32_t)seriesDataUsed;
+    memcpy(seriesData + seriesDataUsed, payload, (size_t)size);
+    seriesDataUsed += (size_t)size;
+    seriesStages[block->zone].startMinute = block->startMinute + block->count;
+}
+
+static void seriesLoadOpen(const SeriesBlock *block, const unsigned char *payload)
+{
+    SeriesStage *stage = &seriesStages[block->zone];
+    // Only resumes where the sealed blocks left off
+    if (stage->count == 0 && (stage->startMinute == block->startMinute || stage->startMinute == 0))
+    {
+        seriesDecode(block, payload, stage->values);
+        stage->startMinute = block->startMinute;
+        stage->count = block->count;
+    }
+}
+
+// Loads the history and starts recording; minutes while the program was down
+// are filled in with the occupancy it was left with
+void seriesStart()
+{
+    memset(seriesStages, 0, sizeof(seriesStages));
+    numSeriesBlocks = 0;
+    seriesDataUsed = 0;
+    seriesReadFile("history/occupancy.dat", seriesLoadSealed);
+    numSeriesPersisted = numSeriesBlocks;
+    seriesReadFile("history/open.dat", seriesLoadOpen);
+
+    time_t now = clockNow();
+    for (int zone = 0; zone < NUM_ZONES; zone++)
+    {
+        if (seriesStages[zone].startMinute == 0)
+            seriesStages[zone].startMinute = (int32_t)(now / 60);
+    }
+    seriesEnabled = 1;
+    seriesAdvance(now);
+}
+
+void showOccupancyHistory()
+{
+    static const struct
+    {
+        const char *name;
+        int bucketMinutes;
+        int buckets;
+        const char *labelFormat;
+    } views[] = {
+        {"Last day, hourly", 60, 24, "%a %H:00"},
+        {"Last week, daily", 24 * 60, 7, "%a %m-%d"},
+        {"Last month, daily", 24 * 60, 30, "%a %m-%d"},
+        {"Last year, weekly", 7 * 24 * 60, 53, "%Y-%m-%d"},
+    };
+    int numViews = (int)(sizeof(views) / sizeof(views[0]));
+
+    printf("\n========== OCCUPANCY HISTORY ==========\n");
+    for (int v = 0; v < numViews; v++)
+        printf("%d. %s\n", v + 1, views[v].name);
+    printf("Enter choice: ");
+    int choice;
+    if (scanf("%d", &choice) != 1)
+        choice = 0;
+    clearInputBuffer();
+    if (choice < 1 || choice > numViews)
+    {
+        printf("Invalid choice.\n");
+        return;
+    }
+
+    int bucketMinutes = views[choice - 1].bucketMinutes;
+    int buckets = views[choice - 1].buckets;
+    time_t now = clockNow();
+    seriesAdvance(now);
+    // Buckets end at the next local hour or midnight, so the last one is still filling
+    struct tm boundary = *localtime(&now);
+    boundary.tm_sec = 0;
+    boundary.tm_min = 0;
+    if (bucketMinutes >= 24 * 60)
+    {
+        boundary.tm_hour = 0;
+        boundary.tm_mday++;
+    }
+    else
+    {
+        boundary.tm_hour++;
+    }
+    boundary.tm_isdst = -1;
+    time_t to = mktime(&boundary);
+    time_t from = to - (time_t)bucketMinutes * 60 * buckets;
+
+    SeriesPoint *points = arenaAlloc(threadArena(), sizeof(SeriesPoint) * buckets * NUM_ZONES);
+    if (points == NULL)
+        return;
+    for (int zone = 0; zone < NUM_ZONES; zone++)
+        seriesQuery(zone, from, to, bucketMinutes, points + zone * buckets, buckets);
+
+    printf("\nAverage occupied spots per zone (%d spots each)\n", SPOTS_PER_ZONE);
+    printf("%-16s", "Period");
+    for (int zone = 0; zone < NUM_ZONES; zone++)
+        printf(" Zone %c", 'A' + zone);
+    printf("   Lot  Peak\n");
+    for (int b = 0; b < buckets; b++)
+    {
+        char label[24];
+        time_t bucketStart = from + (time_t)b * bucketMinutes * 60;
+        strftime(label, sizeof(label), views[choice - 1].labelFormat, localtime(&bucketStart));
+        printf("%-16s", label);
+        double lotAverage = 0.0;
+        int peak = 0, recorded = 0;
+        for (int zone = 0; zone < NUM_ZONES; zone++)
+        {
+            SeriesPoint *point = &points[zone * buckets + b];
+            if (point->samples == 0)
+            {
+                printf(" %6s", "-");
+                continue;
+            }
+            double average = (double)point->sum / point->samples;
+            printf(" %6.1f", average);
+            lotAverage += average;
+            peak += point->maxValue; // Zone peaks may not coincide, so this is an upper bound
+            recorded = 1;
+        }
+        if (recorded)
+            printf(" %5.1f %5d\n", lotAverage, peak);
+        else
+            printf(" %5s %5s\n", "-", "-");
+    }
+}
+
+// Entry Waitlist
+// A car that finds the lot full can wait at the gate in one of three FIFOs:
+// pass holders, reservations, then walk-ins. The queues are threaded through a
+// fixed pool of entries, and every released spot goes straight to the head of
+// the first non-empty queue, so admission costs the same however long the
+// queues are. The expected wait is the number of cars ahead times the smoothed
+// time between spot releases.
+
+static void waitlistUnlink(int entry)
+{
+    WaitEntry *wait = &waitEntries[entry];
+    if (wait->prev != -1)
+        waitEntries[wait->prev].next = wait->next;
+    else
+        waitHead[wait->waitClass] = wait->next;
+    if (wait->next != -1)
+        waitEntries[wait->next].prev = wait->prev;
+    else
+        waitTail[wait->waitClass] = wait->prev;
+    waitDepth[wait->waitClass]--;
+    vehicleWaitEntry[wait->vehicleIndex] = 0;
+
+    wait->next = waitFreeList;
+    waitFreeList = entry;
+}
+
+void waitlistClear()
+{
+    for (int c = 0; c < NUM_WAIT_CLASSES; c++)
+    {
+        waitHead[c] = -1;
+        waitTail[c] = -1;
+        waitDepth[c] = 0;
+    }
+    waitFreeList = -1;
+    waitEntriesUsed = 0;
+    memset(vehicleWaitEntry, 0, sizeof(vehicleWaitEntry));
+}
+
+// Returns 0 when the waitlist is full; a vehicle already waiting keeps its place
+int waitlistJoin(int vehicleIndex, int waitClass, time_t now)
+{
+    if (vehicleWaitEntry[vehicleIndex])
+        return 1;
+
+    int entry = waitFreeList;
+    if (entry != -1)
+        waitFreeList = waitEntries[entry].next;
+    else if (waitEntriesUsed < WAITLIST_MAX)
+        entry = waitEntriesUsed++;
+    else
+    {
+        waitRefused++;
+        return 0;
+    }
+
+    WaitEntry *wait = &waitEntries[entry];
+    wait->vehicleIndex = vehicleIndex;
+    wait->waitClass = waitClass;
+    wait->queuedAt = now;
+    wait->prev = waitTail[waitClass];
+    wait->next = -1;
+    if (waitTail[waitClass] != -1)
+        waitEntries[waitTail[waitClass]].next = entry;
+    else
+        waitHead[waitClass] = entry;
+    waitTail[waitClass] = entry;
+    waitDepth[waitClass]++;
+    waitQueued[waitClass]++;
+    vehicleWaitEntry[vehicleIndex] = entry + 1;
+    return 1;
+}
+
+// The driver gave up, or the vehicle left the registry
+void waitlistLeave(int vehicleIndex)
+{
+    if (!vehicleWaitEntry[vehicleIndex])
+        return;
+    int entry = vehicleWaitEntry[vehicleIndex] - 1;
+    waitLeft[waitEntries[entry].waitClass]++;
+    waitlistUnlink(entry);
+}
+
+// Called by gateOccupySpot: a waiting vehicle that gets a spot leaves the queue
+void waitlistParked(int vehicleIndex, time_t now)
+{
+    if (!vehicleWaitEntry[vehicleIndex])
+        return;
+    int entry = vehicleWaitEntry[vehicleIndex] - 1;
+    int waitClass = waitEntries[entry].waitClass;
+    waitAdmitted[waitClass]++;
+    if (now > waitEntries[entry].queuedAt)
+        waitSeconds[waitClass] += (unsigned long long)(now - waitEntries[entry].queuedAt);
+    waitlistUnlink(entry);
+}
+
+// Keeps vehicle indexes right after removeVehicleAt closed the gap at removed
+void waitlistVehicleRemoved(int removed)
+{
+    for (int c = 0; c < NUM_WAIT_CLASSES; c++)
+    {
+        for (int entry = waitHead[c]; entry != -1; entry = waitEntries[entry].next)
+        {
+            if (waitEntries[entry].vehicleIndex > removed)
+                waitEntries[entry].vehicleIndex--;
+        }
+    }
+}
+
+// Place in admission order (1 = next in), or 0 when the vehicle is not waiting
+int waitlistPosition(int vehicleIndex)
+{
+    if (!vehicleWaitEntry[vehicleIndex])
+        return 0;
+    int entry = vehicleWaitEntry[vehicleIndex] - 1;
+    int position = 1;
+    for (int c = 0; c < waitEntries[entry].waitClass; c++)
+        position += waitDepth[c];
+    for (int e = waitEntries[entry].prev; e != -1; e = waitEntries[e].prev)
+        position++;
+    return position;
+}
+
+// Seconds until the car at this position gets a spot, or -1 before any release was seen
+long waitlistExpectedWait(int position)
+{
+    if (waitReleaseGap <= 0.0)
+        return -1;
+    return (long)(position * waitReleaseGap + 0.5);
+}
+
+// Gate engine side of a spot release: no I/O. Parks the head of the first
+// non-empty queue and returns its vehicle index, or -1 when nobody waits.
+int waitlistAdmit(time_t now)
+{
+    if (waitLastRelease != 0 && now >= waitLastRelease)
+    {
+        double gap = (double)(now - waitLastRelease);
+        waitReleaseGap = waitReleaseGap <= 0.0 ? gap
+                                               : waitReleaseGap + WAIT_GAP_SMOOTHING * (gap - waitReleaseGap);
+    }
+    waitLastRelease = now;
+
+    for (int c = 0; c < NUM_WAIT_CLASSES; c++)
+    {
+        if (waitHead[c] == -1)
+            continue;
+        int vehicleIndex = waitEntries[waitHead[c]].vehicleIndex;
+        GateResult result = gateParkVehicle(vehicleIndex, now);
+        return result.status == GATE_OK ? vehicleIndex : -1;
+    }
+    return -1;
+}
+
+static void printExpectedWait(int position)
+{
+    long seconds = waitlistExpectedWait(position);
+    if (seconds < 0)
+        printf("Expected wait: unknown (no spot released yet)\n");
+    else
+        printf("Expected wait: about %ld min\n", (seconds + 59) / 60);
+}
+
+// Offered by parkVehicle when the lot is full
+void offerWaitlist(int vehicleIndex, int passStatus, time_t now)
+{
+    int position = waitlistPosition(vehicleIndex);
+    if (position != 0)
+    {
+        printf("Vehicle is already on the waitlist.\n");
+    }
+    else
+    {
+        int waitClass = WAIT_PASS;
+        int choice;
+        if (passStatus == PASS_OK)
+            printf("Join the waitlist as a pass holder? (1. Yes, 0. No): ");
+        else
+            printf("Join the waitlist? (1. Reservation, 2. Walk-in, 0. No): ");
+        if (scanf("%d", &choice) != 1)
+            choice = 0;
+        clearInputBuffer();
+        if (choice != 1 && (choice != 2 || passStatus == PASS_OK))
+        {
+            printf("Vehicle not queued.\n");
+            return;
+        }
+        if (passStatus != PASS_OK)
+            waitClass = choice == 1 ? WAIT_RESERVED : WAIT_WALK_IN;
+        if (!waitlistJoin(vehicleIndex, waitClass, now))
+        {
+            printf("ERROR: The waitlist is full (%d vehicles).\n", WAITLIST_MAX);
+            return;
+        }
+        position = waitlistPosition(vehicleIndex);
+        printf("Vehicle queued as %s.\n", waitClassLabels[waitClass]);
+    }
+    printf("Waitlist position: %d\n", position);
+    printExpectedWait(position);
+}
+
+// Console side of an admission: announce it and keep the pass usage on disk
+void announceAdmission(int vehicleIndex)
+{
+    if (vehicleIndex == -1)
+        return;
+    int spotNumber = vehicles[vehicleIndex].spotNumber;
+    printf("WAITLIST: %s (%s) admitted to spot %d (Zone %c)\n", vehicles[vehicleIndex].vehicleId,
+           vehicles[vehicleIndex].licensePlate, spotNumber, 'A' + getSpotZone(spotNumber));
+    if (spots[spotNumber - 1].isPassSession)
+        savePassData();
+}
+
+void viewWaitlist()
+{
+    time_t now = clockNow();
+    int position = 1;
+    printf("\n------- Entry Waitlist -------\n");
+    if (waitDepth[WAIT_PASS] + waitDepth[WAIT_RESERVED] + waitDepth[WAIT_WALK_IN] == 0)
+    {
+        printf("No vehicles waiting.\n");
+        return;
+    }
+    printf("%-4s %-12s %-12s %-15s %s\n", "Pos", "Class", "Vehicle ID", "License", "Waiting");
+    for (int c = 0; c < NUM_WAIT_CLASSES; c++)
+    {
+        for (int entry = waitHead[c]; entry != -1; entry = waitEntries[entry].next, position++)
+        {
+            Vehicle *vehicle = &vehicles[waitEntries[entry].vehicleIndex];
+            printf("%-4d %-12s %-12s %-15s %ld min\n", position, waitClassLabels[c], vehicle->vehicleId,
+                   vehicle->licensePlate, (long)(now - waitEntries[entry].queuedAt) / 60);
+        }
+    }
+    printf("A walk-in joining now would be number %d.\n", position);
+    printExpectedWait(position);
+
+    char vehicleId[VEHICLE_ID_LEN];
+    printf("Vehicle ID that left the queue (Enter to go back): ");
+    if (fgets(vehicleId, sizeof(vehicleId), stdin) == NULL)
+        return;
+    vehicleId[strcspn(vehicleId, "\n")] = 0;
+    if (vehicleId[0] == 0)
+        return;
+    int vehicleIndex = findVehicleById(vehicleId);
+    if (vehicleIndex == -1 || !vehicleWaitEntry[vehicleIndex])
+    {
+        printf("ERROR: Vehicle is not on the waitlist.\n");
+        return;
+    }
+    waitlistLeave(vehicleIndex);
+    printf("Vehicle %s removed from the waitlist.\n", vehicleId);
+}
+
+// Search Indexes
+// Three indexes back the search screens. Vehicles sit in an array sorted by
+// plate, so a prefix is one contiguous run found by two binary searches. Owners
+// are indexed by the trigrams of their names: a "contains" query walks the
+// shortest posting list among its trigrams and checks each candidate's name.
+// Parked spots sit in an array sorted by entry time, for range queries. Single
+// adds, removals, parks and unparks update them in place; loads and imports
+// only mark the plate order, which is sorted again on the next search.
+
+static int comparePlateOrder(const void *a, const void *b)
+{
+    int left = *(const int *)a, right = *(const int *)b;
+    int order = strcmp(vehicles[left].licensePlate, vehicles[right].licensePlate);
+    return order != 0 ? order : left - right;
+}
+
+void invalidatePlateOrder()
+{
+    plateOrderStale = 1;
+}
+
+void ensurePlateOrder()
+{
+    // Bulk paths that bypass plateOrderAdd (simulator, replay) still change the count
+    if (!plateOrderStale && plateOrderCount == numVehicles)
+        return;
+    plateOrderStale = 0;
+    plateOrderCount = numVehicles;
+    for (int i = 0; i < numVehicles; i++)
+        plateOrder[i] = i;
+    qsort(plateOrder, plateOrderCount, sizeof(int), comparePlateOrder);
+}
+
+// First position whose plate compares above (or, with after = 0, not below) the
+// first length characters of key
+static int plateOrderBound(const char *key, int length, int after)
+{
+    int low = 0, high = plateOrderCount;
+    while (low < high)
+    {
+        int mid = (low + high) / 2;
+        int order = strncmp(vehicles[plateOrder[mid]].licensePlate, key, length);
+        if (order < 0 || (after && order == 0))
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return low;
+}
+
+// Called for a vehicle just appended to the table (the highest index)
+void plateOrderAdd(int vehicleIndex)
+{
+    if (plateOrderStale || plateOrderCount != vehicleIndex)
+    {
+        plateOrderStale = 1;
+        return;
+    }
+    const char *plate = vehicles[vehicleIndex].licensePlate;
+    int pos = plateOrderBound(plate, LICENSE_PLATE_LEN, 1);
+    memmove(&plateOrder[pos + 1], &plateOrder[pos], (plateOrderCount - pos) * sizeof(int));
+    plateOrder[pos] = vehicleIndex;
+    plateOrderCount++;
+}
+
+// Called by removeVehicleAt before the table closes the gap
+void plateOrderRemove(int vehicleIndex)
+{
+    if (plateOrderStale || plateOrderCount != numVehicles)
+    {
+        plateOrderStale = 1;
+        return;
+    }
+    int pos = plateOrderBound(vehicles[vehicleIndex].licensePlate, LICENSE_PLATE_LEN, 0);
+    while (pos < plateOrderCount && plateOrder[pos] != vehicleIndex)
+        pos++;
+    if (pos == plateOrderCount)
+    {
+        plateOrderStale = 1;
+        return;
+    }
+    memmove(&plateOrder[pos], &plateOrder[pos + 1], (plateOrderCount - pos - 1) * sizeof(int));
+    plateOrderCount--;
+    for (int i = 0; i < plateOrderCount; i++)
+    {
+        if (plateOrder[i] > vehicleIndex)
+            plateOrder[i]--;
+    }
+}
+
+// Vehicles whose plate starts with prefix, from the offset-th match on.
+// Returns the number written to out; *total gets the number of matches.
+int searchPlatePrefix(const char *prefix, int offset, int *out, int max, int *total)
+{
+    ensurePlateOrder();
+    int length = (int)strlen(prefix);
+    int first = plateOrderBound(prefix, length, 0);
+    int last = plateOrderBound(prefix, length, 1);
+    *total = last - first;
+    int count = 0;
+    for (int pos = first + offset; pos < last && count < max; pos++)
+        out[count++] = plateOrder[pos];
+    return count;
+}
+
+// Letters fold to lower case and digits keep their own codes; everything else shares one
+static int trigramCode(unsigned char c)
+{
+    if (c >= 'a' && c <= 'z')
+        return c - 'a';
+    if (c >= 'A' && c <= 'Z')
+        return c - 'A';
+    if (c >= '0' && c <= '9')
+        return 26 + c - '0';
+    return c == ' ' ? 36 : 37;
+}
+
+static int trigramAt(const char *text)
+{
+    return (trigramCode(text[0]) * TRIGRAM_ALPHABET + trigramCode(text[1])) * TRIGRAM_ALPHABET +
+           trigramCode(text[2]);
+}
+
+void ownerTrigramsClear()
+{
+    memset(trigramFirst, 0, sizeof(trigramFirst));
+    memset(trigramLast, 0, sizeof(trigramLast));
+    memset(trigramCount, 0, sizeof(trigramCount));
+    numTrigramPostings = 0;
+}
+
+// Owners are only ever appended, so every posting list stays in owner order
+void ownerTrigramsAdd(int ownerIndex)
+{
+    const char *name = owners[ownerIndex].name;
+    int length = (int)strlen(name);
+    for (int i = 0; i + 3 <= length; i++)
+    {
+        int trigram = trigramAt(name + i);
+        int last = trigramLast[trigram];
+        if (last != 0 && trigramPostings[last - 1].ownerIndex == ownerIndex)
+            continue; // Trigram repeated within the name
+        if (numTrigramPostings >= MAX_TRIGRAM_POSTINGS)
+            return;
+        TrigramPosting *posting = &trigramPostings[numTrigramPostings++];
+        posting->ownerIndex = ownerIndex;
+        posting->next = 0;
+        if (last == 0)
+            trigramFirst[trigram] = numTrigramPostings;
+        else
+            trigramPostings[last - 1].next = numTrigramPostings;
+        trigramLast[trigram] = numTrigramPostings;
+        trigramCount[trigram]++;
+    }
+}
+
+// Case-insensitive substring test
+static int nameContains(const char *name, const char *text, int length)
+{
+    for (; *name != 0; name++)
+    {
+        int i = 0;
+        while (i < length && name[i] != 0 && tolower((unsigned char)name[i]) == tolower((unsigned char)text[i]))
+            i++;
+        if (i == length)
+            return 1;
+    }
+    return 0;
+}
+
+// Owners whose name contains text, paged like searchPlatePrefix
+int searchOwnerName(const char *text, int offset, int *out, int max, int *total)
+{
+    int length = (int)strlen(text);
+    int count = 0;
+    *total = 0;
+    if (length < 3)
+    {
+        // Too short for a trigram: scan the table
+        for (int o = 0; o < numOwners; o++)
+        {
+            if (!nameContains(owners[o].name, text, length))
+                continue;
+            if ((*total)++ >= offset && count < max)
+                out[count++] = o;
+        }
+        return count;
+    }
+
+    int rarest = trigramAt(text);
+    for (int i = 1; i + 3 <= length; i++)
+    {
+        int trigram = trigramAt(text + i);
+        if (trigramCount[trigram] < trigramCount[rarest])
+            rarest = trigram;
+    }
+    for (int p = trigramFirst[rarest]; p != 0; p = trigramPostings[p - 1].next)
+    {
+        int o = trigramPostings[p - 1].ownerIndex;
+        if (!nameContains(owners[o].name, text, length))
+            continue;
+        if ((*total)++ >= offset && count < max)
+            out[count++] = o;
+    }
+    return count;
+}
+
+// Position of the first parked spot entered at or after (with after = 1, past) the given time and spot
+static int entryOrderBound(time_t at, int spotIndex, int after)
+{
+    int low = 0, high = entryOrderCount;
+    while (low < high)
+    {
+        int mid = (low + high) / 2;
+        int s = entryOrder[mid];
+        int before = spots[s].entryTime < at || (spots[s].entryTime == at && s < spotIndex) ||
+                     (after && spots[s].entryTime == at && s == spotIndex);
+        if (before)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return low;
+}
+
+void rebuildEntryOrder()
+{
+    entryOrderCount = 0;
+    for (int i = 0; i < MAX_PARKING_SPOTS; i++)
+    {
+        if (spots[i].isOccupied)
+            entryOrderAdd(i);
+    }
+}
+
+// Called once the spot holds its new entry time
+void entryOrderAdd(int spotIndex)
+{
+    int pos = entryOrderBound(spots[spotIndex].entryTime, spotIndex, 0);
+    memmove(&entryOrder[pos + 1], &entryOrder[pos], (entryOrderCount - pos) * sizeof(int));
+    entryOrder[pos] = spotIndex;
+    entryOrderCount++;
+}
+
+// Called while the spot still holds the entry time it was added with
+void entryOrderRemove(int spotIndex)
+{
+    int pos = entryOrderBound(spots[spotIndex].entryTime, spotIndex, 0);
+    if (pos == entryOrderCount || entryOrder[pos] != spotIndex)
+        return;
+    memmove(&entryOrder[pos], &entryOrder[pos + 1], (entryOrderCount - pos - 1) * sizeof(int));
+    entryOrderCount--;
+}
+
+// Parked spots entered in [from, to), oldest first, paged like searchPlatePrefix
+int searchEntryRange(time_t from, time_t to, int offset, int *out, int max, int *total)
+{
+    int first = entryOrderBound(from, 0, 0);
+    int last = entryOrderBound(to, 0, 0);
+    *total = last > first ? last - first : 0;
+    int count = 0;
+    for (int pos = first + offset; pos < last && count < max; pos++)
+        out[count++] = entryOrder[pos];
+    return count;
+}
+
+// Prints one page at a time until the results run out or the operator stops.
+// search fills a page and returns its size; show prints one result.
+static void pageResults(const char *header, int (*search)(int offset, int *out, int max, int *total),
+                        void (*show)(int result))
+{
+    int results[SEARCH_PAGE_SIZE];
+    int offset = 0;
+    while (1)
+    {
+        long long t0 = monotonicNanos();
+        int total;
+        int count = search(offset, results, SEARCH_PAGE_SIZE, &total);
+        double elapsed = (monotonicNanos() - t0) / 1e6;
+        if (total == 0)
+        {
+            printf("No matches (%.2f ms).\n", elapsed);
+            return;
+        }
+        printf("%s\n", header);
+        printf("-------------------------------------------------------------------------------------\n");
+        for (int i = 0; i < count; i++)
+            show(results[i]);
+        printf("Showing %d-%d of %d (%.2f ms)\n", offset + 1, offset + count, total, elapsed);
+        if (offset + count >= total)
+            return;
+
+        char answer[20];
+        printf("Press Enter for the next page, or q to stop: ");
+        if (fgets(answer, sizeof(answer), stdin) == NULL || answer[0] == 'q' || answer[0] == 'Q')
+            return;
+        offset += count;
+    }
+}
+
+static char searchText[NAME_LEN];
+static time_t searchFrom, searchTo;
+
+static int searchPlatesPage(int offset, int *out, int max, int *total)
+{
+    return searchPlatePrefix(searchText, offset, out, max, total);
+}
+
+static int searchOwnersPage(int offset, int *out, int max, int *total)
+{
+    return searchOwnerName(searchText, offset, out, max, total);
+}
+
+static int searchEntriesPage(int offset, int *out, int max, int *total)
+{
+    return searchEntryRange(searchFrom, searchTo, offset, out, max, total);
+}
+
+static void showVehicleResult(int vehicleIndex)
+{
+    Vehicle *vehicle = &vehicles[vehicleIndex];
+    printf("%-15s %-15s %-20s %-10s %s\n", vehicle->vehicleId, vehicle->licensePlate, ownerNameOf(vehicleIndex),
+           vehicle->vehicleType, vehicle->isParked ? "Parked" : "-");
+}
+
+static void showOwnerResult(int ownerIndex)
+{
+    char vehicleIds[200];
+    formatVehicleIds(ownerIndex, vehicleIds, sizeof(vehicleIds));
+    printf("%-15s %-25s %-15s %s\n", owners[ownerIndex].ownerId, owners[ownerIndex].name,
+           owners[ownerIndex].phoneNumber, vehicleIds);
+}
+
+static void showEntryResult(int spotIndex)
+{
+    char entered[30];
+    strftime(entered, sizeof(entered), "%Y-%m-%d %H:%M", localtime(&spots[spotIndex].entryTime));
+    int vehicleIndex = findVehicleById(spots[spotIndex].vehicleId);
+    printf("%-5d %-17s %-15s %s\n", spotIndex + 1, entered, spots[spotIndex].vehicleId,
+           vehicleIndex != -1 ? vehicles[vehicleIndex].licensePlate : "-");
+}
+
+// Reads "HH:MM" (today) or "YYYY-MM-DD HH:MM" as local time; returns 0 on bad input
+static int readSearchTime(const char *prompt, time_t *out)
+{
+    char input[40];
+    printf("%s", prompt);
+    if (fgets(input, sizeof(input), stdin) == NULL)
+        return 0;
+    time_t now = clockNow();
+    struct tm when = *localtime(&now);
+    int year, month, day, hour, minute;
+    if (sscanf(input, "%d-%d-%d %d:%d", &year, &month, &day, &hour, &minute) == 5)
+    {
+        when.tm_year = year - 1900;
+        when.tm_mon = month - 1;
+        when.tm_mday = day;
+    }
+    else if (sscanf(input, "%d:%d", &hour, &minute) != 2)
+    {
+        return 0;
+    }
+    if (hour < 0 || hour > 24 || minute < 0 || minute > 59)
+        return 0;
+    when.tm_hour = hour;
+    when.tm_min = minute;
+    when.tm_sec = 0;
+    when.tm_isdst = -1;
+    *out = mktime(&when);
+    return *out != (time_t)-1;
+}
+
+void searchMenu()
+{
+    int choice;
+    while (1)
+    {
+        printf("\n========== SEARCH ==========\n");
+        printf("1. Plates Starting With\n");
+        printf("2. Owner Name Contains\n");
+        printf("3. Parked Vehicles By Entry Time\n");
+        printf("4. Back to Admin Menu\n");
+        printf("Enter choice: ");
+
+        if (scanf("%d", &choice) != 1)
+        {
+            printf("Invalid input.\n");
+            clearInputBuffer();
+            return;
+        }
+        clearInputBuffer();
+
+        switch (choice)
+        {
+        case 1:
+        case 2:
+            printf(choice == 1 ? "Enter Plate Prefix: " : "Enter Part Of The Name: ");
+            if (fgets(searchText, sizeof(searchText), stdin) == NULL)
+                break;
+            searchText[strcspn(searchText, "\n")] = 0;
+            if (choice == 1)
+            {
+                // Plates are registered in upper case
+                for (int i = 0; searchText[i] != 0; i++)
+                    searchText[i] = (char)toupper((unsigned char)searchText[i]);
+                pageResults("Vehicle ID      License         Owner                Type       Status",
+                            searchPlatesPage, showVehicleResult);
+            }
+            else if (searchText[0] == 0)
+            {
+                printf("ERROR: Enter at least one character.\n");
+            }
+            else
+            {
+                pageResults("Owner ID        Name                      Phone           Vehicle IDs",
+                            searchOwnersPage, showOwnerResult);
+            }
+            break;
+        case 3:
+            if (!readSearchTime("Entered From (HH:MM today, or YYYY-MM-DD HH:MM): ", &searchFrom) ||
+                !readSearchTime("Entered Before (HH:MM today, or YYYY-MM-DD HH:MM): ", &searchTo))
+            {
+                printf("ERROR: Invalid time.\n");
+                break;
+            }
+            pageResults("Spot  Entered           Vehicle ID      License", searchEntriesPage, showEntryResult);
+            break;
+        case 4:
+            return;
+        default:
+            printf("Invalid choice.\n");
+        }
+    }
+}
+
+// Multi-Site Federation
+// Every site is a shard: its own process (--site <folder> --serve) over its own
+// data folder, answering a small binary protocol on a Unix socket. The
+// aggregator (--aggregate) polls the shards, merges status and revenue, and
+// keeps a global plate -> site index of parked vehicles so "where is plate X"
+// costs one index probe plus one round trip to the owning site.
+//
+// Frames use native byte order (shards and aggregator run on the same host):
+//   request: op (1 byte), payload length (1 byte), payload
+//   reply:   status (1 byte), payload length (4 bytes), payload
+
+#ifndef _WIN32
+
+static unsigned char *putBytes(unsigned char *p, const void *value, size_t size)
+{
+    memcpy(p, value, size);
+    return p + size;
+}
+
+static const unsigned char *getBytes(const unsigned char *p, void *value, size_t size)
+{
+    memcpy(value, p, size);
+    return p + size;
+}
+
+static int readFull(int fd, void *buffer, size_t size)
+{
+    unsigned char *p = buffer;
+    while (size > 0)
+    {
+        ssize_t n = read(fd, p, size);
+        if (n <= 0)
+            return 0;
+        p += n;
+        size -= (size_t)n;
+    }
+    return 1;
+}
+
+static int writeFull(int fd, const void *buffer, size_t size)
+{
+    const unsigned char *p = buffer;
+    while (size > 0)
+    {
+        ssize_t n = write(fd, p, size);
+        if (n <= 0)
+            return 0;
+        p += n;
+        size -= (size_t)n;
+    }
+    return 1;
+}
+
+static int fillSocketAddress(struct sockaddr_un *addr, const char *socketPath)
+{
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    if (strlen(socketPath) >= sizeof(addr->sun_path))
+        return 0;
+    strcpy(addr->sun_path, socketPath);
+    return 1;
+}
+
+// Name a site reports: the last part of its data folder
+static const char *localSiteName()
+{
+    if (dataRoot[0] == 0)
+        return "local";
+    const char *name = strrchr(dataRoot, '/');
+    return name != NULL && name[1] != 0 ? name + 1 : dataRoot;
+}
+
+// Reloads the lot when another process (the site's console) saved since the last request
+static void shardRefresh()
+{
+    static time_t lastModified[2];
+    static off_t lastSize[2];
+    static const char *files[2] = {"vehicles/data.txt", "parking/data.txt"};
+    int changed = 0;
+    for (int i = 0; i < 2; i++)
+    {
+        char path[300];
+        struct stat info;
+        buildDataPath(path, sizeof(path), files[i]);
+        if (stat(path, &info) != 0)
+            continue;
+        if (info.st_mtime != lastModified[i] || info.st_size != lastSize[i])
+            changed = 1;
+        lastModified[i] = info.st_mtime;
+        lastSize[i] = info.st_size;
+    }
+    if (changed)
+    {
+        loadOwnerData();
+        loadVehicleData();
+        loadParkingData();
+    }
+}
+
+// Answers one request; returns 0 when the client has gone
+static int shardHandleRequest(int fd)
+{
+    static unsigned char reply[SHARD_REPLY_MAX];
+    unsigned char header[2];
+    char payload[256];
+    if (!readFull(fd, header, 2) || !readFull(fd, payload, header[1]))
+        return 0;
+    payload[header[1]] = 0;
+
+    unsigned char *p = reply + SHARD_REPLY_HEADER;
+    unsigned char status = SHARD_OK;
+    time_t now = clockTick();
+    switch (header[0])
+    {
+    case SHARD_OP_STATUS:
+    {
+        uint32_t totalSpots = MAX_PARKING_SPOTS, occupied = (uint32_t)occupiedCount, registered = (uint32_t)numVehicles;
+        double revenue = 0.0, entryRate = entryRatePerHour(now, occupiedCount);
+        for (int i = 0; i < MAX_PARKING_SPOTS; i++)
+        {
+            if (spots[i].isOccupied && !spots[i].isPassSession)
+                revenue += calculateParkingFeeAt(spots[i].entryTime, now, spots[i].ratePerHour);
+        }
+        const char *name = localSiteName();
+        size_t nameLength = strlen(name) < SITE_NAME_LEN - 1 ? strlen(name) : SITE_NAME_LEN - 1;
+        p = putBytes(p, &totalSpots, sizeof(totalSpots));
+        p = putBytes(p, &occupied, sizeof(occupied));
+        p = putBytes(p, &registered, sizeof(registered));
+        p = putBytes(p, &revenue, sizeof(revenue));
+        p = putBytes(p, &entryRate, sizeof(entryRate));
+        p = putBytes(p, name, nameLength);
+        break;
+    }
+    case SHARD_OP_PARKED:
+    {
+        // The payload is the spot index to resume from. The reply starts with the
+        // index to ask for next (4 bytes, 0 after the last page), then per car:
+        // spot (2 bytes), entry time (8 bytes), plate length (1 byte), plate
+        uint32_t next = 0;
+        int start = (int)strtol(payload, NULL, 10), count = 0;
+        unsigned char *cursor = p;
+        p += sizeof(next);
+        for (int i = start < 0 ? 0 : start; i < MAX_PARKING_SPOTS; i++)
+        {
+            if (!spots[i].isOccupied)
+                continue;
+            if (count == SHARD_PARKED_PAGE)
+            {
+                next = (uint32_t)i;
+                break;
+            }
+            count++;
+            int vehicleIndex = findVehicleById(spots[i].vehicleId);
+            if (vehicleIndex == -1)
+                continue;
+            uint16_t spot = (uint16_t)spots[i].spotNumber;
+            int64_t entryTime = spots[i].entryTime;
+            uint8_t plateLength = (uint8_t)strlen(vehicles[vehicleIndex].licensePlate);
+            p = putBytes(p, &spot, sizeof(spot));
+            p = putBytes(p, &entryTime, sizeof(entryTime));
+            p = putBytes(p, &plateLength, sizeof(plateLength));
+            p = putBytes(p, vehicles[vehicleIndex].licensePlate, plateLength);
+        }
+        putBytes(cursor, &next, sizeof(next));
+        break;
+    }
+    case SHARD_OP_FIND:
+    {
+        // spot (2 bytes), entry time (8 bytes), edits (1 byte), registered plate
+        int distance;
+        int vehicleIndex = matchPlate(payload, &distance);
+        if (vehicleIndex < 0 || !vehicles[vehicleIndex].isParked)
+        {
+            status = SHARD_NOT_FOUND;
+            break;
+        }
+        uint16_t spot = (uint16_t)vehicles[vehicleIndex].spotNumber;
+        int64_t entryTime = vehicles[vehicleIndex].entryTime;
+        uint8_t edits = (uint8_t)distance;
+        p = putBytes(p, &spot, sizeof(spot));
+        p = putBytes(p, &entryTime, sizeof(entryTime));
+        p = putBytes(p, &edits, sizeof(edits));
+        p = putBytes(p, vehicles[vehicleIndex].licensePlate, strlen(vehicles[vehicleIndex].licensePlate));
+        break;
+    }
+    default:
+        status = SHARD_BAD_REQUEST;
+    }
+
+    uint32_t length = (uint32_t)(p - reply - SHARD_REPLY_HEADER);
+    reply[0] = status;
+    memcpy(reply + 1, &length, sizeof(length));
+    return writeFull(fd, reply, SHARD_REPLY_HEADER + length);
+}
+
+// Serves this site until the process is stopped. Clients are handled one at a time.
+int runShardServer(const char *socketPath)
+{
+    char defaultPath[300];
+    if (socketPath == NULL)
+    {
+        buildDataPath(defaultPath, sizeof(defaultPath), SHARD_SOCKET_NAME);
+        socketPath = defaultPath;
+    }
+    struct sockaddr_un addr;
+    if (!fillSocketAddress(&addr, socketPath))
+    {
+        printf("ERROR: Socket path too long: %s\n", socketPath);
+        return -1;
+    }
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0)
+    {
+        printf("ERROR: Cannot create socket.\n");
+        return -1;
+    }
+    unlink(socketPath); // Left behind by a stopped server
+    if (bind(listener, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(listener, 16) != 0)
+    {
+        printf("ERROR: Cannot listen on %s\n", socketPath);
+        close(listener);
+        return -1;
+    }
+    signal(SIGPIPE, SIG_IGN); // An aggregator that disconnects mid-reply must not stop the site
+    printf("Site %s serving on %s\n", localSiteName(), socketPath);
+    fflush(stdout);
+
+    while (1)
+    {
+        int fd = accept(listener, NULL, NULL);
+        if (fd < 0)
+            continue;
+        shardRefresh();
+        while (shardHandleRequest(fd))
+            ;
+        close(fd);
+    }
+}
+
+// Aggregator side
+
+static int shardConnect(const char *socketPath)
+{
+    struct sockaddr_un addr;
+    if (!fillSocketAddress(&addr, socketPath))
+        return -1;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Sends one request and reads the reply payload. Returns the reply status, or -1 on a broken link.
+static int shardRequest(int fd, int op, const char *payload, unsigned char *reply, uint32_t *replyLength)
+{
+    unsigned char request[2 + 255];
+    size_t payloadLength = payload != NULL ? strlen(payload) : 0;
+    if (payloadLength > 255)
+        payloadLength = 255;
+    request[0] = (unsigned char)op;
+    request[1] = (unsigned char)payloadLength;
+    memcpy(request + 2, payload, payloadLength);
+    if (!writeFull(fd, request, 2 + payloadLength))
+        return -1;
+
+    unsigned char header[SHARD_REPLY_HEADER];
+    if (!readFull(fd, header, SHARD_REPLY_HEADER))
+        return -1;
+    memcpy(replyLength, header + 1, sizeof(*replyLength));
+    if (*replyLength > SHARD_REPLY_MAX - SHARD_REPLY_HEADER || !readFull(fd, reply, *replyLength))
+        return -1;
+    return header[0];
+}
+
+// Polls every site for its status and parked plates and rebuilds the global index
+static void aggregatorRefresh()
+{
+    static unsigned char reply[SHARD_REPLY_MAX];
+    long long t0 = monotonicNanos();
+    indexClear(sitePlateIndex, SITE_PLATE_INDEX_SIZE);
+    numSitePlates = 0;
+
+    for (int s = 0; s < numSites; s++)
+    {
+        SiteShard *site = &sites[s];
+        site->online = 0;
+        int fd = shardConnect(site->socketPath);
+        if (fd < 0)
+            continue;
+
+        uint32_t length;
+        if (shardRequest(fd, SHARD_OP_STATUS, NULL, reply, &length) == SHARD_OK && length >= 28)
+        {
+            const unsigned char *p = reply;
+            p = getBytes(p, &site->totalSpots, sizeof(site->totalSpots));
+            p = getBytes(p, &site->occupied, sizeof(site->occupied));
+            p = getBytes(p, &site->vehicles, sizeof(site->vehicles));
+            p = getBytes(p, &site->revenue, sizeof(site->revenue));
+            p = getBytes(p, &site->entryRate, sizeof(site->entryRate));
+            size_t nameLength = length - 28 < SITE_NAME_LEN - 1 ? length - 28 : SITE_NAME_LEN - 1;
+            memcpy(site->name, p, nameLength);
+            site->name[nameLength] = 0;
+            site->online = 1;
+        }
+
+        // Parked plates come a page at a time; a site whose pages cannot all be
+        // read or stored stays online but is marked partial
+        site->partial = 0;
+        uint32_t next = 0;
+        char cursorText[16];
+        do
+        {
+            if (!site->online)
+                break;
+            snprintf(cursorText, sizeof(cursorText), "%u", next);
+            if (shardRequest(fd, SHARD_OP_PARKED, cursorText, reply, &length) != SHARD_OK || length < sizeof(next))
+            {
+                site->partial = 1;
+                break;
+            }
+            uint32_t resumeAt = next;
+            const unsigned char *p = getBytes(reply, &next, sizeof(next)), *end = reply + length;
+            if (next != 0 && next <= resumeAt)
+            {
+                site->partial = 1; // The cursor must move forward
+                break;
+            }
+            while (end - p >= 11)
+            {
+                uint16_t spot;
+                int64_t entryTime;
+                uint8_t plateLength;
+                p = getBytes(p, &spot, sizeof(spot));
+                p = getBytes(p, &entryTime, sizeof(entryTime));
+                p = getBytes(p, &plateLength, sizeof(plateLength));
+                if (plateLength >= LICENSE_PLATE_LEN || end - p < plateLength || numSitePlates >= MAX_SITE_PLATES)
+                {
+                    site->partial = 1;
+                    break;
+                }
+
+                SitePlate *entry = &sitePlates[numSitePlates];
+                memcpy(entry->plate, p, plateLength);
+                entry->plate[plateLength] = 0;
+                p += plateLength;
+                entry->site = s;
+                entry->spotNumber = spot;
+                entry->entryTime = (time_t)entryTime;
+
+                char key[LICENSE_PLATE_LEN];
+                canonicalPlate(entry->plate, key);
+                if (indexInsert(sitePlateIndex, SITE_PLATE_INDEX_SIZE, key, numSitePlates))
+                    numSitePlates++;
+            }
+        } while (next != 0 && !site->partial);
+        close(fd);
+    }
+    printf("Polled %d site(s) in %.1f ms, %d parked plate(s) indexed.\n", numSites,
+           (monotonicNanos() - t0) / 1e6, numSitePlates);
+    for (int s = 0; s < numSites; s++)
+    {
+        if (sites[s].partial)
+            printf("WARNING: Site %s is only partly indexed; plate searches ask it directly.\n", sites[s].name);
+    }
+}
+
+static void aggregatorStatus()
+{
+    uint32_t totalSpots = 0, occupied = 0;
+    double revenue = 0.0;
+    int online = 0;
+    printf("\n========== ALL SITES ==========\n");
+    printf("%-20s %-8s %8s %8s %9s %14s\n", "Site", "State", "Spots", "Occupied", "Rate/hr", "Revenue (TK)");
+    printf("-----------------------------------------------------------------------\n");
+    for (int s = 0; s < numSites; s++)
+    {
+        SiteShard *site = &sites[s];
+        if (!site->online)
+        {
+            printf("%-20s %-8s\n", site->name, "OFFLINE");
+            continue;
+        }
+        printf("%-20s %-8s %8u %8u %9.2f %14.2f\n", site->name, site->partial ? "partial" : "online",
+               site->totalSpots, site->occupied, site->entryRate, site->revenue);
+        totalSpots += site->totalSpots;
+        occupied += site->occupied;
+        revenue += site->revenue;
+        online++;
+    }
+    printf("-----------------------------------------------------------------------\n");
+    printf("%-20s %-8d %8u %8u %9s %14.2f\n", "TOTAL", online, totalSpots, occupied, "", revenue);
+    if (totalSpots > 0)
+        printf("Occupancy across sites: %.1f%%\n", (double)occupied / totalSpots * 100);
+}
+
+// Global index first, then the owning site confirms the car is still there
+static void aggregatorFindPlate()
+{
+    static unsigned char reply[SHARD_REPLY_MAX];
+    char plate[LICENSE_PLATE_LEN], key[LICENSE_PLATE_LEN];
+    printf("Enter License Plate: ");
+    if (fgets(plate, sizeof(plate), stdin) == NULL)
+        return;
+    plate[strcspn(plate, "\n")] = 0;
+    canonicalPlate(plate, key);
+
+    int found = indexFind(sitePlateIndex, SITE_PLATE_INDEX_SIZE, key);
+    if (found < 0)
+    {
+        // The plate may be among those a partly indexed site could not hand over
+        for (int s = 0; s < numSites; s++)
+        {
+            if (!sites[s].online || !sites[s].partial)
+                continue;
+            int fd = shardConnect(sites[s].socketPath);
+            uint32_t length;
+            int status = fd < 0 ? -1 : shardRequest(fd, SHARD_OP_FIND, plate, reply, &length);
+            if (fd >= 0)
+                close(fd);
+            if (status == SHARD_OK && length >= 11)
+            {
+                uint16_t spot;
+                int64_t entryTime;
+                const unsigned char *p = getBytes(reply, &spot, sizeof(spot));
+                getBytes(p, &entryTime, sizeof(entryTime));
+                time_t entered = (time_t)entryTime;
+                printf("%.*s is parked at site %s, spot %u, since %s", (int)(length - 11), (const char *)reply + 11,
+                       sites[s].name, spot, ctime(&entered));
+                return;
+            }
+        }
+        printf("Plate %s is not parked at any site (as of the last refresh).\n", plate);
+        return;
+    }
+    SitePlate *entry = &sitePlates[found];
+    SiteShard *site = &sites[entry->site];
+
+    int fd = shardConnect(site->socketPath);
+    uint32_t length;
+    int status = fd < 0 ? -1 : shardRequest(fd, SHARD_OP_FIND, entry->plate, reply, &length);
+    if (fd >= 0)
+        close(fd);
+    if (status == SHARD_OK && length >= 11)
+    {
+        uint16_t spot;
+        int64_t entryTime;
+        const unsigned char *p = getBytes(reply, &spot, sizeof(spot));
+        getBytes(p, &entryTime, sizeof(entryTime));
+        time_t entered = (time_t)entryTime;
+        printf("%s is parked at site %s, spot %u, since %s", entry->plate, site->name, spot, ctime(&entered));
+    }
+    else if (status == SHARD_NOT_FOUND)
+    {
+        printf("%s has left site %s since the last refresh.\n", entry->plate, site->name);
+        indexRemove(sitePlateIndex, SITE_PLATE_INDEX_SIZE, key);
+    }
+    else
+    {
+        time_t entered = entry->entryTime;
+        printf("Site %s is unreachable; last seen at spot %d since %s", site->name, entry->spotNumber,
+               ctime(&entered));
+    }
+}
+
+// Each argument is a shard socket, or a site folder holding SHARD_SOCKET_NAME
+int runAggregator(int count, char **paths)
+{
+    if (count <= 0)
+    {
+        printf("Usage: --aggregate <site folder or socket>...\n");
+        return -1;
+    }
+    numSites = 0;
+    for (int i = 0; i < count && numSites < MAX_SITES; i++)
+    {
+        SiteShard *site = &sites[numSites];
+        memset(site, 0, sizeof(*site));
+        struct stat info;
+        if (stat(paths[i], &info) == 0 && S_ISDIR(info.st_mode))
+            snprintf(site->socketPath, sizeof(site->socketPath), "%s/%s", paths[i], SHARD_SOCKET_NAME);
+        else
+            snprintf(site->socketPath, sizeof(site->socketPath), "%s", paths[i]);
+        snprintf(site->name, sizeof(site->name), "%s", paths[i]);
+        numSites++;
+    }
+    if (count > MAX_SITES)
+        printf("WARNING: only the first %d sites are followed.\n", MAX_SITES);
+
+    aggregatorRefresh();
+    int choice;
+    while (1)
+    {
+        printf("\n========== SITE AGGREGATOR ==========\n");
+        printf("1. Status Across Sites\n");
+        printf("2. Find Parked Plate\n");
+        printf("3. Refresh From Sites\n");
+        printf("4. Exit\n");
+        printf("Enter choice: ");
+
+        if (scanf("%d", &choice) != 1)
+        {
+            printf("Invalid input.\n");
+            clearInputBuffer();
+            return 0;
+        }
+        clearInputBuffer();
+
+        switch (choice)
+        {
+        case 1:
+            aggregatorStatus();
+            break;
+        case 2:
+            aggregatorFindPlate();
+            break;
+        case 3:
+            aggregatorRefresh();
+            break;
+        case 4:
+            return 0;
+        default:
+            printf("Invalid choice.\n");
+        }
+    }
+}
+
+#else
+
+int runShardServer(const char *socketPath)
+{
+    (void)socketPath;
+    printf("ERROR: Site serving needs Unix sockets and is not available on this platform.\n");
+    return -1;
+}
+
+int runAggregator(int count, char **paths)
+{
+    (void)count;
+    (void)paths;
+    printf("ERROR: Site aggregation needs Unix sockets and is not available on this platform.\n");
+    return -1;
+}
+
+#endif
+
+// Monthly Pass / Subscription Management
+void managePasses()
+{
+    int choice;
+    while (1)
+    {
+        printf("\n========== MANAGE PASSES ==========\n");
+        printf("1. View All Passes\n");
+        printf("2. Issue/Renew Pass\n");
+        printf("3. Cancel Pass\n");
+        printf("4. Back to Admin Menu\n");
+        printf("Enter choice: ");
+
+        if (scanf("%d", &choice) != 1)
+        {
+            printf("Invalid input.\n");
+            clearInputBuffer();
+            return;
+        }
+        clearInputBuffer();
+
+        switch (choice)
+        {
+        case 1:
+            viewAllPasses();
+            break;
+        case 2:
+            issuePass();
+            break;
+        case 3:
+            cancelPass();
+            break;
+        case 4:
+            return;
+        default:
+            printf("Invalid choice.\n");
+        }
+    }
+}
+
+void viewAllPasses()
+{
+    sweepExpiredPasses(clockNow());
+
+    printf("\n========== ALL PASSES ==========\n");
+    printf("%-12s %-20s %-12s %-12s %-9s %-6s\n",
+           "Vehicle ID", "Holder", "Valid From", "Valid Until", "Entries", "Zones");
+    printf("------------------------------------------------------------------------\n");
+
+    int shown = 0;
+    for (int i = 0; i < numPasses; i++)
+    {
+        if (!passes[i].isActive)
+            continue;
+
+        char fromText[12], untilText[12], entriesText[24], zonesText[NUM_ZONES + 1];
+        strftime(fromText, sizeof(fromText), "%Y-%m-%d", localtime(&passes[i].validFrom));
+        strftime(untilText, sizeof(untilText), "%Y-%m-%d", localtime(&passes[i].validUntil));
+        if (passes[i].monthlyQuota > 0)
+            sprintf(entriesText, "%d/%d", passes[i].entriesThisMonth, passes[i].monthlyQuota);
+        else
+            sprintf(entriesText, "%d/-", passes[i].entriesThisMonth);
+        formatZoneMask(passes[i].zoneMask, zonesText);
+
+        printf("%-12s %-20s %-12s %-12s %-9s %-6s\n",
+               passes[i].vehicleId,
+               passes[i].holderName,
+               fromText,
+               untilText,
+               entriesText,
+               zonesText);
+        shown++;
+    }
+    if (shown == 0)
+    {
+        printf("No active passes.\n");
+    }
+}
+
+// Issue a new pass or extend the pass a vehicle already holds
+void issuePass()
+{
+    char vehicleId[VEHICLE_ID_LEN];
+    char temp_input[200];
+
+    printf("\n------- Issue/Renew Pass -------\n");
+    printf("Enter Vehicle ID: ");
+    if (fgets(vehicleId, sizeof(vehicleId), stdin) == NULL)
+    {
+        printf("Error reading vehicle ID.\n");
+        return;
+    }
+    vehicleId[strcspn(vehicleId, "\n")] = 0;
+
+    if (findVehicleById(vehicleId) == -1)
+    {
+        printf("ERROR: Vehicle not found.\n");
+        return;
+    }
+
+    time_t now = clockTick();
+    sweepExpiredPasses(now);
+    int passIdx = indexFind(passIndex, PASS_INDEX_SIZE, vehicleId);
+
+    int days;
+    printf("Enter validity in days (1-366): ");
+    if (scanf("%d", &days) != 1 || days < 1 || days > 366)
+    {
+        printf("Invalid number of days.\n");
+        clearInputBuffer();
+        return;
+    }
+    clearInputBuffer();
+
+    if (passIdx != -1)
+    {
+        renewPass(passIdx, days);
+        savePassData();
+        printf("Pass renewed for %s.\n", vehicleId);
+        return;
+    }
+
+    passIdx = allocatePassSlot();
+    if (passIdx == -1)
+    {
+        printf("ERROR: Maximum number of passes reached.\n");
+        return;
+    }
+
+    Pass *pass = &passes[passIdx];
+    memset(pass, 0, sizeof(Pass));
+    strcpy(pass->vehicleId, vehicleId);
+
+    printf("Enter Holder Name (person or company): ");
+    if (fgets(temp_input, sizeof(temp_input), stdin) == NULL)
+    {
+        temp_input[0] = 0;
+    }
+    temp_input[strcspn(temp_input, "\n")] = 0;
+    temp_input[HOLDER_NAME_LEN - 1] = 0;
+    strcpy(pass->holderName, strlen(temp_input) > 0 ? temp_input : "-");
+
+    printf("Enter monthly entry quota (0 for unlimited): ");
+    if (scanf("%d", &pass->monthlyQuota) != 1 || pass->monthlyQuota < 0)
+    {
+        pass->monthlyQuota = 0;
+    }
+    clearInputBuffer();
+
+    printf("Enter allowed zones (e.g. AB, or ALL): ");
+    if (fgets(temp_input, sizeof(temp_input), stdin) == NULL)
+    {
+        temp_input[0] = 0;
+    }
+    temp_input[strcspn(temp_input, "\n")] = 0;
+    pass->zoneMask = parseZoneMask(temp_input);
+    if (pass->zoneMask == 0)
+    {
+        printf("No valid zone given, pass covers all zones.\n");
+        pass->zoneMask = ALL_ZONES;
+    }
+
+    activatePass(passIdx, now, days);
+    savePassData();
+
+    printf("Pass issued for %s.\n", vehicleId);
+}
+
+// Renewal extends from the current expiry and moves the heap entry with it
+void renewPass(int passIdx, int days)
+{
+    passes[passIdx].validUntil += (time_t)days * 24 * 3600;
+    passHeapUpdate(passIdx);
+    timerArm(PASS_TIMER(passIdx), passes[passIdx].validUntil, ALERT_PASS_EXPIRED);
+}
+
+// Reuses the slot of a lapsed pass before growing the table; -1 when full
+int allocatePassSlot()
+{
+    for (int i = 0; i < numPasses; i++)
+    {
+        if (!passes[i].isActive)
+            return i;
+    }
+    return numPasses < MAX_PASSES ? numPasses++ : -1;
+}
+
+// Starts a filled-in pass now and registers it in the index, the heap and the timer wheel
+void activatePass(int passIdx, time_t now, int days)
+{
+    Pass *pass = &passes[passIdx];
+    pass->validFrom = now;
+    pass->validUntil = now + (time_t)days * 24 * 3600;
+    pass->isActive = 1;
+    indexInsert(passIndex, PASS_INDEX_SIZE, pass->vehicleId, passIdx);
+    passHeapPush(passIdx);
+    timerArm(PASS_TIMER(passIdx), pass->validUntil, ALERT_PASS_EXPIRED);
+}
+
+void cancelPass()
+{
+    char vehicleId[VEHICLE_ID_LEN];
+    printf("Enter Vehicle ID of the pass to cancel: ");
+    if (fgets(vehicleId, sizeof(vehicleId), stdin) == NULL)
+    {
+        printf("Error reading vehicle ID.\n");
+        return;
+    }
+    vehicleId[strcspn(vehicleId, "\n")] = 0;
+
+    int passIdx = indexFind(passIndex, PASS_INDEX_SIZE, vehicleId);
+    if (passIdx == -1)
+    {
+        printf("No active pass for this vehicle.\n");
+        return;
+    }
+    removePass(passIdx);
+    savePassData();
+    printf("Pass cancelled.\n");
+}
+
+// Calendar month (year * 12 + month) of a local time. The month's bounds are
+// cached, so the timezone conversion runs once a month rather than per entry.
+int quotaPeriodAt(time_t t)
+{
+    static time_t start = 0, end = 0;
+    static int period = 0;
+    if (t >= start && t < end)
+        return period;
+
+    struct tm localTime;
+#ifdef _WIN32
+    struct tm *local = localtime_s(&localTime, &t) == 0 ? &localTime : NULL;
+#else
+    struct tm *local = localtime_r(&t, &localTime);
+#endif
+    if (local == NULL)
+        return 0;
+    struct tm first = *local;
+    first.tm_mday = 1;
+    first.tm_hour = 0;
+    first.tm_min = 0;
+    first.tm_sec = 0;
+    first.tm_isdst = -1;
+    struct tm next = first;
+    next.tm_mon++;
+    start = mktime(&first);
+    end = mktime(&next);
+    period = (local->tm_year + 1900) * 12 + local->tm_mon;
+    return period;
+}
+
+// Constant-time gate check: one index probe, lapsed passes are swept lazily
+int checkPassEntitlement(char *vehicleId, time_t now, int *passIdx)
+{
+    *passIdx = -1;
+    if (passExpiryCount > 0 && passes[passExpiryHeap[0]].validUntil <= now)
+    {
+        sweepExpiredPasses(now);
+    }
+
+    int idx = indexFind(passIndex, PASS_INDEX_SIZE, vehicleId);
+    histogramRecord(&passLookupProbes, indexLastProbes);
+    if (idx == -1)
+    {
+        return PASS_NONE;
+    }
+    *passIdx = idx;
+
+    Pass *pass = &passes[idx];
+    if (now >= pass->validUntil)
+    {
+        // Not swept yet (the sweep only runs when the earliest expiry is due)
+        expirePass(idx);
+        *passIdx = -1;
+        return PASS_NONE;
+    }
+    if (now < pass->validFrom)
+    {
+        return PASS_NOT_YET_VALID;
+    }
+
+    // Entry counter restarts with every calendar month
+    int period = quotaPeriodAt(now);
+    if (pass->quotaPeriod != period)
+    {
+        pass->quotaPeriod = period;
+        pass->entriesThisMonth = 0;
+    }
+    if (pass->monthlyQuota > 0 && pass->entriesThisMonth >= pass->monthlyQuota)
+    {
+        return PASS_QUOTA_EXHAUSTED;
+    }
+    return PASS_OK;
+}
+
+void passHeapClear()
+{
+    for (int i = 0; i < passExpiryCount; i++)
+        passHeapPos[passExpiryHeap[i]] = 0;
+    passExpiryCount = 0;
+}
+
+static void passHeapSwap(int i, int j)
+{
+    int tmp = passExpiryHeap[i];
+    passExpiryHeap[i] = passExpiryHeap[j];
+    passExpiryHeap[j] = tmp;
+    passHeapPos[passExpiryHeap[i]] = i + 1;
+    passHeapPos[passExpiryHeap[j]] = j + 1;
+}
+
+// Moves the entry at position i up or down until its expiry is in heap order
+static void passHeapSift(int i)
+{
+    while (i > 0)
+    {
+        int parent = (i - 1) / 2;
+        if (passes[passExpiryHeap[parent]].validUntil <= passes[passExpiryHeap[i]].validUntil)
+            break;
+        passHeapSwap(parent, i);
+        i = parent;
+    }
+    while (1)
+    {
+        int smallest = i;
+        int left = 2 * i + 1;
+        int right = 2 * i + 2;
+        if (left < passExpiryCount &&
+            passes[passExpiryHeap[left]].validUntil < passes[passExpiryHeap[smallest]].validUntil)
+            smallest = left;
+        if (right < passExpiryCount &&
+            passes[passExpiryHeap[right]].validUntil < passes[passExpiryHeap[smallest]].validUntil)
+            smallest = right;
+        if (smallest == i)
+            break;
+        passHeapSwap(smallest, i);
+        i = smallest;
+    }
+}
+
+// A pass sits in the heap at most once; pushing it again only restores its position
+void passHeapPush(int passIdx)
+{
+    if (passHeapPos[passIdx] != 0)
+    {
+        passHeapUpdate(passIdx);
+        return;
+    }
+    int i = passExpiryCount++;
+    passExpiryHeap[i] = passIdx;
+    passHeapPos[passIdx] = i + 1;
+    passHeapSift(i);
+}
+
+// Called after the validUntil of a pass in the heap changed
+void passHeapUpdate(int passIdx)
+{
+    if (passHeapPos[passIdx] != 0)
+        passHeapSift(passHeapPos[passIdx] - 1);
+}
+
+void passHeapRemove(int passIdx)
+{
+    int i = passHeapPos[passIdx] - 1;
+    if (i < 0)
+        return;
+    passHeapPos[passIdx] = 0;
+    int last = --passExpiryCount;
+    if (i == last)
+        return;
+    passExpiryHeap[i] = passExpiryHeap[last];
+    passHeapPos[passExpiryHeap[i]] = i + 1;
+    passHeapSift(i);
+}
+
+// Drop every pass whose validity ended
+void sweepExpiredPasses(time_t now)
+{
+    while (passExpiryCount > 0 && passes[passExpiryHeap[0]].validUntil <= now)
+        expirePass(passExpiryHeap[0]);
+}
+
+// A lapsed pass leaves the index and the heap; its expiry alert still fires
+void expirePass(int passIdx)
+{
+    passes[passIdx].isActive = 0;
+    indexRemove(passIndex, PASS_INDEX_SIZE, passes[passIdx].vehicleId);
+    passHeapRemove(passIdx);
+}
+
+void removePass(int passIdx)
+{
+    expirePass(passIdx);
+    timerDisarm(PASS_TIMER(passIdx));
+}
+
+void formatZoneMask(unsigned int zoneMask, char *out)
+{
+    int n = 0;
+    for (int z = 0; z < NUM_ZONES; z++)
+    {
+        if (zoneMask & (1u << z))
+            out[n++] = 'A' + z;
+    }
+    out[n] = 0;
+}
+
+unsigned int parseZoneMask(char *text)
+{
+    if (strcmp(text, "ALL") == 0 || strcmp(text, "all") == 0)
+    {
+        return ALL_ZONES;
+    }
+    unsigned int mask = 0;
+    for (int i = 0; text[i] != 0; i++)
+    {
+        int z = toupper((unsigned char)text[i]) - 'A';
+        if (z >= 0 && z < NUM_ZONES)
+            mask |= 1u << z;
+    }
+    return mask;
+}
+
+// Pass Data Write
+void savePassData()
+{
+    long long t0 = monotonicNanos();
+    DataWriter writer;
+    if (!dataWriterOpen(&writer, "passes/data.txt", 0))
+    {
+        printf("ERROR: Cannot create/open pass data file!\n");
+        return;
+    }
+    int active = 0;
+    for (int i = 0; i < numPasses; i++)
+    {
+        if (passes[i].isActive)
+            active++;
+    }
+
+    dataWriterPrintf(&writer, "%d\n", active);
+    for (int i = 0; i < numPasses; i++)
+    {
+        if (!passes[i].isActive)
+            continue;
+        dataWriterPrintf(&writer, "%s|%s|%ld|%ld|%d|%d|%d|%u\n",
+                passes[i].vehicleId,
+                passes[i].holderName,
+                passes[i].validFrom,
+                passes[i].validUntil,
+                passes[i].monthlyQuota,
+                passes[i].entriesThisMonth,
+                passes[i].quotaPeriod,
+                passes[i].zoneMask);
+    }
+
+    long written = dataWriterClose(&writer);
+    recordSave(SAVE_PASSES, written, t0);
+}
+
+// Pass Data Read
+void loadPassData()
+{
+    numPasses = 0;
+    passHeapClear();
+    indexClear(passIndex, PASS_INDEX_SIZE);
+
+    DataReader reader;
+    if (!dataReaderOpen(&reader, "passes/data.txt"))
+    {
+        return;
+    }
+
+    // vehicle id|holder|valid from|valid until|quota|entries|quota period|zone mask
+    FieldSpan field[8];
+    long count = dataReaderLastBlock(&reader);
+    for (long n = 0; n < count && numPasses < MAX_PASSES; n++)
+    {
+        int fields = dataReaderNext(&reader, field, 8);
+        Pass *pass = &passes[numPasses];
+        memset(pass, 0, sizeof(Pass));
+
+        long validFrom, validUntil;
+        if (fields < 7 || field[0].length == 0 ||
+            !spanToText(field[0], pass->vehicleId, sizeof(pass->vehicleId)) ||
+            !spanToText(field[1], pass->holderName, sizeof(pass->holderName)) ||
+            !spanToLong(field[2], &validFrom) || !spanToLong(field[3], &validUntil))
+        {
+            dataReaderWarn(&reader, "missing or malformed field");
+            continue;
+        }
+        if (indexFind(passIndex, PASS_INDEX_SIZE, pass->vehicleId) != -1)
+        {
+            dataReaderWarn(&reader, "duplicate pass");
+            continue;
+        }
+        pass->validFrom = (time_t)validFrom;
+        pass->validUntil = (time_t)validUntil;
+        spanToInt(field[4], &pass->monthlyQuota);
+        spanToInt(field[5], &pass->entriesThisMonth);
+        spanToInt(field[6], &pass->quotaPeriod);
+
+        long zoneMask;
+        pass->zoneMask = fields > 7 && spanToLong(field[7], &zoneMask) ? (unsigned int)zoneMask : ALL_ZONES;
+
+        pass->isActive = 1;
+        indexInsert(passIndex, PASS_INDEX_SIZE, pass->vehicleId, numPasses);
+        passHeapPush(numPasses);
+        if (pass->validUntil > clockNow())
+            timerArm(PASS_TIMER(numPasses), pass->validUntil, ALERT_PASS_EXPIRED);
+        numPasses++;
+    }
+
+    dataReaderClose(&reader);
+}
+
+// Gate Event Simulator (capacity planning)
+// Arrivals follow a Poisson process, dwell times are log-normal per vehicle type.
+typedef struct
+{
+    const char *type;
+    double share;          // Fraction of arrivals
+    double meanDwellHours; // Mean stay in the lot
+} SimVehicleProfile;
+
+static const SimVehicleProfile simProfiles[] = {
+    {"Car", 0.60, 2.0},
+    {"Bike", 0.20, 1.0},
+    {"Jeep", 0.12, 3.0},
+    {"Truck", 0.08, 5.0},
+};
+#define SIM_NUM_PROFILES (int)(sizeof(simProfiles) / sizeof(simProfiles[0]))
+#define SIM_START_TIME 1754006400 // 1st August 2025, fixed so runs are reproducible
+
+typedef struct
+{
+    double time;
+    int vehicleIndex;
+} SimDeparture;
+
+static void simHeapPush(SimDeparture *heap, int *count, SimDeparture item)
+{
+    int i = (*count)++;
+    heap[i] = item;
+    while (i > 0 && heap[(i - 1) / 2].time > heap[i].time)
+    {
+        SimDeparture tmp = heap[(i - 1) / 2];
+        heap[(i - 1) / 2] = heap[i];
+        heap[i] = tmp;
+        i = (i - 1) / 2;
+    }
+}
+
+static SimDeparture simHeapPop(SimDeparture *heap, int *count)
+{
+    SimDeparture top = heap[0];
+    heap[0] = heap[--(*count)];
+    int i = 0;
+    while (1)
+    {
+        int smallest = i;
+        int left = 2 * i + 1;
+        int right = 2 * i + 2;
+        if (left < *count && heap[left].time < heap[smallest].time)
+            smallest = left;
+        if (right < *count && heap[right].time < heap[smallest].time)
+            smallest = right;
+        if (smallest == i)
+            break;
+        SimDeparture tmp = heap[smallest];
+        heap[smallest] = heap[i];
+        heap[i] = tmp;
+        i = smallest;
+    }
+    return top;
+}
+
+static void printLatencyLine(const char *label, LatencyHistogram *hist)
+{
+    printf("%-8s p50 %6llu ns  p90 %6llu ns  p99 %6llu ns  p99.9 %7llu ns  max %8llu ns\n",
+           label,
+           histogramPercentile(hist, 50.0),
+           histogramPercentile(hist, 90.0),
+           histogramPercentile(hist, 99.0),
+           histogramPercentile(hist, 99.9),
+           hist->max);
+}
+
+// Drives gateParkVehicle/gateUnparkVehicle with a seeded event stream
+void runSimulation(long events, unsigned long long seed, double arrivalsPerHour)
+{
+    static SimDeparture departures[MAX_VEHICLES];
+    static int idleVehicles[MAX_VEHICLES];
+    static LatencyHistogram parkLatency, unparkLatency;
+    int numDepartures = 0;
+    int numIdle = 0;
+    unsigned long long rng = seed;
+
+    if (events <= 0 || arrivalsPerHour <= 0)
+    {
+        printf("Usage: --simulate [events] [seed] [arrivalsPerHour]\n");
+        return;
+    }
+
+    // Fresh lot with a synthetic fleet, vehicle types drawn by share
+    for (int i = 0; i < MAX_PARKING_SPOTS; i++)
+    {
+        memset(&spots[i], 0, sizeof(ParkingSpot));
+        spots[i].spotNumber = i + 1;
+    }
+    occupiedCount = 0;
+    rebuildFreeSpots();
+    recountZones();
+    rebuildEntryOrder();
+    feedResyncAll();
+    timerWheelReset(SIM_START_TIME);
+    AlertSinkFn savedSink = alertSink;
+    alertSink = alertSinkNone;
+    unsigned long long alertsBefore[NUM_ALERT_KINDS];
+    memcpy(alertsBefore, alertCount, sizeof(alertsBefore));
+    numPasses = 0;
+    passHeapClear();
+    indexClear(passIndex, PASS_INDEX_SIZE);
+    numVehicles = MAX_VEHICLES;
+    for (int i = 0; i < numVehicles; i++)
+    {
+        memset(&vehicles[i], 0, sizeof(Vehicle));
+        sprintf(vehicles[i].vehicleId, "SIM%05d", i + 1);
+        sprintf(vehicles[i].licensePlate, "SIM-%04d", (i + 1) % 10000);
+        double pick = randomUniform(&rng);
+        int p = 0;
+        while (p < SIM_NUM_PROFILES - 1 && pick >= simProfiles[p].share)
+        {
+            pick -= simProfiles[p].share;
+            p++;
+        }
+        strcpy(vehicles[i].vehicleType, simProfiles[p].type);
+        idleVehicles[numIdle++] = i;
+    }
+    memset(&parkLatency, 0, sizeof(parkLatency));
+    memset(&unparkLatency, 0, sizeof(unparkLatency));
+
+    long arrivals = 0, rejected = 0, noVehicle = 0, parked = 0, unparked = 0;
+    int occupied = 0, peakOccupied = 0;
+    double occupancyArea = 0.0; // Occupied spot-hours, for the time-weighted average
+    double revenue = 0.0;
+    double simHours = 0.0;
+    double nextArrival = randomExponential(&rng, 1.0 / arrivalsPerHour);
+    long long wallStart = monotonicNanos();
+
+    for (long e = 0; e < events; e++)
+    {
+        int isDeparture = numDepartures > 0 && departures[0].time <= nextArrival;
+        double eventTime = isDeparture ? departures[0].time : nextArrival;
+        occupancyArea += occupied * (eventTime - simHours);
+        simHours = eventTime;
+        time_t now = SIM_START_TIME + (time_t)(simHours * 3600.0);
+        clockSet(now);
+        timerWheelAdvance(now);
+
+        if (isDeparture)
+        {
+            SimDeparture d = simHeapPop(departures, &numDepartures);
+            long long t0 = monotonicNanos();
+            GateResult result = gateUnparkVehicle(d.vehicleIndex, now);
+            histogramRecord(&unparkLatency, monotonicNanos() - t0);
+            if (result.status == GATE_OK)
+            {
+                revenue += result.fee;
+                unparked++;
+                occupied--;
+            }
+            idleVehicles[numIdle++] = d.vehicleIndex;
+            continue;
+        }
+
+        arrivals++;
+        nextArrival = simHours + randomExponential(&rng, 1.0 / arrivalsPerHour);
+        if (numIdle == 0)
+        {
+            noVehicle++; // Whole fleet is already parked; the lot was not asked
+            continue;
+        }
+        int slot = (int)(randomUniform(&rng) * numIdle);
+        int vehicleIndex = idleVehicles[slot];
+
+        long long t0 = monotonicNanos();
+        GateResult result = gateParkVehicle(vehicleIndex, now);
+        histogramRecord(&parkLatency, monotonicNanos() - t0);
+        if (result.status != GATE_OK)
+        {
+            if (result.status == GATE_LOT_FULL)
+                rejected++;
+            continue;
+        }
+        idleVehicles[slot] = idleVehicles[--numIdle];
+        parked++;
+        occupied++;
+        if (occupied > peakOccupied)
+            peakOccupied = occupied;
+
+        double meanDwell = simProfiles[0].meanDwellHours;
+        for (int p = 0; p < SIM_NUM_PROFILES; p++)
+        {
+            if (strcmp(vehicles[vehicleIndex].vehicleType, simProfiles[p].type) == 0)
+                meanDwell = simProfiles[p].meanDwellHours;
+        }
+        SimDeparture d = {simHours + randomLogNormal(&rng, meanDwell, 0.8), vehicleIndex};
+        simHeapPush(departures, &numDepartures, d);
+    }
+
+    double wallSeconds = (monotonicNanos() - wallStart) / 1e9;
+    alertSink = savedSink;
+
+    printf("\n========== GATE SIMULATION ==========\n");
+    printf("Seed: %llu   Events: %ld   Arrival rate: %.1f/hr\n", seed, events, arrivalsPerHour);
+    printf("Lot: %d spots, fleet of %d vehicles\n", MAX_PARKING_SPOTS, numVehicles);
+    printf("Simulated time: %.1f hours (%.1f days)\n", simHours, simHours / 24.0);
+    printf("Wall time: %.3f s   Throughput: %.0f events/s\n",
+           wallSeconds, wallSeconds > 0 ? events / wallSeconds : 0.0);
+    printf("\n--- Gate Latency ---\n");
+    printLatencyLine("Park", &parkLatency);
+    printLatencyLine("Unpark", &unparkLatency);
+    printf("\n--- Occupancy ---\n");
+    printf("Arrivals: %ld   Parked: %ld   Departed: %ld\n", arrivals, parked, unparked);
+    printf("Rejected (lot full): %ld (%.2f%%)\n", rejected,
+           arrivals > 0 ? 100.0 * rejected / arrivals : 0.0);
+    printf("No idle vehicle: %ld (%.2f%%)\n", noVehicle,
+           arrivals > 0 ? 100.0 * noVehicle / arrivals : 0.0);
+    printf("Average occupancy: %.1f%%   Peak: %d/%d\n",
+           simHours > 0 ? 100.0 * occupancyArea / simHours / MAX_PARKING_SPOTS : 0.0,
+           peakOccupied, MAX_PARKING_SPOTS);
+    printf("Revenue collected: TK- %.2f/=\n", revenue);
+    printf("Alerts: %llu long dwell, %llu overstay, %llu grace expired\n",
+           alertCount[ALERT_LONG_DWELL] - alertsBefore[ALERT_LONG_DWELL],
+           alertCount[ALERT_OVERSTAY] - alertsBefore[ALERT_OVERSTAY],
+           alertCount[ALERT_GRACE_EXPIRED] - alertsBefore[ALERT_GRACE_EXPIRED]);
+}
+
+// Journal Replay
+// Re-runs journal/events.log through the gate engine on a fresh in-memory lot.
+// Each event runs at its recorded time (the engine takes the clock as an
+// argument), so spot choices, entry rates and fees come out exactly as they
+// would have. Anything that does not match the recording is a divergence;
+// the first one is where the recorded run departed from the engine's rules.
+// Pass sessions (recorded at rate 0) are placed in their recorded spot, since
+// the journal does not carry the pass table they were decided from.
+// Rates depend on the local hour, so replay in the lot's time zone.
+
+static void replayDiverged(ReplayStats *stats, long line, const char *format, ...)
+{
+    stats->divergences++;
+    if (stats->divergences > REPLAY_MAX_REPORTED)
+        return;
+    va_list args;
+    va_start(args, format);
+    printf("  line %ld: ", line);
+    vprintf(format, args);
+    printf("\n");
+    va_end(args);
+}
+
+// True when value prints as recorded did: the journal keeps amounts to the cent
+static int sameCents(double value, double recorded)
+{
+    // Only amounts near a half cent apart need the formatted comparison
+    double gap = fabs(value - recorded);
+    if (gap < 0.004 || gap > 0.006)
+        return gap < 0.004;
+    char valueText[32], recordedText[32];
+    snprintf(valueText, sizeof(valueText), "%.2f", value);
+    snprintf(recordedText, sizeof(recordedText), "%.2f", recorded);
+    return strcmp(valueText, recordedText) == 0;
+}
+
+// Vehicle index for a journal vehicle, registering it on first sight
+static int replayVehicle(FieldSpan idField, FieldSpan plateField)
+{
+    char vehicleId[VEHICLE_ID_LEN];
+    if (!spanToText(idField, vehicleId, sizeof(vehicleId)))
+        return -1;
+    int vehicleIndex = indexFind(vehicleIdIndex, VEHICLE_INDEX_SIZE, vehicleId);
+    if (vehicleIndex != -1 || numVehicles >= MAX_VEHICLES)
+        return vehicleIndex;
+
+    vehicleIndex = numVehicles++;
+    memset(&vehicles[vehicleIndex], 0, sizeof(Vehicle));
+    strcpy(vehicles[vehicleIndex].vehicleId, vehicleId);
+    spanToText(plateField, vehicles[vehicleIndex].licensePlate, LICENSE_PLATE_LEN);
+    vehicleFirstLink[vehicleIndex] = -1;
+    indexInsert(vehicleIdIndex, VEHICLE_INDEX_SIZE, vehicles[vehicleIndex].vehicleId, vehicleIndex);
+    return vehicleIndex;
+}
+
+static void replayPark(ReplayStats *stats, long line, int vehicleIndex, time_t at, int spotNumber, double rate)
+{
+    const char *vehicleId = vehicles[vehicleIndex].vehicleId;
+    stats->parks++;
+    if (rate == 0.0)
+    {
+        // Pass session: the recorded spot, if the replayed lot has it free
+        if (vehicles[vehicleIndex].isParked)
+            replayDiverged(stats, line, "PARK %s: already parked in spot %d", vehicleId,
+                           vehicles[vehicleIndex].spotNumber);
+        else if (spots[spotNumber - 1].isOccupied)
+            replayDiverged(stats, line, "PARK %s: pass spot %d is held by %s", vehicleId, spotNumber,
+                           spots[spotNumber - 1].vehicleId);
+        else
+        {
+            GateResult result = {GATE_OK, 0, -1, PASS_NONE, 1, 0.0, 0.0, -1};
+            gateOccupySpot(vehicleIndex, spotNumber, at, &result);
+        }
+        return;
+    }
+
+    GateResult result = gateParkVehicle(vehicleIndex, at);
+    if (result.status == GATE_ALREADY_PARKED)
+        replayDiverged(stats, line, "PARK %s: already parked in spot %d", vehicleId, result.spotNumber);
+    else if (result.status == GATE_LOT_FULL)
+        replayDiverged(stats, line, "PARK %s: lot full in replay, recorded spot %d", vehicleId, spotNumber);
+    else if (result.spotNumber != spotNumber)
+        replayDiverged(stats, line, "PARK %s: recorded spot %d, replayed spot %d", vehicleId, spotNumber,
+                       result.spotNumber);
+    else if (!sameCents(result.ratePerHour, rate))
+        replayDiverged(stats, line, "PARK %s: recorded rate %.2f, replayed rate %.2f", vehicleId, rate,
+                       result.ratePerHour);
+}
+
+static void replayUnpark(ReplayStats *stats, long line, int vehicleIndex, time_t at, int spotNumber, double fee,
+                         int removed)
+{
+    const char *vehicleId = vehicles[vehicleIndex].vehicleId;
+    const char *event = removed ? "REMOVE" : "UNPARK";
+    if (removed)
+        stats->removes++;
+    else
+        stats->unparks++;
+    if (vehicles[vehicleIndex].isParked && vehicles[vehicleIndex].spotNumber != spotNumber)
+        replayDiverged(stats, line, "%s %s: recorded spot %d, replayed spot %d", event, vehicleId, spotNumber,
+                       vehicles[vehicleIndex].spotNumber);
+
+    GateResult result = gateUnparkVehicle(vehicleIndex, at);
+    if (result.status == GATE_NOT_PARKED)
+        replayDiverged(stats, line, "%s %s: not parked in replay", event, vehicleId);
+    else if (!removed && !sameCents(result.fee, fee))
+        replayDiverged(stats, line, "UNPARK %s: recorded fee %.2f, replayed fee %.2f", vehicleId, fee, result.fee);
+    else if (!removed)
+        stats->revenue += result.fee;
+}
+
+// Replays a journal (default journal/events.log) and compares the end state
+// with parking/data.txt. Returns the number of divergences, or -1.
+long runReplay(const char *journal)
+{
+    const char *relative = journal != NULL ? journal : "journal/events.log";
+
+    // The recorded end state, before the lot is cleared for the replay
+    loadParkingData();
+    ParkingSpot *recorded = arenaAlloc(threadArena(), sizeof(ParkingSpot) * MAX_PARKING_SPOTS);
+    if (recorded == NULL)
+        return -1;
+    memcpy(recorded, spots, sizeof(ParkingSpot) * MAX_PARKING_SPOTS);
+
+    DataReader reader;
+    if (!dataReaderOpen(&reader, relative))
+    {
+        printf("Cannot read journal %s\n", relative);
+        return -1;
+    }
+
+    // Fresh lot and registry; nothing here is saved
+    for (int i = 0; i < MAX_PARKING_SPOTS; i++)
+    {
+        memset(&spots[i], 0, sizeof(ParkingSpot));
+        spots[i].spotNumber = i + 1;
+    }
+    occupiedCount = 0;
+    rebuildFreeSpots();
+    recountZones();
+    rebuildEntryOrder();
+    feedResyncAll();
+    alertSink = alertSinkNone;
+    numPasses = 0;
+    passHeapClear();
+    indexClear(passIndex, PASS_INDEX_SIZE);
+    numVehicles = 0;
+    indexClear(vehicleIdIndex, VEHICLE_INDEX_SIZE);
+
+    printf("\n========== JOURNAL REPLAY ==========\n");
+    printf("Journal: %s\n", relative);
+    printf("Divergences:\n");
+
+    ReplayStats stats;
+    memset(&stats, 0, sizeof(stats));
+    FieldSpan field[6];
+    int fields;
+    int started = 0;
+    long long wallStart = monotonicNanos();
+    while ((fields = dataReaderNext(&reader, field, 6)) >= 0)
+    {
+        long at;
+        int spotNumber;
+        double amount;
+        if (fields < 6 || !spanToLong(field[0], &at) || !spanToInt(field[2], &spotNumber) || spotNumber < 1 ||
+            spotNumber > MAX_PARKING_SPOTS || !spanToDouble(field[5], &amount))
+        {
+            dataReaderWarn(&reader, "malformed journal line");
+            continue;
+        }
+        int vehicleIndex = replayVehicle(field[3], field[4]);
+        if (vehicleIndex == -1)
+        {
+            dataReaderWarn(&reader, "bad vehicle or vehicle table full");
+            continue;
+        }
+        if (!started)
+        {
+            // Alerts are not part of the replay; the wheel only needs a sane origin
+            timerWheelReset((time_t)at);
+            started = 1;
+        }
+        clockSet((time_t)at);
+
+        if (field[1].length == 4 && memcmp(field[1].start, "PARK", 4) == 0)
+            replayPark(&stats, reader.line, vehicleIndex, (time_t)at, spotNumber, amount);
+        else if (field[1].length == 6 && memcmp(field[1].start, "UNPARK", 6) == 0)
+            replayUnpark(&stats, reader.line, vehicleIndex, (time_t)at, spotNumber, amount, 0);
+        else if (field[1].length == 6 && memcmp(field[1].start, "REMOVE", 6) == 0)
+            replayUnpark(&stats, reader.line, vehicleIndex, (time_t)at, spotNumber, 0.0, 1);
+        else
+            dataReaderWarn(&reader, "unknown journal event");
+    }
+    double wallSeconds = (monotonicNanos() - wallStart) / 1e9;
+    dataReaderClose(&reader);
+    if (stats.divergences > REPLAY_MAX_REPORTED)
+        printf("  ... %ld more not shown\n", stats.divergences - REPLAY_MAX_REPORTED);
+    else if (stats.divergences == 0)
+        printf("  none\n");
+
+    // Events after the last save are still queued in memory, so a spot or two may lag
+    long differing = 0;
+    printf("End state against parking/data.txt:\n");
+    for (int i = 0; i < MAX_PARKING_SPOTS; i++)
+    {
+        ParkingSpot *want = &recorded[i];
+        ParkingSpot *got = &spots[i];
+        if (want->isOccupied == got->isOccupied &&
+            (!want->isOccupied || (strcmp(want->vehicleId, got->vehicleId) == 0 &&
+                                   want->entryTime == got->entryTime &&
+                                   sameCents(got->ratePerHour, want->ratePerHour))))
+            continue;
+        if (++differing > REPLAY_MAX_REPORTED)
+            continue;
+        printf("  spot %d: recorded ", i + 1);
+        if (want->isOccupied)
+            printf("%s since %ld at %.2f", want->vehicleId, (long)want->entryTime, want->ratePerHour);
+        else
+            printf("free");
+        printf(", replayed ");
+        if (got->isOccupied)
+            printf("%s since %ld at %.2f\n", got->vehicleId, (long)got->entryTime, got->ratePerHour);
+        else
+            printf("free\n");
+    }
+    if (differing > REPLAY_MAX_REPORTED)
+        printf("  ... %ld more not shown\n", differing - REPLAY_MAX_REPORTED);
+    else if (differing == 0)
+        printf("  identical (%d spot(s) occupied)\n", occupiedCount);
+
+    long events = stats.parks + stats.unparks + stats.removes;
+    printf("Events: %ld (%ld park, %ld unpark, %ld remove), %d vehicle(s)\n", events, stats.parks, stats.unparks,
+           stats.removes, numVehicles);
+    printf("Revenue replayed: TK- %.2f/=\n", stats.revenue);
+    printf("Replay time: %.3f s (%.0f events/s)\n", wallSeconds, wallSeconds > 0 ? events / wallSeconds : 0.0);
+    return stats.divergences + differing;
+}
+
+// Self-Check
+// Seeded property and fuzz tests for the gate engine and the loaders. The
+// property phase drives random parks, unparks, removals, registrations and
+// waitlist moves on an in-memory lot and checks every invariant after each
+// step. The fuzz phase saves that lot, then loads mutated copies of the data
+// files and checks the same invariants after each load. The first broken
+// invariant stops the run and names the step, the seed and the files.
+#define SELFCHECK_MAX_REPORTED 10
+#define SELFCHECK_FUZZ_ROUNDS 2000
+#define SELFCHECK_FILES 4
+#define SELFCHECK_MAX_GROWTH 4096 // Bytes the mutations may add to a file
+
+static const char *selfCheckFiles[SELFCHECK_FILES] = {"owners/data.txt", "vehicles/data.txt", "parking/data.txt",
+                                                      "passes/data.txt"};
+static int invariantCount;
+static int selfCheckSerial;
+
+static void invariantFailed(const char *format, ...)
+{
+    if (invariantCount++ >= SELFCHECK_MAX_REPORTED)
+        return;
+    va_list args;
+    va_start(args, format);
+    printf("INVARIANT: ");
+    vprintf(format, args);
+    printf("\n");
+    va_end(args);
+}
+
+static const char *vehicleIdOf(int row)
+{
+    return vehicles[row].vehicleId;
+}
+
+static const char *ownerIdOf(int row)
+{
+    return owners[row].ownerId;
+}
+
+static const char *ownerPhoneOf(int row)
+{
+    return owners[row].phoneNumber;
+}
+
+static const char *passVehicleOf(int row)
+{
+    return passes[row].isActive ? passes[row].vehicleId : NULL;
+}
+
+// Compares an index with a scan of its table. A unique index must find every
+// row under its own key; the phone index only has to find a row with that key.
+static void checkIndex(const char *name, IndexSlot *slots, int capacity, int rows, const char *(*keyOf)(int),
+                       int unique)
+{
+    int live = 0, keyed = 0;
+    for (int s = 0; s < capacity; s++)
+    {
+        int row = slots[s].value;
+        if (row == INDEX_EMPTY || row == INDEX_DELETED)
+            continue;
+        live++;
+        const char *key = row >= 0 && row < rows ? keyOf(row) : NULL;
+        if (key == NULL || strcmp(key, slots[s].key) != 0)
+            invariantFailed("%s index: '%s' points at row %d, which has another key", name, slots[s].key, row);
+    }
+    for (int row = 0; row < rows; row++)
+    {
+        const char *key = keyOf(row);
+        if (key == NULL || key[0] == 0)
+            continue;
+        keyed++;
+        int found = indexFind(slots, capacity, key);
+        int ok = unique ? found == row
+                        : found >= 0 && found < rows && keyOf(found) != NULL && strcmp(keyOf(found), key) == 0;
+        if (!ok)
+            invariantFailed("%s index: '%s' finds row %d, expected row %d", name, key, found, row);
+    }
+    if (unique && live != keyed)
+        invariantFailed("%s index: %d entries for %d rows", name, live, keyed);
+}
+
+// Returns the number of broken invariants, printing the first few
+int checkLotInvariants()
+{
+    invariantCount = 0;
+
+    // Spots against the counters, the free map and the vehicle table: a spot
+    // names a parked vehicle that names the spot back, so no spot is assigned
+    // twice and no vehicle stands in two spots
+    int occupied = 0;
+    int zones[NUM_ZONES] = {0};
+    for (int i = 0; i < MAX_PARKING_SPOTS; i++)
+    {
+        ParkingSpot *spot = &spots[i];
+        if (spot->spotNumber != i + 1)
+            invariantFailed("spot %d: numbered %d", i + 1, spot->spotNumber);
+        if (spot->isOccupied != 0 && spot->isOccupied != 1)
+            invariantFailed("spot %d: occupied flag %d", i + 1, spot->isOccupied);
+#if SPOT_BITMAP
+        if ((int)((freeSpotBits[i / 64] >> (i % 64)) & 1) == (spot->isOccupied != 0))
+            invariantFailed("spot %d: free map disagrees with the spot", i + 1);
+#endif
+        if (!spot->isOccupied)
+        {
+            if (spot->vehicleId[0] != 0 || spot->isPassSession)
+                invariantFailed("spot %d: free but holds '%s'", i + 1, spot->vehicleId);
+            if (spot->entryTime != 0)
+                invariantFailed("spot %d: free but entered at %ld", i + 1, (long)spot->entryTime);
+            continue;
+        }
+        occupied++;
+        zones[getSpotZone(i + 1)]++;
+        int vehicleIndex = indexFind(vehicleIdIndex, VEHICLE_INDEX_SIZE, spot->vehicleId);
+        if (vehicleIndex < 0 || vehicleIndex >= numVehicles)
+            invariantFailed("spot %d: held by unregistered vehicle '%s'", i + 1, spot->vehicleId);
+        else if (!vehicles[vehicleIndex].isParked || vehicles[vehicleIndex].spotNumber != i + 1)
+            invariantFailed("spot %d: held by %s, which is %s", i + 1, spot->vehicleId,
+                            vehicles[vehicleIndex].isParked ? "parked elsewhere" : "not parked");
+        if (spot->isPassSession ? spot->ratePerHour != 0.0 : !(spot->ratePerHour >= 0.0 && isfinite(spot->ratePerHour)))
+            invariantFailed("spot %d: rate %.2f for a %s session", i + 1, spot->ratePerHour,
+                            spot->isPassSession ? "pass" : "paid");
+    }
+    if (occupied != occupiedCount)
+        invariantFailed("occupied count %d, recount %d", occupiedCount, occupied);
+    for (int z = 0; z < NUM_ZONES; z++)
+    {
+        if (zones[z] != zoneOccupied[z])
+            invariantFailed("zone %c: occupied count %d, recount %d", 'A' + z, zoneOccupied[z], zones[z]);
+    }
+
+    for (int i = 0; i < numVehicles; i++)
+    {
+        Vehicle *vehicle = &vehicles[i];
+        if (!vehicle->isParked)
+        {
+            if (vehicle->spotNumber != 0)
+                invariantFailed("vehicle %s: not parked but has spot %d", vehicle->vehicleId, vehicle->spotNumber);
+            continue;
+        }
+        int spotNumber = vehicle->spotNumber;
+        if (vehicle->isParked != 1 || spotNumber < 1 || spotNumber > MAX_PARKING_SPOTS ||
+            !spots[spotNumber - 1].isOccupied || strcmp(spots[spotNumber - 1].vehicleId, vehicle->vehicleId) != 0)
+            invariantFailed("vehicle %s: parked in spot %d, which does not hold it", vehicle->vehicleId, spotNumber);
+    }
+
+    checkIndex("vehicle ID", vehicleIdIndex, VEHICLE_INDEX_SIZE, numVehicles, vehicleIdOf, 1);
+    checkIndex("owner ID", ownerIdIndex, OWNER_INDEX_SIZE, numOwners, ownerIdOf, 1);
+    checkIndex("owner phone", ownerPhoneIndex, OWNER_INDEX_SIZE, numOwners, ownerPhoneOf, 0);
+    checkIndex("pass", passIndex, PASS_INDEX_SIZE, numPasses, passVehicleOf, 1);
+
+    // The expiry heap holds each active pass once, in validUntil order, and
+    // every pass knows its position in it
+    int activePasses = 0;
+    for (int i = 0; i < numPasses; i++)
+    {
+        activePasses += passes[i].isActive;
+        if ((passHeapPos[i] != 0) != passes[i].isActive)
+            invariantFailed("pass %s: %s but %s the expiry heap", passes[i].vehicleId,
+                            passes[i].isActive ? "active" : "inactive", passHeapPos[i] != 0 ? "in" : "not in");
+    }
+    if (passExpiryCount != activePasses)
+        invariantFailed("pass heap: %d entries for %d active passes", passExpiryCount, activePasses);
+    for (int h = 0; h < passExpiryCount; h++)
+    {
+        int idx = passExpiryHeap[h];
+        if (idx < 0 || idx >= numPasses || passHeapPos[idx] != h + 1)
+        {
+            invariantFailed("pass heap: position %d holds pass %d, which is recorded elsewhere", h, idx);
+            break;
+        }
+        if (h > 0 && passes[passExpiryHeap[(h - 1) / 2]].validUntil > passes[idx].validUntil)
+            invariantFailed("pass heap: %s expires before its parent", passes[idx].vehicleId);
+    }
+
+    // Every link sits in both adjacency lists, once
+    int vehicleLinks = 0, ownerLinks = 0;
+    for (int v = 0; v < numVehicles; v++)
+    {
+        for (int link = vehicleFirstLink[v]; link != -1; link = ownerships[link].nextOfVehicle)
+        {
+            if (link < 0 || link >= numOwnerships || ++vehicleLinks > MAX_OWNERSHIPS ||
+                ownerships[link].vehicleIndex != v || ownerships[link].ownerIndex < 0 ||
+                ownerships[link].ownerIndex >= numOwners)
+            {
+                invariantFailed("vehicle %s: broken owner list at link %d", vehicles[v].vehicleId, link);
+                break;
+            }
+        }
+    }
+    for (int o = 0; o < numOwners; o++)
+    {
+        int last = -1;
+        for (int link = ownerFirstLink[o]; link != -1; link = ownerships[link].nextOfOwner)
+        {
+            if (link < 0 || link >= numOwnerships || ++ownerLinks > MAX_OWNERSHIPS ||
+                ownerships[link].ownerIndex != o || ownerships[link].vehicleIndex < 0 ||
+                ownerships[link].vehicleIndex >= numVehicles)
+            {
+                invariantFailed("owner %s: broken vehicle list at link %d", owners[o].ownerId, link);
+                break;
+            }
+            last = link;
+        }
+        if (ownerLastLink[o] != last)
+            invariantFailed("owner %s: list tail %d, walked to %d", owners[o].ownerId, ownerLastLink[o], last);
+    }
+    if (vehicleLinks != ownerLinks)
+        invariantFailed("ownership links: %d from the vehicles, %d from the owners", vehicleLinks, ownerLinks);
+
+    // The waitlist queues against their depths and the vehicles' back links
+    int waiting = 0, marked = 0;
+    for (int c = 0; c < NUM_WAIT_CLASSES; c++)
+    {
+        int count = 0, prev = -1;
+        for (int entry = waitHead[c]; entry != -1; entry = waitEntries[entry].next)
+        {
+            WaitEntry *wait = &waitEntries[entry];
+            if (entry < 0 || entry >= waitEntriesUsed || ++count > WAITLIST_MAX || wait->prev != prev ||
+                wait->waitClass != c || wait->vehicleIndex < 0 || wait->vehicleIndex >= numVehicles ||
+                vehicleWaitEntry[wait->vehicleIndex] != entry + 1)
+            {
+                invariantFailed("waitlist %s: broken queue at entry %d", waitClassNames[c], entry);
+                break;
+            }
+            if (vehicles[wait->vehicleIndex].isParked)
+                invariantFailed("waitlist %s: %s waits but is parked", waitClassNames[c],
+                                vehicles[wait->vehicleIndex].vehicleId);
+            prev = entry;
+        }
+        if (count != waitDepth[c] || waitTail[c] != prev)
+            invariantFailed("waitlist %s: depth %d, walked %d", waitClassNames[c], waitDepth[c], count);
+        waiting += count;
+    }
+    for (int v = 0; v < numVehicles; v++)
+        marked += vehicleWaitEntry[v] != 0;
+    if (marked != waiting)
+        invariantFailed("waitlist: %d vehicles marked waiting, %d queued", marked, waiting);
+
+    // Search indexes: the entry order lists each parked spot once, oldest
+    // first; the plate order, unless due for a rebuild, lists each vehicle
+    // once by plate; each trigram of an owner's name lists that owner once,
+    // in owner order, and the lists hold nothing else
+    int previous = -1;
+    for (int pos = 0; pos < entryOrderCount; pos++)
+    {
+        int s = entryOrder[pos];
+        if (s < 0 || s >= MAX_PARKING_SPOTS || !spots[s].isOccupied)
+        {
+            invariantFailed("entry order: position %d holds spot %d, which is free", pos, s + 1);
+            break;
+        }
+        if (previous != -1 && (spots[previous].entryTime > spots[s].entryTime ||
+                               (spots[previous].entryTime == spots[s].entryTime && previous >= s)))
+            invariantFailed("entry order: spot %d listed after spot %d", s + 1, previous + 1);
+        previous = s;
+    }
+    if (entryOrderCount != occupiedCount)
+        invariantFailed("entry order: %d spots for %d parked", entryOrderCount, occupiedCount);
+
+    if (!plateOrderStale && plateOrderCount == numVehicles)
+    {
+        for (int pos = 0; pos < plateOrderCount; pos++)
+        {
+            if (plateOrder[pos] < 0 || plateOrder[pos] >= numVehicles)
+            {
+                invariantFailed("plate order: position %d holds row %d", pos, plateOrder[pos]);
+                break;
+            }
+            if (pos > 0 && comparePlateOrder(&plateOrder[pos - 1], &plateOrder[pos]) >= 0)
+                invariantFailed("plate order: %s listed after %s", vehicles[plateOrder[pos]].licensePlate,
+                                vehicles[plateOrder[pos - 1]].licensePlate);
+        }
+    }
+
+    int postings = 0;
+    for (int o = 0; o < numOwners; o++)
+    {
+        const char *name = owners[o].name;
+        for (int i = 0; name[i] != 0 && name[i + 1] != 0 && name[i + 2] != 0; i++)
+        {
+            int trigram = trigramAt(name + i), repeated = 0;
+            for (int j = 0; j < i; j++)
+                repeated |= trigramAt(name + j) == trigram;
+            if (repeated)
+                continue;
+            int listed = 0, last = -1;
+            for (int p = trigramFirst[trigram]; p != 0; p = trigramPostings[p - 1].next)
+            {
+                int owner = p <= numTrigramPostings ? trigramPostings[p - 1].ownerIndex : -1;
+                if (owner <= last || owner >= numOwners)
+                {
+                    invariantFailed("owner trigrams: broken list at posting %d", p);
+                    break;
+                }
+                listed += owner == o;
+                last = owner;
+            }
+            if (listed != 1)
+                invariantFailed("owner %s: name trigram %.3s listed %d times", owners[o].ownerId, name + i, listed);
+            postings++;
+        }
+    }
+    if (postings != numTrigramPostings)
+        invariantFailed("owner trigrams: %d postings for %d name trigrams", numTrigramPostings, postings);
+
+    if (invariantCount > SELFCHECK_MAX_REPORTED)
+        printf("INVARIANT: ... and %d more\n", invariantCount - SELFCHECK_MAX_REPORTED);
+    return invariantCount;
+}
+
+static int selfCheckRegister(unsigned long long *rng)
+{
+    if (numVehicles >= MAX_VEHICLES)
+        return -1;
+    int i = numVehicles;
+    Vehicle *vehicle = &vehicles[i];
+    memset(vehicle, 0, sizeof(Vehicle));
+    selfCheckSerial++;
+    sprintf(vehicle->vehicleId, "SC%06d", selfCheckSerial);
+    sprintf(vehicle->licensePlate, "SC-%04d", selfCheckSerial % 10000);
+    strcpy(vehicle->vehicleType, simProfiles[selfCheckSerial % SIM_NUM_PROFILES].type);
+    vehicleFirstLink[i] = -1;
+    vehicleWaitEntry[i] = 0;
+    indexInsert(vehicleIdIndex, VEHICLE_INDEX_SIZE, vehicle->vehicleId, i);
+    numVehicles++;
+    invalidatePlateIndex();
+    plateOrderAdd(i);
+    if (numOwners > 0)
+        linkOwnerVehicle((int)(randomNext(rng) % numOwners), i);
+    return i;
+}
+
+// Empty lot with owners, a fleet half again the size of the lot and some passes
+static void selfCheckFreshLot(unsigned long long *rng, time_t start)
+{
+    for (int i = 0; i < MAX_PARKING_SPOTS; i++)
+    {
+        memset(&spots[i], 0, sizeof(ParkingSpot));
+        spots[i].spotNumber = i + 1;
+    }
+    occupiedCount = 0;
+    rebuildFreeSpots();
+    recountZones();
+    rebuildEntryOrder();
+    feedResyncAll();
+    timerWheelReset(start);
+    waitlistClear();
+
+    indexClear(ownerIdIndex, OWNER_INDEX_SIZE);
+    indexClear(ownerPhoneIndex, OWNER_INDEX_SIZE);
+    ownerTrigramsClear();
+    numOwners = MAX_OWNERS < 32 ? MAX_OWNERS : 32;
+    numVehicles = 0;
+    resetOwnerships();
+    for (int o = 0; o < numOwners; o++)
+    {
+        memset(&owners[o], 0, sizeof(Owner));
+        sprintf(owners[o].ownerId, "SCO%04d", o + 1);
+        sprintf(owners[o].name, "Owner %d", o + 1);
+        sprintf(owners[o].phoneNumber, "0170%07d", o % 24); // Some owners share a phone
+        addOwnerToIndexes(o);
+    }
+
+    indexClear(vehicleIdIndex, VEHICLE_INDEX_SIZE);
+    invalidatePlateOrder();
+    ensurePlateOrder(); // Empty, so the registrations below keep it sorted
+    selfCheckSerial = 0;
+    int fleet = MAX_PARKING_SPOTS + MAX_PARKING_SPOTS / 2 + 4;
+    while (numVehicles < fleet && selfCheckRegister(rng) != -1)
+        ;
+
+    numPasses = 0;
+    passHeapClear();
+    indexClear(passIndex, PASS_INDEX_SIZE);
+    for (int v = 0; v < numVehicles && numPasses < MAX_PASSES; v += 5)
+    {
+        Pass *pass = &passes[numPasses];
+        memset(pass, 0, sizeof(Pass));
+        strcpy(pass->vehicleId, vehicles[v].vehicleId);
+        sprintf(pass->holderName, "Holder %d", numPasses + 1);
+        pass->validFrom = start - 86400;
+        pass->validUntil = start + (time_t)(randomNext(rng) % (60 * 86400));
+        pass->monthlyQuota = randomNext(rng) % 2 ? 0 : 5 + (int)(randomNext(rng) % 20);
+        pass->zoneMask = (unsigned int)(randomNext(rng) % ALL_ZONES) + 1;
+        pass->isActive = 1;
+        indexInsert(passIndex, PASS_INDEX_SIZE, pass->vehicleId, numPasses);
+        passHeapPush(numPasses);
+        timerArm(PASS_TIMER(numPasses), pass->validUntil, ALERT_PASS_EXPIRED);
+        numPasses++;
+    }
+}
+
+// Issues a pass the way the Manage Passes menu does, or renews the one the vehicle holds
+static void selfCheckIssuePass(unsigned long long *rng, int vehicleIndex, time_t now)
+{
+    sweepExpiredPasses(now);
+    int days = 1 + (int)(randomNext(rng) % 40);
+    int passIdx = indexFind(passIndex, PASS_INDEX_SIZE, vehicles[vehicleIndex].vehicleId);
+    if (passIdx != -1)
+    {
+        renewPass(passIdx, days);
+        return;
+    }
+    passIdx = allocatePassSlot();
+    if (passIdx == -1)
+        return;
+    Pass *pass = &passes[passIdx];
+    memset(pass, 0, sizeof(Pass));
+    strcpy(pass->vehicleId, vehicles[vehicleIndex].vehicleId);
+    strcpy(pass->holderName, "-");
+    pass->monthlyQuota = randomNext(rng) % 2 ? 0 : 5 + (int)(randomNext(rng) % 20);
+    pass->zoneMask = (unsigned int)(randomNext(rng) % ALL_ZONES) + 1;
+    activatePass(passIdx, now, days);
+}
+
+// Loads the data files the way initializeSystem does, from an empty lot
+static void selfCheckLoad()
+{
+    for (int i = 0; i < MAX_PARKING_SPOTS; i++)
+    {
+        memset(&spots[i], 0, sizeof(ParkingSpot));
+        spots[i].spotNumber = i + 1;
+    }
+    occupiedCount = 0;
+    rebuildFreeSpots();
+    recountZones();
+    rebuildEntryOrder();
+    loadOwnerData();
+    loadVehicleData();
+    loadParkingData();
+    reconcileLot();
+    loadPassData();
+}
+
+static void selfCheckPrepare(const char *scratchRoot)
+{
+    snprintf(dataRoot, sizeof(dataRoot), "%s", scratchRoot);
+    createFolders();
+    alertSink = alertSinkNone;
+    dataWarnings = 0;
+}
+
+// One random edit of a data file: bytes changed, dropped or inserted, a line
+// repeated, or the file cut short. Returns the new size.
+static long selfCheckMutate(char *data, long size, long capacity, unsigned long long *rng)
+{
+    static const char alphabet[] = "|\n0123456789-+. eEnaix";
+    static const char *tokens[] = {"|", "\n", "0", "1", "-1", "|1|", "99999999999999999999", "nan", "inf",
+                                   "1e308", "SC000001", "SCO0001", "\n1\n", "\n50\n"};
+    long pos = (long)(randomNext(rng) % (unsigned long long)(size + 1));
+    switch (randomNext(rng) % 6)
+    {
+    case 0:
+        if (pos < size)
+            data[pos] = alphabet[randomNext(rng) % (sizeof(alphabet) - 1)];
+        break;
+    case 1:
+        if (pos < size)
+        {
+            long length = 1 + (long)(randomNext(rng) % 16);
+            if (length > size - pos)
+                length = size - pos;
+            memmove(data + pos, data + pos + length, size - pos - length);
+            size -= length;
+        }
+        break;
+    case 2:
+    {
+        const char *token = tokens[randomNext(rng) % (sizeof(tokens) / sizeof(tokens[0]))];
+        long length = (long)strlen(token);
+        if (size + length <= capacity)
+        {
+            memmove(data + pos + length, data + pos, size - pos);
+            memcpy(data + pos, token, length);
+            size += length;
+        }
+        break;
+    }
+    case 3:
+    {
+        // Repeat the line around pos at the start of another line
+        long start = pos, end = pos;
+        while (start > 0 && data[start - 1] != '\n')
+            start--;
+        while (end < size && data[end++] != '\n')
+            ;
+        long at = (long)(randomNext(rng) % (unsigned long long)(size + 1));
+        while (at > 0 && data[at - 1] != '\n')
+            at--;
+        long length = end - start;
+        if (length > 0 && size + length <= capacity)
+        {
+            char line[512];
+            if (length > (long)sizeof(line))
+                break;
+            memcpy(line, data + start, length);
+            memmove(data + at + length, data + at, size - at);
+            memcpy(data + at, line, length);
+            size += length;
+        }
+        break;
+    }
+    case 4:
+        size = pos;
+        break;
+    default:
+        if (pos < size)
+            data[pos] = (char)(randomNext(rng) & 0xFF);
+        break;
+    }
+    return size;
+}
+
+static int selfCheckWriteFile(const char *relative, const char *data, long size)
+{
+    char path[300];
+    buildDataPath(path, sizeof(path), relative);
+    FILE *fp = fopen(path, "wb");
+    if (fp == NULL)
+        return 0;
+    int ok = fwrite(data, 1, size, fp) == (size_t)size;
+    return fclose(fp) == 0 && ok;
+}
+
+// Returns the number of broken invariants (0 when everything held)
+int runSelfCheck(long operations, unsigned long long seed, const char *scratchRoot)
+{
+    static const char *stepNames[] = {"park",         "unpark",   "remove",         "leave waitlist",
+                                      "add co-owner", "register", "issue/renew pass", "cancel pass"};
+    unsigned long long rng = seed;
+    time_t now = SIM_START_TIME;
+
+    if (operations < 0)
+    {
+        printf("Usage: --selfcheck [operations] [seed] [scratch folder]\n");
+        return 1;
+    }
+    selfCheckPrepare(scratchRoot);
+    clockSet(now);
+    selfCheckFreshLot(&rng, now);
+    long long t0 = monotonicNanos();
+    if (checkLotInvariants() > 0)
+    {
+        printf("The fresh lot already breaks invariants.\n");
+        return invariantCount;
+    }
+
+    long steps[8] = {0};
+    for (long step = 1; step <= operations; step++)
+    {
+        now += (time_t)(randomNext(&rng) % 1800);
+        clockSet(now);
+        timerWheelAdvance(now);
+
+        int roll = (int)(randomNext(&rng) % 100);
+        int kind = roll < 38 ? 0 : roll < 74 ? 1 : roll < 80 ? 2 : roll < 85 ? 3 : roll < 89 ? 4 : roll < 92 ? 5
+                 : roll < 97 ? 6 : 7;
+        int vehicleIndex = numVehicles > 0 ? (int)(randomNext(&rng) % numVehicles) : -1;
+        if (vehicleIndex == -1)
+            kind = 5;
+        char vehicleId[VEHICLE_ID_LEN] = "";
+        if (vehicleIndex != -1)
+            strcpy(vehicleId, vehicles[vehicleIndex].vehicleId);
+
+        switch (kind)
+        {
+        case 0:
+        {
+            GateResult result = gateParkVehicle(vehicleIndex, now);
+            if (result.status == GATE_LOT_FULL)
+                waitlistJoin(vehicleIndex, result.passStatus == PASS_OK ? WAIT_PASS
+                                           : randomNext(&rng) % 2   ? WAIT_RESERVED
+                                                                    : WAIT_WALK_IN,
+                             now);
+            break;
+        }
+        case 1:
+            gateUnparkVehicle(vehicleIndex, now);
+            break;
+        case 2:
+            gateRemoveVehicle(vehicleIndex, now);
+            selfCheckRegister(&rng);
+            break;
+        case 3:
+            waitlistLeave(vehicleIndex);
+            break;
+        case 4:
+            linkOwnerVehicle((int)(randomNext(&rng) % numOwners), vehicleIndex);
+            break;
+        case 5:
+            selfCheckRegister(&rng);
+            break;
+        case 6:
+            selfCheckIssuePass(&rng, vehicleIndex, now);
+            break;
+        default:
+        {
+            int passIdx = indexFind(passIndex, PASS_INDEX_SIZE, vehicleId);
+            if (passIdx != -1)
+                removePass(passIdx);
+            break;
+        }
+        }
+        steps[kind]++;
+
+        if (checkLotInvariants() > 0)
+        {
+            printf("Step %ld (%s %s) broke %d invariant(s). Rerun: --selfcheck %ld %llu\n", step, stepNames[kind],
+                   vehicleId, invariantCount, step, seed);
+            return invariantCount;
+        }
+    }
+    printf("Gate engine: %ld step(s) (%ld park, %ld unpark, %ld remove, %ld waitlist, %ld link, %ld register, "
+           "%ld pass issue/renew, %ld pass cancel), invariants held, %.1f ms\n",
+           operations, steps[0], steps[1], steps[2], steps[3], steps[4], steps[5], steps[6], steps[7],
+           (monotonicNanos() - t0) / 1e6);
+
+    // Loader fuzzing, starting from the files of the lot just checked
+    saveOwnerData();
+    saveVehicleData();
+    saveParkingData();
+    savePassData();
+    char *original[SELFCHECK_FILES];
+    char *mutated[SELFCHECK_FILES];
+    long originalSize[SELFCHECK_FILES];
+    for (int f = 0; f < SELFCHECK_FILES; f++)
+    {
+        DataReader reader;
+        originalSize[f] = 0;
+        original[f] = NULL;
+        if (dataReaderOpen(&reader, selfCheckFiles[f]))
+        {
+            original[f] = heapAlloc(reader.size);
+            memcpy(original[f], reader.data, reader.size);
+            originalSize[f] = (long)reader.size;
+            dataReaderClose(&reader);
+        }
+        mutated[f] = heapAlloc(originalSize[f] + SELFCHECK_MAX_GROWTH);
+    }
+
+    t0 = monotonicNanos();
+    long fixesBefore = reconcileFixes, warningsBefore = dataWarningCount;
+    int failed = 0;
+    long round;
+    for (round = 1; round <= SELFCHECK_FUZZ_ROUNDS && !failed; round++)
+    {
+        for (int f = 0; f < SELFCHECK_FILES; f++)
+        {
+            long size = originalSize[f];
+            if (size > 0)
+                memcpy(mutated[f], original[f], size);
+            if (randomNext(&rng) % 2)
+            {
+                int edits = 1 + (int)(randomNext(&rng) % 4);
+                for (int e = 0; e < edits; e++)
+                    size = selfCheckMutate(mutated[f], size, originalSize[f] + SELFCHECK_MAX_GROWTH, &rng);
+            }
+            selfCheckWriteFile(selfCheckFiles[f], mutated[f], size);
+        }
+        selfCheckLoad();
+        if (checkLotInvariants() > 0)
+        {
+            printf("Fuzz round %ld broke %d invariant(s); the files are left in %s/\n", round, invariantCount,
+                   dataRoot);
+            failed = invariantCount;
+        }
+    }
+    for (int f = 0; f < SELFCHECK_FILES; f++)
+    {
+        free(original[f]);
+        free(mutated[f]);
+    }
+    if (!failed)
+        printf("Loaders: %d mutated file set(s), %ld record(s) rejected, %ld lot record(s) reconciled, "
+               "invariants held, %.1f ms\n",
+               SELFCHECK_FUZZ_ROUNDS, dataWarningCount - warningsBefore, reconcileFixes - fixesBefore,
+               (monotonicNanos() - t0) / 1e6);
+    return failed;
+}
+
+#ifdef FUZZ_LOADERS
+// libFuzzer entry: clang -DFUZZ_LOADERS -fsanitize=fuzzer,address main.c -lm -pthread
+// The input holds the owner, vehicle, parking and pass files, split at NUL bytes.
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    static int prepared = 0;
+    if (!prepared)
+    {
+        selfCheckPrepare("fuzz_data");
+        prepared = 1;
+    }
+    const char *part = (const char *)data;
+    const char *end = part + size;
+    for (int f = 0; f < SELFCHECK_FILES; f++)
+    {
+        const char *next = part < end ? memchr(part, 0, end - part) : NULL;
+        long length = (long)((next ? next : end) - part);
+        selfCheckWriteFile(selfCheckFiles[f], part, length);
+        part = next ? next + 1 : end;
+    }
+    selfCheckLoad();
+    if (checkLotInvariants() > 0)
+        abort();
+    return 0;
+}
+#endif
+
+// Micro-benchmark Suite
+// Each case is calibrated to run at least BENCH_MIN_NANOS, then repeated
+// BENCH_REPEATS times; the median ns/op is reported so runs stay comparable.
+#define BENCH_MIN_NANOS 50000000LL
+#define BENCH_REPEATS 5
+#define BENCH_KEYS 1024
+
+static char benchKeys[BENCH_KEYS][VEHICLE_ID_LEN];
+static char benchPlates[BENCH_KEYS][LICENSE_PLATE_LEN];
+static volatile double benchSink;
+
+static long benchFileSize(const char *relative)
+{
+    FILE *fp = openDataFile(relative, "rb");
+    if (fp == NULL)
+        return 0;
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fclose(fp);
+    return size;
+}
+
+static void benchRemoveFile(const char *relative)
+{
+    char path[300];
+    buildDataPath(path, sizeof(path), relative);
+    remove(path);
+}
+
+// Each case runs the operation n times and returns the bytes it wrote
+static long benchFindVehicle(long iterations)
+{
+    for (long i = 0; i < iterations; i++)
+        benchSink += findVehicleById(benchKeys[i & (BENCH_KEYS - 1)]);
+    return 0;
+}
+
+static long benchMatchPlateExact(long iterations)
+{
+    int distance;
+    for (long i = 0; i < iterations; i++)
+        benchSink += matchPlate(benchPlates[i & (BENCH_KEYS - 1)], &distance);
+    return 0;
+}
+
+// One OCR error on the series letter: misses the exact index, forces the BK-tree search
+static long benchMatchPlateFuzzy(long iterations)
+{
+    int distance;
+    char plate[LICENSE_PLATE_LEN];
+    for (long i = 0; i < iterations; i++)
+    {
+        strcpy(plate, benchPlates[i & (BENCH_KEYS - 1)]);
+        plate[0] = 'X';
+        benchSink += matchPlate(plate, &distance);
+    }
+    return 0;
+}
+
+// First page of the plates sharing a series and the first two digits
+static long benchSearchPlatePrefix(long iterations)
+{
+    int results[SEARCH_PAGE_SIZE], total;
+    char prefix[LICENSE_PLATE_LEN];
+    for (long i = 0; i < iterations; i++)
+    {
+        snprintf(prefix, sizeof(prefix), "%.6s", benchPlates[i & (BENCH_KEYS - 1)]);
+        benchSink += searchPlatePrefix(prefix, 0, results, SEARCH_PAGE_SIZE, &total) + total;
+    }
+    return 0;
+}
+
+// Two OCR errors: falls through to the BK-tree
+static long benchMatchPlateTwoEdits(long iterations)
+{
+    int distance;
+    char plate[LICENSE_PLATE_LEN];
+    for (long i = 0; i < iterations; i++)
+    {
+        strcpy(plate, benchPlates[i & (BENCH_KEYS - 1)]);
+        plate[0] = 'X';
+        plate[1] = 'Y';
+        benchSink += matchPlate(plate, &distance);
+    }
+    return 0;
+}
+
+// The validators as they were before the table-driven rewrite, kept as the
+// baseline for the validation benchmarks (the plate check no longer prints)
+static int legacyIsValidName(char *name)
+{
+    if (strlen(name) > 20 || strlen(name) < 2)
+        return 0;
+    for (int i = 0; i < (int)strlen(name); i++)
+    {
+        if (!isalpha(name[i]) && name[i] != ' ')
+            return 0;
+    }
+    return 1;
+}
+
+static int legacyIsValidEmail(char *email)
+{
+    if (strlen(email) > 20 || strlen(email) < 5)
+        return 0;
+    return strstr(email, "@gmail.com") != NULL;
+}
+
+static int legacyIsValidPhoneNumber(char *phone)
+{
+    if (strlen(phone) != 11)
+        return 0;
+    for (int i = 0; i < 11; i++)
+    {
+        if (!isdigit(phone[i]))
+            return 0;
+    }
+    return 1;
+}
+
+static int legacyIsValidLicensePlate(char *plate)
+{
+    char letters[4];
+    int digits;
+    if (sscanf(plate, "%3[A-Z]-%4d", letters, &digits) != 2)
+        return strlen(plate) == 8;
+    return 1;
+}
+
+// Mixed valid and invalid inputs, the shape of an imported registry
+#define BENCH_SAMPLES 8
+static char benchNames[BENCH_SAMPLES][NAME_LEN] = {
+    "Tithy Rahman", "Nishat", "John Smith", "A", "Bad Name 123", "Maria Lopez Garcia", "X Y", "Abdullah Al Mamun"};
+static char benchPhones[BENCH_SAMPLES][CONTACT_LEN] = {
+    "01234567890", "01711223344", "0123456789", "01A34567890", "01999999999", "98765432101", "01555555555", ""};
+static char benchEmails[BENCH_SAMPLES][EMAIL_LEN] = {
+    "tithy1@gmail.com", "nish@gmail.com", "x@yahoo.com", "a@gmail.com", "bad", "john.smith@gmail.com",
+    "name@gmail.comx", "@gmail.com"};
+static char benchPlateSamples[BENCH_SAMPLES][LICENSE_PLATE_LEN] = {
+    "ASF-1234", "DHK-0001", "AB-1234", "abc-1234", "ABC-12345", "XYZ-9876", "ABC1234", "QRS-4321"};
+
+static long benchValidateName(long iterations)
+{
+    for (long i = 0; i < iterations; i++)
+        benchSink += isValidName(benchNames[i & (BENCH_SAMPLES - 1)]);
+    return 0;
+}
+
+static long benchLegacyValidateName(long iterations)
+{
+    for (long i = 0; i < iterations; i++)
+        benchSink += legacyIsValidName(benchNames[i & (BENCH_SAMPLES - 1)]);
+    return 0;
+}
+
+static long benchValidateEmail(long iterations)
+{
+    for (long i = 0; i < iterations; i++)
+        benchSink += isValidEmail(benchEmails[i & (BENCH_SAMPLES - 1)]);
+    return 0;
+}
+
+static long benchLegacyValidateEmail(long iterations)
+{
+    for (long i = 0; i < iterations; i++)
+        benchSink += legacyIsValidEmail(benchEmails[i & (BENCH_SAMPLES - 1)]);
+    return 0;
+}
+
+static long benchValidatePhone(long iterations)
+{
+    for (long i = 0; i < iterations; i++)
+        benchSink += isValidPhoneNumber(benchPhones[i & (BENCH_SAMPLES - 1)]);
+    return 0;
+}
+
+static long benchLegacyValidatePhone(long iterations)
+{
+    for (long i = 0; i < iterations; i++)
+        benchSink += legacyIsValidPhoneNumber(benchPhones[i & (BENCH_SAMPLES - 1)]);
+    return 0;
+}
+
+static long benchValidatePlate(long iterations)
+{
+    for (long i = 0; i < iterations; i++)
+        benchSink += isValidLicensePlate(benchPlateSamples[i & (BENCH_SAMPLES - 1)]);
+    return 0;
+}
+
+static long benchLegacyValidatePlate(long iterations)
+{
+    for (long i = 0; i < iterations; i++)
+        benchSink += legacyIsValidLicensePlate(benchPlateSamples[i & (BENCH_SAMPLES - 1)]);
+    return 0;
+}
+
+// One full registry record (name, phone, email, plate) per operation
+static long benchValidateRecords(long iterations)
+{
+    ValidationRecord records[BENCH_SAMPLES];
+    unsigned int errors[BENCH_SAMPLES];
+    for (int k = 0; k < BENCH_SAMPLES; k++)
+    {
+        records[k].name = benchNames[k];
+        records[k].phone = benchPhones[k];
+        records[k].email = benchEmails[k];
+        records[k].password = NULL;
+        records[k].plate = benchPlateSamples[k];
+        records[k].vehicleType = NULL;
+    }
+    for (long i = 0; i < iterations; i += BENCH_SAMPLES)
+        benchSink += validateRecords(records, BENCH_SAMPLES, errors);
+    return 0;
+}
+
+static long benchFindSpot(long iterations)
+{
+    for (long i = 0; i < iterations; i++)
+        benchSink += findAvailableSpot();
+    return 0;
+}
+
+static long benchFee(long iterations)
+{
+    for (long i = 0; i < iterations; i++)
+        benchSink += calculateParkingFeeAt(SIM_START_TIME, SIM_START_TIME + i, BASE_RATE_PER_HOUR);
+    return 0;
+}
+
+// Lookup by ID, park, unpark: the work of one visit minus persistence
+static long benchRoundTrip(long iterations)
+{
+    time_t now = SIM_START_TIME;
+    for (long i = 0; i < iterations; i++)
+    {
+        int vehicleIndex = findVehicleById(benchKeys[i & (BENCH_KEYS - 1)]);
+        gateParkVehicle(vehicleIndex, now);
+        benchSink += gateUnparkVehicle(vehicleIndex, now + 3600).fee;
+    }
+    return 0;
+}
+
+// Same round trip with every display slot subscribed and drained every 64 visits
+static long benchFeedRoundTrip(long iterations)
+{
+    SpotEvent events[FEED_POLL_BATCH];
+    time_t now = SIM_START_TIME;
+    for (long i = 0; i < iterations; i++)
+    {
+        int vehicleIndex = findVehicleById(benchKeys[i & (BENCH_KEYS - 1)]);
+        gateParkVehicle(vehicleIndex, now);
+        benchSink += gateUnparkVehicle(vehicleIndex, now + 3600).fee;
+        if ((i & 63) == 63)
+        {
+            for (int s = 0; s < feedSubscriberLimit; s++)
+            {
+                while (feedPoll(s, events, FEED_POLL_BATCH) > 0)
+                    ;
+            }
+        }
+    }
+    return 0;
+}
+
+// One visit as the console runs it: park, unpark and every save in between.
+// Once the arena is warm this makes no heap allocation at all.
+static long benchVisitWithSaves(long iterations)
+{
+    time_t now = SIM_START_TIME;
+    // Start from empty files so every repeat appends the same amount
+    benchRemoveFile("vehicles/data.txt");
+    benchRemoveFile("parking/data.txt");
+    benchRemoveFile("forecast/data.txt");
+    unsigned long long written = 0;
+    for (int f = 0; f < NUM_SAVE_FILES; f++)
+        written -= bytesWritten[f];
+    for (long i = 0; i < iterations; i++)
+    {
+        int vehicleIndex = findVehicleById(benchKeys[i & (BENCH_KEYS - 1)]);
+        gateParkVehicle(vehicleIndex, now);
+        saveVehicleData();
+        saveParkingData();
+        benchSink += gateUnparkVehicle(vehicleIndex, now + 3600).fee;
+        saveVehicleData();
+        saveParkingData();
+        saveForecastData();
+    }
+    for (int f = 0; f < NUM_SAVE_FILES; f++)
+        written += bytesWritten[f];
+    benchRemoveFile("vehicles/data.txt");
+    benchRemoveFile("parking/data.txt");
+    benchRemoveFile("forecast/data.txt");
+    return (long)written;
+}
+
+static long benchSaveVehicles(long iterations)
+{
+    benchRemoveFile("vehicles/data.txt");
+    for (long i = 0; i < iterations; i++)
+        saveVehicleData();
+    return benchFileSize("vehicles/data.txt");
+}
+
+static long benchLoadVehicles(long iterations)
+{
+    for (long i = 0; i < iterations; i++)
+        loadVehicleData();
+    return 0;
+}
+
+static long benchReport(long iterations)
+{
+    int occupied;
+    double revenue;
+    DataWriter writer;
+    if (!dataWriterOpen(&writer, "reports/bench_report.txt", 0))
+        return 0;
+    for (long i = 0; i < iterations; i++)
+        writeReport(&writer, SIM_START_TIME, &occupied, &revenue);
+    return dataWriterClose(&writer);
+}
+
+// Runs one case and prints its row
+static void benchRun(const char *name, long fleet, long (*fn)(long))
+{
+    long iterations = 1;
+    while (1)
+    {
+        long long t0 = monotonicNanos();
+        fn(iterations);
+        if (monotonicNanos() - t0 >= BENCH_MIN_NANOS / 10 || iterations >= (1L << 30))
+            break;
+        iterations *= 2;
+    }
+    // Scale up to the target duration from the last calibration step
+    long long t0 = monotonicNanos();
+    fn(iterations);
+    long long elapsed = monotonicNanos() - t0;
+    if (elapsed > 0 && elapsed < BENCH_MIN_NANOS)
+        iterations = (long)(iterations * ((double)BENCH_MIN_NANOS / elapsed)) + 1;
+
+    double samples[BENCH_REPEATS];
+    unsigned long long allocs = 0;
+    double bytes = 0;
+    for (int r = 0; r < BENCH_REPEATS; r++)
+    {
+        unsigned long long allocStart = heapAllocCount;
+        t0 = monotonicNanos();
+        bytes += fn(iterations);
+        samples[r] = (double)(monotonicNanos() - t0) / iterations;
+        allocs += heapAllocCount - allocStart;
+    }
+
+    // Median of the repeats
+    for (int i = 1; i < BENCH_REPEATS; i++)
+    {
+        for (int j = i; j > 0 && samples[j - 1] > samples[j]; j--)
+        {
+            double tmp = samples[j];
+            samples[j] = samples[j - 1];
+            samples[j - 1] = tmp;
+        }
+    }
+
+    char fleetText[24], allocText[24];
+    if (fleet > 0)
+        sprintf(fleetText, "%ld", fleet);
+    else
+        strcpy(fleetText, "-");
+    sprintf(allocText, "%.2f", (double)allocs / ((double)iterations * BENCH_REPEATS));
+
+    printf("%-24s %9s %14.1f %11s %12.0f\n", name, fleetText, samples[BENCH_REPEATS / 2], allocText,
+           bytes / ((double)iterations * BENCH_REPEATS));
+    fflush(stdout);
+}
+
+// Fleet of n registered vehicles; the last MAX_PARKING_SPOTS are parked (worst case for lookups)
+static void benchSetupFleet(long n, int parkTail)
+{
+    unsigned long long rng = 12345;
+    numVehicles = (int)n;
+    for (int i = 0; i < numVehicles; i++)
+    {
+        memset(&vehicles[i], 0, sizeof(Vehicle));
+        sprintf(vehicles[i].vehicleId, "VH%07d", i + 1);
+        int series = i / 10000;
+        sprintf(vehicles[i].licensePlate, "%c%c%c-%04d", 'A' + series / 676 % 26, 'A' + series / 26 % 26,
+                'A' + series % 26, i % 10000);
+        vehicleFirstLink[i] = -1;
+        strcpy(vehicles[i].vehicleType, simProfiles[i % SIM_NUM_PROFILES].type);
+    }
+    for (int i = 0; i < MAX_PARKING_SPOTS; i++)
+    {
+        memset(&spots[i], 0, sizeof(ParkingSpot));
+        spots[i].spotNumber = i + 1;
+    }
+    occupiedCount = 0;
+    rebuildFreeSpots();
+    recountZones();
+    rebuildEntryOrder();
+    feedResyncAll();
+    timerWheelReset(SIM_START_TIME);
+    alertSink = alertSinkNone;
+    rebuildVehicleIndex();
+    invalidatePlateOrder();
+    ensurePlateOrder();
+    for (int k = 0; k < BENCH_KEYS; k++)
+    {
+        int i = (int)(randomNext(&rng) % numVehicles);
+        strcpy(benchKeys[k], vehicles[i].vehicleId);
+        strcpy(benchPlates[k], vehicles[i].licensePlate);
+    }
+
+    if (parkTail)
+    {
+        for (int i = 0; i < MAX_PARKING_SPOTS && i < numVehicles; i++)
+            gateParkVehicle(numVehicles - 1 - i, SIM_START_TIME);
+    }
+}
+
+void runBenchmarks(long maxFleet, const char *scratchRoot)
+{
+    static const long fleetSizes[] = {50, 500, 5000, 50000, 1000000};
+
+    snprintf(dataRoot, sizeof(dataRoot), "%s", scratchRoot);
+    createFolders();
+    numPasses = 0;
+    passHeapClear();
+    indexClear(passIndex, PASS_INDEX_SIZE);
+
+    printf("\n========== MICRO-BENCHMARKS ==========\n");
+    printf("Lot: %d spots, vehicle table: %d, scratch data: %s/\n", MAX_PARKING_SPOTS, MAX_VEHICLES, dataRoot);
+    printf("%-24s %9s %14s %11s %12s\n", "Benchmark", "Fleet", "ns/op", "allocs/op", "bytes/op");
+    printf("------------------------------------------------------------------------\n");
+
+    // Fleet independent cases: nearly full lot, free spot at the very end
+    benchSetupFleet(MAX_PARKING_SPOTS < MAX_VEHICLES ? MAX_PARKING_SPOTS : MAX_VEHICLES, 1);
+    if (MAX_PARKING_SPOTS <= MAX_VEHICLES)
+        gateUnparkVehicle(0, SIM_START_TIME);
+    benchRun("findAvailableSpot", 0, benchFindSpot);
+    benchRun("calculateParkingFee", 0, benchFee);
+    benchRun("isValidName", 0, benchValidateName);
+    benchRun("isValidName (legacy)", 0, benchLegacyValidateName);
+    benchRun("isValidEmail", 0, benchValidateEmail);
+    benchRun("isValidEmail (legacy)", 0, benchLegacyValidateEmail);
+    benchRun("isValidPhoneNumber", 0, benchValidatePhone);
+    benchRun("isValidPhone (legacy)", 0, benchLegacyValidatePhone);
+    benchRun("isValidLicensePlate", 0, benchValidatePlate);
+    benchRun("isValidPlate (legacy)", 0, benchLegacyValidatePlate);
+    benchRun("validateRecords", 0, benchValidateRecords);
+    benchRun("park/unpark with saves", 0, benchVisitWithSaves);
+
+    for (int f = 0; f < (int)(sizeof(fleetSizes) / sizeof(fleetSizes[0])); f++)
+    {
+        long fleet = fleetSizes[f];
+        if (fleet > maxFleet)
+            break;
+        if (fleet > MAX_VEHICLES)
+        {
+            printf("(fleet %ld skipped: rebuild with -DMAX_VEHICLES=%ld)\n", fleet, fleet);
+            continue;
+        }
+
+        benchSetupFleet(fleet, 0);
+        benchRun("findVehicleById", fleet, benchFindVehicle);
+        benchRun("matchPlate exact", fleet, benchMatchPlateExact);
+        benchRun("matchPlate 1 edit", fleet, benchMatchPlateFuzzy);
+        benchRun("matchPlate 2 edits", fleet, benchMatchPlateTwoEdits);
+        benchRun("plate prefix, one page", fleet, benchSearchPlatePrefix);
+        benchRun("park/unpark round trip", fleet, benchRoundTrip);
+        while (feedSubscribe() != -1)
+            ;
+        benchRun("round trip, all displays", fleet, benchFeedRoundTrip);
+        for (int s = 0; s < MAX_FEED_SUBSCRIBERS; s++)
+            feedUnsubscribe(s);
+
+        benchSetupFleet(fleet, 1);
+        benchRun("saveVehicleData", fleet, benchSaveVehicles);
+
+        benchRemoveFile("vehicles/data.txt");
+        saveVehicleData();
+        benchRun("loadVehicleData", fleet, benchLoadVehicles);
+
+        benchSetupFleet(fleet, 1);
+        benchRun("generateReport", fleet, benchReport);
+    }
+
+    // Leave no stale data behind in the scratch folder
+    benchRemoveFile("vehicles/data.txt");
+    benchRemoveFile("reports/bench_report.txt");
+}
+
+// Hot-Path Metrics
+// Recording is a couple of counter increments; the text export happens at most
+// once every METRICS_DUMP_SECONDS from the gate handlers, and at logout/exit.
+
+void recordSave(int file, long written, long long startNanos)
+{
+    saveCount[file]++;
+    if (written > 0)
+        bytesWritten[file] += written;
+    recordOp(OP_SAVE, startNanos);
+}
+
+void recordOp(int op, long long startNanos)
+{
+    histogramRecord(&opLatency[op], monotonicNanos() - startNanos);
+}
+
+// Cumulative count of values up to 'bound' (bucket lower bounds, HDR precision)
+static unsigned long long histogramCountBelow(LatencyHistogram *hist, unsigned long long bound)
+{
+    unsigned long long count = 0;
+    for (int i = 0; i < HIST_BUCKETS; i++)
+    {
+        if (hist->counts[i] == 0)
+            continue;
+        if (histogramBucketValue(i) > bound)
+            break;
+        count += hist->counts[i];
+    }
+    return count;
+}
+
+static void writeProbeHistogram(FILE *fp, const char *index, LatencyHistogram *hist)
+{
+    for (unsigned long long le = 1; le <= 4096; le *= 4)
+    {
+        fprintf(fp, "parking_lookup_probes_bucket{index=\"%s\",le=\"%llu\"} %llu\n",
+                index, le, histogramCountBelow(hist, le));
+    }
+    fprintf(fp, "parking_lookup_probes_bucket{index=\"%s\",le=\"+Inf\"} %llu\n", index, hist->total);
+    fprintf(fp, "parking_lookup_probes_sum{index=\"%s\"} %llu\n", index, hist->sum);
+    fprintf(fp, "parking_lookup_probes_count{index=\"%s\"} %llu\n", index, hist->total);
+}
+
+void writeMetrics(FILE *fp)
+{
+    static const unsigned long long latencyBounds[] = {
+        1000, 5000, 10000, 50000, 100000, 500000, 1000000, 5000000, 10000000, 50000000, 100000000, 1000000000};
+    static const double quantiles[] = {0.5, 0.9, 0.99, 0.999};
+
+    fprintf(fp, "# HELP parking_op_latency_seconds Latency of gate operations and their phases.\n");
+    fprintf(fp, "# TYPE parking_op_latency_seconds histogram\n");
+    for (int op = 0; op < NUM_OPS; op++)
+    {
+        LatencyHistogram *hist = &opLatency[op];
+        for (int b = 0; b < (int)(sizeof(latencyBounds) / sizeof(latencyBounds[0])); b++)
+        {
+            fprintf(fp, "parking_op_latency_seconds_bucket{op=\"%s\",le=\"%g\"} %llu\n",
+                    opNames[op], latencyBounds[b] / 1e9, histogramCountBelow(hist, latencyBounds[b]));
+        }
+        fprintf(fp, "parking_op_latency_seconds_bucket{op=\"%s\",le=\"+Inf\"} %llu\n", opNames[op], hist->total);
+        fprintf(fp, "parking_op_latency_seconds_sum{op=\"%s\"} %.9f\n", opNames[op], hist->sum / 1e9);
+        fprintf(fp, "parking_op_latency_seconds_count{op=\"%s\"} %llu\n", opNames[op], hist->total);
+    }
+
+    fprintf(fp, "# HELP parking_op_latency_quantile_seconds Latency quantiles at full histogram precision.\n");
+    fprintf(fp, "# TYPE parking_op_latency_quantile_seconds gauge\n");
+    for (int op = 0; op < NUM_OPS; op++)
+    {
+        for (int q = 0; q < (int)(sizeof(quantiles) / sizeof(quantiles[0])); q++)
+        {
+            fprintf(fp, "parking_op_latency_quantile_seconds{op=\"%s\",quantile=\"%g\"} %.9f\n",
+                    opNames[op], quantiles[q], histogramPercentile(&opLatency[op], quantiles[q] * 100.0) / 1e9);
+        }
+    }
+
+    fprintf(fp, "# HELP parking_saves_total Data file saves.\n");
+    fprintf(fp, "# TYPE parking_saves_total counter\n");
+    for (int f = 0; f < NUM_SAVE_FILES; f++)
+        fprintf(fp, "parking_saves_total{file=\"%s\"} %llu\n", saveFileNames[f], saveCount[f]);
+
+    fprintf(fp, "# HELP parking_bytes_written_total Bytes written to data files.\n");
+    fprintf(fp, "# TYPE parking_bytes_written_total counter\n");
+    for (int f = 0; f < NUM_SAVE_FILES; f++)
+        fprintf(fp, "parking_bytes_written_total{file=\"%s\"} %llu\n", saveFileNames[f], bytesWritten[f]);
+
+    fprintf(fp, "# HELP parking_lookup_probes Entries examined per lookup.\n");
+    fprintf(fp, "# TYPE parking_lookup_probes histogram\n");
+    writeProbeHistogram(fp, "vehicle_id", &vehicleLookupProbes);
+    writeProbeHistogram(fp, "pass", &passLookupProbes);
+    writeProbeHistogram(fp, "plate", &plateLookupProbes);
+
+    fprintf(fp, "# HELP parking_plate_reads_total Camera plate reads by outcome.\n");
+    fprintf(fp, "# TYPE parking_plate_reads_total counter\n");
+    for (int r = 0; r < NUM_PLATE_RESULTS; r++)
+        fprintf(fp, "parking_plate_reads_total{result=\"%s\"} %llu\n", plateResultNames[r], plateReadCount[r]);
+
+    fprintf(fp, "# HELP parking_alerts_total Overstay and pass expiry alerts fired by the timer wheel.\n");
+    fprintf(fp, "# TYPE parking_alerts_total counter\n");
+    for (int k = 0; k < NUM_ALERT_KINDS; k++)
+        fprintf(fp, "parking_alerts_total{kind=\"%s\"} %llu\n", alertKindNames[k], alertCount[k]);
+    fprintf(fp, "# HELP parking_alerts_dropped_total Alerts the sink could not deliver.\n");
+    fprintf(fp, "# TYPE parking_alerts_dropped_total counter\n");
+    fprintf(fp, "parking_alerts_dropped_total %llu\n", alertsDropped);
+    fprintf(fp, "# HELP parking_timers_armed Pending overstay and pass expiry timers.\n");
+    fprintf(fp, "# TYPE parking_timers_armed gauge\n");
+    fprintf(fp, "parking_timers_armed %d\n", numTimersArmed);
+    fprintf(fp, "# HELP parking_snapshot_retries_total Snapshot copies retried because the lot changed underneath.\n");
+    fprintf(fp, "# TYPE parking_snapshot_retries_total counter\n");
+    fprintf(fp, "parking_snapshot_retries_total %llu\n", snapshotRetries);
+    fprintf(fp, "# HELP parking_journal_events_total Gate events appended to the event journal.\n");
+    fprintf(fp, "# TYPE parking_journal_events_total counter\n");
+    fprintf(fp, "parking_journal_events_total %llu\n", journalEvents);
+    fprintf(fp, "# HELP parking_journal_dropped_total Gate events lost because the journal queue was full.\n");
+    fprintf(fp, "# TYPE parking_journal_dropped_total counter\n");
+    fprintf(fp, "parking_journal_dropped_total %llu\n", journalDropped);
+    fprintf(fp, "# HELP parking_history_blocks Compressed per-minute occupancy blocks held in memory.\n");
+    fprintf(fp, "# TYPE parking_history_blocks gauge\n");
+    fprintf(fp, "parking_history_blocks %d\n", numSeriesBlocks);
+    fprintf(fp, "# HELP parking_history_bytes Size of the occupancy history (headers and packed deltas).\n");
+    fprintf(fp, "# TYPE parking_history_bytes gauge\n");
+    fprintf(fp, "parking_history_bytes %zu\n", numSeriesBlocks * sizeof(SeriesBlock) + seriesDataUsed);
+    fprintf(fp, "# HELP parking_history_blocks_read_total Blocks read by history queries.\n");
+    fprintf(fp, "# TYPE parking_history_blocks_read_total counter\n");
+    fprintf(fp, "parking_history_blocks_read_total{how=\"header\"} %llu\n", seriesBlocksSummarized);
+    fprintf(fp, "parking_history_blocks_read_total{how=\"decoded\"} %llu\n", seriesBlocksDecoded);
+    fprintf(fp, "# HELP parking_history_dropped_total Minutes not recorded because the history store was full.\n");
+    fprintf(fp, "# TYPE parking_history_dropped_total counter\n");
+    fprintf(fp, "parking_history_dropped_total %llu\n", seriesDropped);
+    fprintf(fp, "# HELP parking_io_backend How data files are written (sync, thread or uring).\n");
+    fprintf(fp, "# TYPE parking_io_backend gauge\n");
+    fprintf(fp, "parking_io_backend{backend=\"%s\"} 1\n", ioBackendNames[ioBackend]);
+    fprintf(fp, "# HELP parking_io_chunks_total Chunks handed to the asynchronous I/O backend.\n");
+    fprintf(fp, "# TYPE parking_io_chunks_total counter\n");
+    fprintf(fp, "parking_io_chunks_total %llu\n", ioChunks);
+    fprintf(fp, "# HELP parking_io_syncs_total Chunks written with a data sync (event journal commits).\n");
+    fprintf(fp, "# TYPE parking_io_syncs_total counter\n");
+    fprintf(fp, "parking_io_syncs_total %llu\n", ioSyncs);
+    fprintf(fp, "# HELP parking_io_stalls_total Waits for an earlier chunk before a writer could go on.\n");
+    fprintf(fp, "# TYPE parking_io_stalls_total counter\n");
+    fprintf(fp, "parking_io_stalls_total %llu\n", ioStalls);
+
+    Arena *arena = threadArena();
+    fprintf(fp, "# HELP parking_arena_peak_bytes Largest arena footprint of a request, save or report.\n");
+    fprintf(fp, "# TYPE parking_arena_peak_bytes gauge\n");
+    fprintf(fp, "parking_arena_peak_bytes %zu\n", arena->peakBytes);
+    fprintf(fp, "# HELP parking_arena_block_allocs_total Heap blocks taken by the arena (flat once warm).\n");
+    fprintf(fp, "# TYPE parking_arena_block_allocs_total counter\n");
+    fprintf(fp, "parking_arena_block_allocs_total %llu\n", arena->blockAllocs);
+    fprintf(fp, "# HELP parking_heap_allocs_total Heap allocations made by the program (heapAlloc).\n");
+    fprintf(fp, "# TYPE parking_heap_allocs_total counter\n");
+    fprintf(fp, "parking_heap_allocs_total %llu\n", (unsigned long long)heapAllocCount);
+    fprintf(fp, "# HELP parking_feed_events_total Spot changes offered to dashboard subscribers.\n");
+    fprintf(fp, "# TYPE parking_feed_events_total counter\n");
+    fprintf(fp, "parking_feed_events_total{result=\"published\"} %llu\n", feedPublished);
+    fprintf(fp, "parking_feed_events_total{result=\"coalesced\"} %llu\n", feedCoalesced);
+    fprintf(fp, "parking_feed_events_total{result=\"overflow\"} %llu\n", feedOverflows);
+    fprintf(fp, "# HELP parking_feed_subscribers Dashboards following the change feed.\n");
+    fprintf(fp, "# TYPE parking_feed_subscribers gauge\n");
+    fprintf(fp, "parking_feed_subscribers %d\n", numFeedSubscribers);
+
+    fprintf(fp, "# HELP parking_waitlist_depth Vehicles waiting at the entry gate.\n");
+    fprintf(fp, "# TYPE parking_waitlist_depth gauge\n");
+    for (int c = 0; c < NUM_WAIT_CLASSES; c++)
+        fprintf(fp, "parking_waitlist_depth{class=\"%s\"} %d\n", waitClassNames[c], waitDepth[c]);
+    fprintf(fp, "# HELP parking_waitlist_expected_wait_seconds Expected wait of a vehicle joining the class now.\n");
+    fprintf(fp, "# TYPE parking_waitlist_expected_wait_seconds gauge\n");
+    for (int c = 0, ahead = 0; c < NUM_WAIT_CLASSES; c++)
+    {
+        ahead += waitDepth[c];
+        long expected = waitlistExpectedWait(ahead + 1);
+        if (expected < 0)
+            fprintf(fp, "parking_waitlist_expected_wait_seconds{class=\"%s\"} NaN\n", waitClassNames[c]);
+        else
+            fprintf(fp, "parking_waitlist_expected_wait_seconds{class=\"%s\"} %ld\n", waitClassNames[c], expected);
+    }
+    fprintf(fp, "# HELP parking_waitlist_queued_total Vehicles that joined the waitlist.\n");
+    fprintf(fp, "# TYPE parking_waitlist_queued_total counter\n");
+    for (int c = 0; c < NUM_WAIT_CLASSES; c++)
+        fprintf(fp, "parking_waitlist_queued_total{class=\"%s\"} %llu\n", waitClassNames[c], waitQueued[c]);
+    fprintf(fp, "# HELP parking_waitlist_admitted_total Waiting vehicles that got a spot.\n");
+    fprintf(fp, "# TYPE parking_waitlist_admitted_total counter\n");
+    for (int c = 0; c < NUM_WAIT_CLASSES; c++)
+        fprintf(fp, "parking_waitlist_admitted_total{class=\"%s\"} %llu\n", waitClassNames[c], waitAdmitted[c]);
+    fprintf(fp, "# HELP parking_waitlist_wait_seconds_total Time admitted vehicles spent waiting.\n");
+    fprintf(fp, "# TYPE parking_waitlist_wait_seconds_total counter\n");
+    for (int c = 0; c < NUM_WAIT_CLASSES; c++)
+        fprintf(fp, "parking_waitlist_wait_seconds_total{class=\"%s\"} %llu\n", waitClassNames[c], waitSeconds[c]);
+    fprintf(fp, "# HELP parking_waitlist_left_total Waiting vehicles that left without a spot.\n");
+    fprintf(fp, "# TYPE parking_waitlist_left_total counter\n");
+    for (int c = 0; c < NUM_WAIT_CLASSES; c++)
+        fprintf(fp, "parking_waitlist_left_total{class=\"%s\"} %llu\n", waitClassNames[c], waitLeft[c]);
+    fprintf(fp, "# HELP parking_waitlist_refused_total Vehicles turned away with the waitlist full.\n");
+    fprintf(fp, "# TYPE parking_waitlist_refused_total counter\n");
+    fprintf(fp, "parking_waitlist_refused_total %llu\n", waitRefused);
+
+    int occupied = occupiedCount;
+    fprintf(fp, "# HELP parking_spots_occupied Occupied spots at export time.\n");
+    fprintf(fp, "# TYPE parking_spots_occupied gauge\n");
+    fprintf(fp, "parking_spots_occupied %d\n", occupied);
+    fprintf(fp, "# HELP parking_spots_total Spots in the lot.\n");
+    fprintf(fp, "# TYPE parking_spots_total gauge\n");
+    fprintf(fp, "parking_spots_total %d\n", MAX_PARKING_SPOTS);
+    fprintf(fp, "# HELP parking_entry_rate_per_hour Hourly rate a car entering now would lock in.\n");
+    fprintf(fp, "# TYPE parking_entry_rate_per_hour gauge\n");
+    fprintf(fp, "parking_entry_rate_per_hour %.2f\n", entryRatePerHour(clockNow(), occupiedCount));
+
+    static const int horizons[] = {15, 30, 60};
+    time_t now = clockNow();
+    fprintf(fp, "# HELP parking_forecast_free_spots Expected free spots after the given number of minutes.\n");
+    fprintf(fp, "# TYPE parking_forecast_free_spots gauge\n");
+    for (int h = 0; h < (int)(sizeof(horizons) / sizeof(horizons[0])); h++)
+        fprintf(fp, "parking_forecast_free_spots{minutes=\"%d\"} %.1f\n", horizons[h],
+                forecastFreeSpots(now, horizons[h], occupied));
+}
+
+// Written to a temporary file and renamed, so scrapers never read half a dump
+void dumpMetrics()
+{
+    char path[300], tempPath[300];
+    buildDataPath(path, sizeof(path), "metrics/metrics.prom");
+    buildDataPath(tempPath, sizeof(tempPath), "metrics/metrics.prom.tmp");
+
+    FILE *fp = fopen(tempPath, "w");
+    if (fp == NULL)
+        return;
+    writeMetrics(fp);
+    fclose(fp);
+#ifdef _WIN32
+    remove(path);
+#endif
+    rename(tempPath, path);
+    lastMetricsDump = clockNow();
+}
+
+void maybeDumpMetrics()
+{
+    if (clockNow() - lastMetricsDump >= METRICS_DUMP_SECONDS)
+        dumpMetrics();
+}
+
+// Password Hashing (PBKDF2-HMAC-SHA256) and Session Cache
+typedef struct
+{
+    unsigned int state[8];
+    unsigned char block[64];
+    unsigned long long length;
+    int used;
+} Sha256;
+
+static const unsigned int sha256K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+#define ROTR32(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static void sha256Compress(unsigned int *state, const unsigned char *block)
+{
+    unsigned int w[64];
+    for (int i = 0; i < 16; i++)
+    {
+        w[i] = (unsigned int)block[i * 4] << 24 | (unsigned int)block[i * 4 + 1] << 16 |
+               (unsigned int)block[i * 4 + 2] << 8 | block[i * 4 + 3];
+    }
+    for (int i = 16; i < 64; i++)
+    {
+        unsigned int s0 = ROTR32(w[i - 15], 7) ^ ROTR32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        unsigned int s1 = ROTR32(w[i - 2], 17) ^ ROTR32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    unsigned int a = state[0], b = state[1], c = state[2], d = state[3];
+    unsigned int e = state[4], f = state[5], g = state[6], h = state[7];
+    for (int i = 0; i < 64; i++)
+    {
+        unsigned int t1 = h + (ROTR32(e, 6) ^ ROTR32(e, 11) ^ ROTR32(e, 25)) + ((e & f) ^ (~e & g)) + sha256K[i] + w[i];
+        unsigned int t2 = (ROTR32(a, 2) ^ ROTR32(a, 13) ^ ROTR32(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+    state[5] += f;
+    state[6] += g;
+    state[7] += h;
+}
+
+static void sha256Init(Sha256 *ctx)
+{
+    static const unsigned int initial[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+    memcpy(ctx->state, initial, sizeof(initial));
+    ctx->length = 0;
+    ctx->used = 0;
+}
+
+static void sha256Update(Sha256 *ctx, const unsigned char *data, int length)
+{
+    for (int i = 0; i < length; i++)
+    {
+        ctx->block[ctx->used++] = data[i];
+        if (ctx->used == 64)
+        {
+            sha256Compress(ctx->state, ctx->block);
+            ctx->used = 0;
+        }
+    }
+    ctx->length += length;
+}
+
+static void sha256Final(Sha256 *ctx, unsigned char *digest)
+{
+    unsigned long long bits = ctx->length * 8;
+    unsigned char pad = 0x80;
+    sha256Update(ctx, &pad, 1);
+    pad = 0;
+    while (ctx->used != 56)
+        sha256Update(ctx, &pad, 1);
+    unsigned char lengthBytes[8];
+    for (int i = 0; i < 8; i++)
+        lengthBytes[i] = (unsigned char)(bits >> (56 - 8 * i));
+    sha256Update(ctx, lengthBytes, 8);
+    for (int i = 0; i < 8; i++)
+    {
+        digest[i * 4] = (unsigned char)(ctx->state[i] >> 24);
+        digest[i * 4 + 1] = (unsigned char)(ctx->state[i] >> 16);
+        digest[i * 4 + 2] = (unsigned char)(ctx->state[i] >> 8);
+        digest[i * 4 + 3] = (unsigned char)ctx->state[i];
+    }
+}
+
+// PBKDF2-HMAC-SHA256 with one 32-byte output block. The keyed inner and outer
+// states are computed once, so each iteration costs two compressions.
+static void pbkdf2Sha256(const char *password, const unsigned char *salt, int saltLength,
+                         int iterations, unsigned char *out)
+{
+    unsigned char key[64] = {0};
+    unsigned char pad[64];
+    int passwordLength = (int)strlen(password);
+    if (passwordLength > 64)
+    {
+        Sha256 keyCtx;
+        sha256Init(&keyCtx);
+        sha256Update(&keyCtx, (const unsigned char *)password, passwordLength);
+        sha256Final(&keyCtx, key);
+    }
+    else
+    {
+        memcpy(key, password, passwordLength);
+    }
+
+    Sha256 inner, outer;
+    for (int i = 0; i < 64; i++)
+        pad[i] = key[i] ^ 0x36;
+    sha256Init(&inner);
+    sha256Update(&inner, pad, 64);
+    for (int i = 0; i < 64; i++)
+        pad[i] = key[i] ^ 0x5c;
+    sha256Init(&outer);
+    sha256Update(&outer, pad, 64);
+
+    // U1 = HMAC(password, salt || INT(1))
+    unsigned char blockIndex[4] = {0, 0, 0, 1};
+    unsigned char u[32];
+    Sha256 ctx = inner;
+    sha256Update(&ctx, salt, saltLength);
+    sha256Update(&ctx, blockIndex, 4);
+    sha256Final(&ctx, u);
+    ctx = outer;
+    sha256Update(&ctx, u, 32);
+    sha256Final(&ctx, u);
+    memcpy(out, u, 32);
+
+    for (int n = 1; n < iterations; n++)
+    {
+        ctx = inner;
+        sha256Update(&ctx, u, 32);
+        sha256Final(&ctx, u);
+        ctx = outer;
+        sha256Update(&ctx, u, 32);
+        sha256Final(&ctx, u);
+        for (int i = 0; i < 32; i++)
+            out[i] ^= u[i];
+    }
+    memset(key, 0, sizeof(key));
+    memset(pad, 0, sizeof(pad));
+}
+
+static void toHex(const unsigned char *bytes, int length, char *out)
+{
+    static const char digits[] = "0123456789abcdef";
+    for (int i = 0; i < length; i++)
+    {
+        out[i * 2] = digits[bytes[i] >> 4];
+        out[i * 2 + 1] = digits[bytes[i] & 15];
+    }
+    out[length * 2] = 0;
+}
+
+static int fromHex(const char *text, unsigned char *out, int maxLength)
+{
+    int length = 0;
+    while (text[0] && text[1] && text[0] != '$' && length < maxLength)
+    {
+        unsigned int byte;
+        if (sscanf(text, "%2x", &byte) != 1)
+            return -1;
+        out[length++] = (unsigned char)byte;
+        text += 2;
+    }
+    return length;
+}
+
+// OS randomness; falls back to a time-seeded stream where /dev/urandom is missing
+void secureRandomBytes(unsigned char *out, int length)
+{
+    FILE *fp = fopen("/dev/urandom", "rb");
+    if (fp != NULL)
+    {
+        int got = (int)fread(out, 1, length, fp);
+        fclose(fp);
+        if (got == length)
+            return;
+    }
+    static unsigned long long state = 0;
+    if (state == 0)
+        state = (unsigned long long)time(NULL) ^ (unsigned long long)monotonicNanos();
+    for (int i = 0; i < length; i++)
+        out[i] = (unsigned char)randomNext(&state);
+}
+
+void hashPassword(const char *password, char *out)
+{
+    unsigned char salt[PASSWORD_SALT_LEN];
+    unsigned char hash[32];
+    char saltHex[PASSWORD_SALT_LEN * 2 + 1];
+    char hashHex[65];
+
+    secureRandomBytes(salt, PASSWORD_SALT_LEN);
+    pbkdf2Sha256(password, salt, PASSWORD_SALT_LEN, PBKDF2_ITERATIONS, hash);
+    toHex(salt, PASSWORD_SALT_LEN, saltHex);
+    toHex(hash, 32, hashHex);
+    snprintf(out, PASSWORD_HASH_LEN, "pbkdf2$%d$%s$%s", PBKDF2_ITERATIONS, saltHex, hashHex);
+}
+
+// Re-derives the hash with the stored salt and iterations, compares in constant time
+int verifyPassword(const char *password, const char *stored)
+{
+    int iterations;
+    if (sscanf(stored, "pbkdf2$%d$", &iterations) != 1 || iterations < 1)
+        return 0;
+    const char *saltText = strchr(stored + 7, '$');
+    if (saltText == NULL)
+        return 0;
+    saltText++;
+    const char *hashText = strchr(saltText, '$');
+    if (hashText == NULL)
+        return 0;
+    hashText++;
+
+    unsigned char salt[64], expected[32], actual[32];
+    int saltLength = fromHex(saltText, salt, sizeof(salt));
+    if (saltLength <= 0 || fromHex(hashText, expected, 32) != 32)
+        return 0;
+
+    pbkdf2Sha256(password, salt, saltLength, iterations, actual);
+    unsigned char diff = 0;
+    for (int i = 0; i < 32; i++)
+        diff |= actual[i] ^ expected[i];
+    return diff == 0;
+}
+
+// Issues a fresh random token; the oldest-expiring slot is reused when the cache is full
+int createSession(int adminIndex, time_t now, char *tokenOut)
+{
+    int slot = -1;
+    for (int i = 0; i < MAX_SESSIONS; i++)
+    {
+        if (sessions[i].adminIndex == -1 || sessions[i].expiresAt <= now)
+        {
+            slot = i;
+            break;
+        }
+        if (slot == -1 || sessions[i].expiresAt < sessions[slot].expiresAt)
+            slot = i;
+    }
+    if (sessions[slot].adminIndex != -1)
+        revokeSession(sessions[slot].token);
+
+    unsigned char random[16];
+    secureRandomBytes(random, sizeof(random));
+    toHex(random, sizeof(random), sessions[slot].token);
+    sessions[slot].adminIndex = adminIndex;
+    sessions[slot].expiresAt = now + SESSION_TTL_SECONDS;
+
+    char key[17];
+    memcpy(key, sessions[slot].token, 16);
+    key[16] = 0;
+    indexInsert(sessionIndex, SESSION_INDEX_SIZE, key, slot);
+    strcpy(tokenOut, sessions[slot].token);
+    return slot;
+}
+
+// O(1) check for each request: index probe, full-token compare, sliding expiry.
+// Returns the admin index, or -1 when the token is unknown or expired.
+int authorizeSession(const char *token, time_t now)
+{
+    if (strlen(token) != SESSION_TOKEN_LEN - 1)
+        return -1;
+    char key[17];
+    memcpy(key, token, 16);
+    key[16] = 0;
+
+    int slot = indexFind(sessionIndex, SESSION_INDEX_SIZE, key);
+    if (slot == -1)
+        return -1;
+
+    unsigned char diff = 0;
+    for (int i = 0; i < SESSION_TOKEN_LEN - 1; i++)
+        diff |= (unsigned char)(sessions[slot].token[i] ^ token[i]);
+    if (diff != 0)
+        return -1;
+
+    if (sessions[slot].expiresAt <= now)
+    {
+        revokeSession(token);
+        return -1;
+    }
+    sessions[slot].expiresAt = now + SESSION_TTL_SECONDS;
+    return sessions[slot].adminIndex;
+}
+
+void revokeSession(const char *token)
+{
+    if (strlen(token) != SESSION_TOKEN_LEN - 1)
+        return;
+    char key[17];
+    memcpy(key, token, 16);
+    key[16] = 0;
+
+    int slot = indexFind(sessionIndex, SESSION_INDEX_SIZE, key);
+    if (slot != -1 && strcmp(sessions[slot].token, token) == 0)
+    {
+        indexRemove(sessionIndex, SESSION_INDEX_SIZE, key);
+        sessions[slot].adminIndex = -1;
+        sessions[slot].token[0] = 0;
+    }
+}
+
+// Utility functions (For Validations)
+// Every validator is a single pass over its input with a table lookup for
+// character classes; none of them calls sscanf or strstr, and only the e-mail
+// check measures its input, once, to bound the search for the domain.
+
+// Character classes: bytes outside ASCII have no class
+static const unsigned char charClass[256] = {
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // 0x00
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // 0x10
+    0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // 0x20
+    0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // 0x30
+    0x00, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, // 0x40
+    0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, // 0x50
+    0x00, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, // 0x60
+    0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, // 0x70
+};
+
+// Validate Name: 2 to 20 letters or spaces
+int isValidName(const char *name)
+{
+    int length = 0;
+    for (; name[length] != 0; length++)
+    {
+        if (length >= 20 || !(charClass[(unsigned char)name[length]] & (CH_UPPER | CH_LOWER | CH_SPACE)))
+        {
+            return 0; // Too long, or not a letter or space
+        }
+    }
+    return length >= 2;
+}
+
+// Validate Email: 5 to 20 characters containing "@gmail.com"
+int isValidEmail(const char *email)
+{
+    size_t length = strlen(email);
+    if (length > 20 || length < 10)
+    {
+        return 0; // Invalid length; "@gmail.com" alone is 10 characters
+    }
+    // Only an '@' with 9 characters after it can start the domain
+    const char *end = email + length - 9;
+    for (const char *at = email; (at = memchr(at, '@', end - at)) != NULL; at++)
+    {
+        if (memcmp(at + 1, "gmail.com", 9) == 0)
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Validate Phone Number: exactly 11 digits
+int isValidPhoneNumber(const char *phone)
+{
+    for (int i = 0; i < 11; i++)
+    {
+        if (!(charClass[(unsigned char)phone[i]] & CH_DIGIT))
+        {
+            return 0; // Too short, or a non-digit character
+        }
+    }
+    return phone[11] == 0;
+}
+
+// Validate Password: at least 8 characters (only the first 8 are looked at)
+int isValidPassword(const char *password)
+{
+    for (int i = 0; i < 8; i++)
+    {
+        if (password[i] == 0)
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Validate License Plate: 1 to 3 uppercase letters, a dash and a number
+// (as in ABC-1234), or any 8 characters
+int isValidLicensePlate(const char *plate)
+{
+    const unsigned char *p = (const unsigned char *)plate;
+    int i = 0;
+    while (i < 3 && (charClass[p[i]] & CH_UPPER))
+        i++;
+    if (i > 0 && p[i] == '-')
+    {
+        // The number may follow blanks and a sign, like a scanf "%d"
+        i++;
+        while (p[i] == ' ' || (p[i] >= '\t' && p[i] <= '\r'))
+            i++;
+        if (p[i] == '+' || p[i] == '-')
+            i++;
+        if (charClass[p[i]] & CH_DIGIT)
+        {
+            return 1;
+        }
+    }
+    for (i = 0; i < 8; i++)
+    {
+        if (p[i] == 0)
+        {
+            return 0;
+        }
+    }
+    return p[8] == 0;
+}
+
+// Validate Vehicle Type: 1 to 19 letters, digits or spaces
+int isValidVehicleType(const char *type)
+{
+    int length = 0;
+    for (; type[length] != 0; length++)
+    {
+        if (length >= VEHICLE_TYPE_LEN - 1 ||
+            !(charClass[(unsigned char)type[length]] & (CH_UPPER | CH_LOWER | CH_DIGIT | CH_SPACE)))
+        {
+            return 0;
+        }
+    }
+    return length >= 1;
+}
+
+// Validate Vehicle ID: 1 to 19 letters or digits, so it is safe in the data files
+int isValidVehicleId(const char *vehicleId)
+{
+    int length = 0;
+    for (; vehicleId[length] != 0; length++)
+    {
+        if (length >= VEHICLE_ID_LEN - 1 ||
+            !(charClass[(unsigned char)vehicleId[length]] & (CH_UPPER | CH_LOWER | CH_DIGIT)))
+        {
+            return 0;
+        }
+    }
+    return length >= 1;
+}
+
+// Checks every present field of a record and reports all failures as INVALID_* bits
+unsigned int validateRecord(const ValidationRecord *record)
+{
+    unsigned int errors = 0;
+    if (record->name != NULL && !isValidName(record->name))
+        errors |= INVALID_NAME;
+    if (record->phone != NULL && !isValidPhoneNumber(record->phone))
+        errors |= INVALID_PHONE;
+    if (record->email != NULL && !isValidEmail(record->email))
+        errors |= INVALID_EMAIL;
+    if (record->password != NULL && !isValidPassword(record->password))
+        errors |= INVALID_PASSWORD;
+    if (record->plate != NULL && !isValidLicensePlate(record->plate))
+        errors |= INVALID_PLATE;
+    if (record->vehicleType != NULL && !isValidVehicleType(record->vehicleType))
+        errors |= INVALID_TYPE;
+    return errors;
+}
+
+// Bulk validation: errors[i] receives the bits of records[i]. Returns the number of invalid records.
+int validateRecords(const ValidationRecord *records, int count, unsigned int *errors)
+{
+    int invalid = 0;
+    for (int i = 0; i < count; i++)
+    {
+        errors[i] = validateRecord(&records[i]);
+        invalid += errors[i] != 0;
+    }
+    return invalid;
+}
+
+// "name, phone" style list of the failing fields
+void describeValidationErrors(unsigned int errors, char *out, int size)
+{
+    static const char *fieldNames[] = {"name", "phone", "email", "password", "plate", "vehicle type"};
+    int used = 0;
+    out[0] = 0;
+    for (int bit = 0; bit < (int)(sizeof(fieldNames) / sizeof(fieldNames[0])); bit++)
+    {
+        if (!(errors & (1u << bit)))
+            continue;
+        int n = snprintf(out + used, size - used, "%s%s", used ? ", " : "", fieldNames[bit]);
+        if (n < 0 || n >= size - used)
+            break;
+        used += n;
+    }
+}
+
+// Arena Allocator and Data File Writer
+// Transient buffers come from a per-thread bump allocator: an allocation is a
+// pointer bump, and a whole scope (one request, one save, one report) is freed
+// by rewinding to a mark. Blocks stay attached to the arena after a rewind, so
+// once a scope has reached its peak size it never calls malloc again.
+
+Arena *threadArena()
+{
+    static THREAD_LOCAL Arena arena;
+    return &arena;
+}
+
+void *arenaAlloc(Arena *arena, size_t size)
+{
+    size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    ArenaBlock *block = arena->current;
+    while (block != NULL && block->size - block->used < size)
+    {
+        // Later blocks are empty after a rewind; take the first that fits
+        block = block->next;
+        if (block != NULL)
+            block->used = 0;
+    }
+    if (block == NULL)
+    {
+        size_t blockSize = size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE;
+        block = heapAlloc(sizeof(ArenaBlock) + blockSize);
+        if (block == NULL)
+            return NULL;
+        block->size = blockSize;
+        block->used = 0;
+        block->next = NULL;
+        arena->blockAllocs++;
+        // Append at the end so the chain order (and every mark) stays valid
+        if (arena->first == NULL)
+        {
+            arena->first = block;
+        }
+        else
+        {
+            ArenaBlock *last = arena->current != NULL ? arena->current : arena->first;
+            while (last->next != NULL)
+                last = last->next;
+            last->next = block;
+        }
+    }
+    arena->current = block;
+
+    void *p = block->data + block->used;
+    block->used += size;
+    arena->bytesInUse += size;
+    if (arena->bytesInUse > arena->peakBytes)
+        arena->peakBytes = arena->bytesInUse;
+    return p;
+}
+
+ArenaMark arenaMark(Arena *arena)
+{
+    ArenaMark mark = {arena->current, arena->current != NULL ? arena->current->used : 0, arena->bytesInUse};
+    return mark;
+}
+
+// Frees everything allocated since the mark
+void arenaRewind(Arena *arena, ArenaMark mark)
+{
+    if (mark.block == NULL)
+    {
+        arenaReset(arena);
+        return;
+    }
+    mark.block->used = mark.used;
+    arena->current = mark.block;
+    arena->bytesInUse = mark.bytesInUse;
+}
+
+void arenaReset(Arena *arena)
+{
+    arena->current = arena->first;
+    if (arena->first != NULL)
+        arena->first->used = 0;
+    arena->bytesInUse = 0;
+    arena->resets++;
+}
+
+// Opens a data file for writing through a buffer taken from the thread's arena.
+// Everything the writer allocated is released again by dataWriterClose.
+int dataWriterOpen(DataWriter *writer, const char *relative, int append)
+{
+    memset(writer, 0, sizeof(DataWriter));
+    char path[300];
+    buildDataPath(path, sizeof(path), relative);
+#ifdef _WIN32
+    writer->fp = fopen(path, append ? "ab" : "wb");
+    if (writer->fp == NULL)
+        return 0;
+#else
+    writer->fd = open(path, O_WRONLY | O_CREAT | (append ? O_APPEND : O_TRUNC), 0666);
+    if (writer->fd < 0)
+        return 0;
+#endif
+    writer->append = append;
+    writer->arena = threadArena();
+    writer->mark = arenaMark(writer->arena);
+    writer->capacity = WRITER_BUFFER_SIZE;
+    writer->slot = -1;
+#ifndef _WIN32
+    if (ioBackend != IO_BACKEND_SYNC && (writer->slot = ioSlotAcquire(writer)) != -1)
+    {
+        writer->buffer = ioSlots[writer->slot].data;
+        return 1;
+    }
+#endif
+    writer->buffer = arenaAlloc(writer->arena, writer->capacity);
+    if (writer->buffer == NULL)
+        writer->capacity = 0; // Every record is then written on its own
+    return 1;
+}
+
+static void dataWriterWrite(DataWriter *writer, const char *data, size_t size)
+{
+    if (writer->failed || size == 0)
+        return;
+#ifdef _WIN32
+    if (fwrite(data, 1, size, writer->fp) != size)
+        writer->failed = 1;
+#else
+    while (size > 0)
+    {
+        ssize_t n = write(writer->fd, data, size);
+        if (n <= 0)
+        {
+            writer->failed = 1;
+            return;
+        }
+        data += n;
+        size -= (size_t)n;
+    }
+#endif
+}
+
+static void dataWriterFlush(DataWriter *writer)
+{
+#ifndef _WIN32
+    if (writer->slot != -1)
+    {
+        // Fill the next chunk while this one is written; the previous one must land first
+        if (writer->length == 0)
+            return;
+        ioWaitWriter(writer);
+        ioSubmit(writer, 0);
+        writer->written += (long)writer->length;
+        writer->length = 0;
+        writer->slot = ioSlotAcquire(writer);
+        writer->buffer = ioSlots[writer->slot].data;
+        return;
+    }
+#endif
+    dataWriterWrite(writer, writer->buffer, writer->length);
+    writer->written += (long)writer->length;
+    writer->length = 0;
+}
+
+void dataWriterPrintf(DataWriter *writer, const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    size_t room = writer->capacity - writer->length;
+    int needed = vsnprintf(writer->buffer != NULL ? writer->buffer + writer->length : NULL, room, format, args);
+    va_end(args);
+    if (needed < 0)
+        return;
+    if ((size_t)needed < room)
+    {
+        writer->length += (size_t)needed;
+        return;
+    }
+
+    // Did not fit: flush and format again, into the buffer or a one-off arena block
+    dataWriterFlush(writer);
+    char *target = writer->buffer;
+    if ((size_t)needed >= writer->capacity)
+        target = arenaAlloc(writer->arena, (size_t)needed + 1);
+    if (target == NULL)
+    {
+        writer->failed = 1;
+        return;
+    }
+    va_start(args, format);
+    vsnprintf(target, (size_t)needed + 1, format, args);
+    va_end(args);
+    if (target == writer->buffer)
+    {
+        writer->length = (size_t)needed;
+    }
+#ifndef _WIN32
+    else if (writer->slot != -1)
+    {
+        // Oversized record: goes out through the chunk buffers, keeping chunk order
+        dataWriterBytes(writer, target, (size_t)needed);
+    }
+#endif
+    else
+    {
+        dataWriterWrite(writer, target, (size_t)needed);
+        writer->written += needed;
+    }
+}
+
+// Raw bytes (binary files), through the same buffer as formatted records
+void dataWriterBytes(DataWriter *writer, const void *data, size_t size)
+{
+    const char *bytes = data;
+    if (writer->capacity == 0)
+    {
+        dataWriterWrite(writer, bytes, size);
+        writer->written += (long)size;
+        return;
+    }
+    while (size > 0)
+    {
+        size_t room = writer->capacity - writer->length;
+        if (room > size)
+            room = size;
+        memcpy(writer->buffer + writer->length, bytes, room);
+        writer->length += room;
+        bytes += room;
+        size -= room;
+        if (writer->length == writer->capacity)
+            dataWriterFlush(writer);
+    }
+}
+
+// Flushes and closes; returns the bytes written, or -1 when a write failed
+long dataWriterClose(DataWriter *writer)
+{
+#ifdef _WIN32
+    dataWriterFlush(writer);
+    if (fclose(writer->fp) != 0)
+        writer->failed = 1;
+#else
+    if (writer->slot != -1)
+    {
+        // Last chunk, linked with the data sync for durable writers
+        ioWaitWriter(writer);
+        if (writer->length > 0 || writer->durable)
+        {
+            ioSubmit(writer, writer->durable);
+            writer->written += (long)writer->length;
+            ioWaitWriter(writer);
+        }
+        else
+        {
+            ioSlots[writer->slot].state = IO_SLOT_FREE;
+        }
+    }
+    else
+    {
+        dataWriterFlush(writer);
+        if (writer->durable && fsync(writer->fd) != 0)
+            writer->failed = 1;
+    }
+    if (close(writer->fd) != 0)
+        writer->failed = 1;
+#endif
+    arenaRewind(writer->arena, writer->mark);
+    return writer->failed ? -1 : writer->written;
+}
+
+// Persistence I/O Backends
+// With --io thread or --io uring, a data file writer formats into one of
+// IO_SLOTS shared chunk buffers and hands full chunks to the backend while it
+// fills the next one. A writer keeps at most one chunk in flight, so its
+// chunks land in order, and dataWriterClose waits for the last one. Durable
+// writers (the event journal) end with a data sync; with io_uring the final
+// write and the fsync go in as one linked submission. The io_uring backend
+// uses raw system calls and buffers registered once at startup, so there is
+// no library to install; if the kernel refuses it, the thread pool is used.
+#ifndef _WIN32
+
+static void ioComplete(IoSlot *slot, int ok)
+{
+    DataWriter *owner = slot->owner;
+    if (!ok)
+        owner->failed = 1;
+    owner->inFlight--;
+    slot->state = IO_SLOT_FREE;
+    slot->owner = NULL;
+}
+
+// Plain blocking write of a whole chunk, then the data sync if asked for
+static int ioWriteChunk(IoSlot *slot)
+{
+    const char *data = slot->data;
+    size_t size = slot->length;
+    long long offset = slot->offset;
+    while (size > 0)
+    {
+        ssize_t n = offset < 0 ? write(slot->fd, data, size) : pwrite(slot->fd, data, size, (off_t)offset);
+        if (n <= 0)
+            return 0;
+        data += n;
+        size -= (size_t)n;
+        if (offset >= 0)
+            offset += n;
+    }
+    return !slot->sync || fsync(slot->fd) == 0;
+}
+
+static void *ioWorker(void *unused)
+{
+    (void)unused;
+    pthread_mutex_lock(&ioLock);
+    while (1)
+    {
+        while (ioQueueHead == ioQueueTail)
+            pthread_cond_wait(&ioWork, &ioLock);
+        IoSlot *slot = &ioSlots[ioQueue[ioQueueHead++ % IO_SLOTS]];
+        pthread_mutex_unlock(&ioLock);
+
+        int ok = ioWriteChunk(slot);
+
+        pthread_mutex_lock(&ioLock);
+        slot->ok = ok;
+        slot->done = 1;
+        pthread_cond_broadcast(&ioDone);
+    }
+    return NULL;
+}
+
+static int ioThreadsStart()
+{
+    for (int t = 0; t < IO_THREADS; t++)
+    {
+        pthread_t worker;
+        if (pthread_create(&worker, NULL, ioWorker, NULL) != 0)
+            return t > 0;
+        pthread_detach(worker);
+    }
+    return 1;
+}
+
+#ifdef IO_URING_AVAILABLE
+static int ioUringSetup()
+{
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int fd = (int)syscall(__NR_io_uring_setup, IO_URING_ENTRIES, &params);
+    if (fd < 0)
+        return 0;
+
+    size_t sqSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    size_t cqSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    int singleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (singleMap && cqSize > sqSize)
+        sqSize = cqSize;
+    char *sq = mmap(NULL, sqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    char *cq = singleMap ? sq
+                         : mmap(NULL, cqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    struct io_uring_sqe *sqes = mmap(NULL, params.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE,
+                                     MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (sq == MAP_FAILED || cq == MAP_FAILED || sqes == MAP_FAILED)
+    {
+        close(fd); // Unmapped with the process; this only runs once
+        return 0;
+    }
+
+    // The chunk buffers are pinned once here and written with WRITE_FIXED
+    struct iovec buffers[IO_SLOTS];
+    for (int i = 0; i < IO_SLOTS; i++)
+    {
+        buffers[i].iov_base = ioSlots[i].data;
+        buffers[i].iov_len = WRITER_BUFFER_SIZE;
+    }
+    if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_BUFFERS, buffers, IO_SLOTS) < 0)
+    {
+        close(fd);
+        return 0;
+    }
+
+    ioRing.fd = fd;
+    ioRing.sqHead = (unsigned *)(sq + params.sq_off.head);
+    ioRing.sqTail = (unsigned *)(sq + params.sq_off.tail);
+    ioRing.sqMask = *(unsigned *)(sq + params.sq_off.ring_mask);
+    ioRing.sqArray = (unsigned *)(sq + params.sq_off.array);
+    ioRing.sqes = sqes;
+    ioRing.cqHead = (unsigned *)(cq + params.cq_off.head);
+    ioRing.cqTail = (unsigned *)(cq + params.cq_off.tail);
+    ioRing.cqMask = *(unsigned *)(cq + params.cq_off.ring_mask);
+    ioRing.cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+    return 1;
+}
+
+// Queues one SQE; the caller submits with io_uring_enter
+static struct io_uring_sqe *ioUringNextSqe()
+{
+    unsigned tail = *ioRing.sqTail;
+    unsigned index = tail & ioRing.sqMask;
+    struct io_uring_sqe *sqe = &ioRing.sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    ioRing.sqArray[index] = index;
+    __atomic_store_n(ioRing.sqTail, tail + 1, __ATOMIC_RELEASE);
+    return sqe;
+}
+
+static void ioUringSubmit(IoSlot *slot, int slotIndex)
+{
+    struct io_uring_sqe *sqe = ioUringNextSqe();
+    sqe->opcode = IORING_OP_WRITE_FIXED;
+    sqe->fd = slot->fd;
+    sqe->addr = (unsigned long)slot->data;
+    sqe->len = (unsigned)slot->length;
+    sqe->off = (unsigned long long)slot->offset; // -1: the file position, appended files always append
+    sqe->buf_index = (unsigned short)slotIndex;
+    sqe->user_data = (unsigned long long)slotIndex;
+    slot->pending = 1;
+    if (slot->sync)
+    {
+        // Runs only after the write completed in full; cancelled otherwise
+        sqe->flags = IOSQE_IO_LINK;
+        struct io_uring_sqe *syncSqe = ioUringNextSqe();
+        syncSqe->opcode = IORING_OP_FSYNC;
+        syncSqe->fd = slot->fd;
+        syncSqe->fsync_flags = IORING_FSYNC_DATASYNC;
+        syncSqe->user_data = (unsigned long long)(slotIndex + IO_SLOTS);
+        slot->pending = 2;
+    }
+    if (syscall(__NR_io_uring_enter, ioRing.fd, slot->pending, 0, 0, NULL, 0) < 0)
+    {
+        // Nothing was queued by the kernel; take the SQEs back and write in place
+        __atomic_store_n(ioRing.sqTail, *ioRing.sqTail - slot->pending, __ATOMIC_RELEASE);
+        ioComplete(slot, ioWriteChunk(slot));
+    }
+}
+
+static void ioUringReap(int wait)
+{
+    unsigned head = *ioRing.cqHead;
+    if (wait && head == __atomic_load_n(ioRing.cqTail, __ATOMIC_ACQUIRE))
+        syscall(__NR_io_uring_enter, ioRing.fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+    unsigned tail = __atomic_load_n(ioRing.cqTail, __ATOMIC_ACQUIRE);
+    for (; head != tail; head++)
+    {
+        struct io_uring_cqe *cqe = &ioRing.cqes[head & ioRing.cqMask];
+        int isSync = cqe->user_data >= IO_SLOTS;
+        IoSlot *slot = &ioSlots[cqe->user_data % IO_SLOTS];
+        // A short write counts as a failure, as does the sync it cancels
+        if (cqe->res < 0 || (!isSync && (size_t)cqe->res != slot->length))
+            slot->ok = 0;
+        if (--slot->pending == 0)
+            ioComplete(slot, slot->ok);
+    }
+    __atomic_store_n(ioRing.cqHead, head, __ATOMIC_RELEASE);
+}
+#endif
+
+// Settles finished chunks; with wait set, blocks until at least one finishes
+static void ioReap(int wait)
+{
+#ifdef IO_URING_AVAILABLE
+    if (ioBackend == IO_BACKEND_URING)
+    {
+        ioUringReap(wait);
+        return;
+    }
+#endif
+    pthread_mutex_lock(&ioLock);
+    while (1)
+    {
+        int settled = 0;
+        for (int i = 0; i < IO_SLOTS; i++)
+        {
+            if (ioSlots[i].state == IO_SLOT_QUEUED && ioSlots[i].done)
+            {
+                ioComplete(&ioSlots[i], ioSlots[i].ok);
+                settled++;
+            }
+        }
+        if (settled > 0 || !wait)
+            break;
+        pthread_cond_wait(&ioDone, &ioLock);
+    }
+    pthread_mutex_unlock(&ioLock);
+}
+
+// A free chunk buffer for writer, or -1 when every buffer is held by open writers
+int ioSlotAcquire(DataWriter *writer)
+{
+    while (1)
+    {
+        int inFlight = 0;
+        for (int i = 0; i < IO_SLOTS; i++)
+        {
+            if (ioSlots[i].state == IO_SLOT_FREE)
+            {
+                ioSlots[i].state = IO_SLOT_FILLING;
+                ioSlots[i].owner = writer;
+                return i;
+            }
+            inFlight += ioSlots[i].state != IO_SLOT_FILLING;
+        }
+        if (inFlight == 0)
+            return -1;
+        ioStalls++;
+        ioReap(1);
+    }
+}
+
+// Hands the writer's current chunk to the backend
+void ioSubmit(DataWriter *writer, int sync)
+{
+    IoSlot *slot = &ioSlots[writer->slot];
+    slot->fd = writer->fd;
+    slot->length = writer->length;
+    slot->offset = writer->append ? -1 : writer->written;
+    slot->sync = sync;
+    slot->ok = 1;
+    slot->done = 0;
+    writer->inFlight++;
+    ioChunks++;
+    if (sync)
+        ioSyncs++;
+
+#ifdef IO_URING_AVAILABLE
+    if (ioBackend == IO_BACKEND_URING)
+    {
+        slot->state = IO_SLOT_QUEUED;
+        ioUringSubmit(slot, writer->slot);
+        return;
+    }
+#endif
+    pthread_mutex_lock(&ioLock);
+    slot->state = IO_SLOT_QUEUED;
+    ioQueue[ioQueueTail++ % IO_SLOTS] = writer->slot;
+    pthread_cond_signal(&ioWork);
+    pthread_mutex_unlock(&ioLock);
+}
+
+void ioWaitWriter(DataWriter *writer)
+{
+    while (writer->inFlight > 0)
+    {
+        ioStalls++;
+        ioReap(1);
+    }
+}
+#endif
+
+// Picks the backend for every writer opened from now on; the chunk buffers
+// are set up on first use. Returns 0 for an unknown name.
+int setIoBackend(const char *name)
+{
+    if (strcmp(name, "sync") == 0)
+    {
+        ioBackend = IO_BACKEND_SYNC;
+        return 1;
+    }
+    if (strcmp(name, "thread") != 0 && strcmp(name, "uring") != 0)
+        return 0;
+#ifdef _WIN32
+    printf("Asynchronous I/O is not available on this platform; writing synchronously.\n");
+    ioBackend = IO_BACKEND_SYNC;
+#else
+    for (int i = 0; i < IO_SLOTS; i++)
+        ioSlots[i].data = ioBuffers[i];
+    if (strcmp(name, "uring") == 0)
+    {
+#ifdef IO_URING_AVAILABLE
+        static int ringReady = 0;
+        if (ringReady || (ringReady = ioUringSetup()))
+        {
+            ioBackend = IO_BACKEND_URING;
+            return 1;
+        }
+        printf("io_uring is not available on this kernel; using the I/O thread pool.\n");
+#else
+        printf("Built without io_uring (-DUSE_IO_URING); using the I/O thread pool.\n");
+#endif
+    }
+    static int threadsReady = 0;
+    if (!threadsReady && !(threadsReady = ioThreadsStart()))
+    {
+        printf("Cannot start the I/O threads; writing synchronously.\n");
+        ioBackend = IO_BACKEND_SYNC;
+        return 1;
+    }
+    ioBackend = IO_BACKEND_THREAD;
+#endif
+    return 1;
+}
+
+// Data File Reader
+// A data file is read into one buffer with a single fread. Lines and fields are
+// returned as spans into that buffer; nothing is copied until a field is
+// converted into a record, and every conversion checks the destination size.
+// Empty fields are kept, so "2|0||0" has four fields.
+
+int dataReaderOpen(DataReader *reader, const char *relative)
+{
+    memset(reader, 0, sizeof(DataReader));
+    reader->name = relative;
+
+    FILE *fp = openDataFile(relative, "rb");
+    if (fp == NULL)
+        return 0;
+
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    if (size <= 0 || (reader->data = heapAlloc(size)) == NULL)
+    {
+        fclose(fp);
+        return 0;
+    }
+    reader->size = fread(reader->data, 1, size, fp);
+    fclose(fp);
+    return 1;
+}
+
+void dataReaderClose(DataReader *reader)
+{
+    free(reader->data);
+    reader->data = NULL;
+}
+
+// Splits the next line into at most maxFields spans (extra fields are ignored).
+// Returns the field count, or -1 at the end of the file.
+int dataReaderNext(DataReader *reader, FieldSpan *fields, int maxFields)
+{
+    if (reader->pos >= reader->size)
+        return -1;
+
+    const char *start = reader->data + reader->pos;
+    size_t remaining = reader->size - reader->pos;
+    const char *newline = memchr(start, '\n', remaining);
+    const char *end = newline ? newline : start + remaining;
+    reader->pos += (end - start) + (newline != NULL);
+    reader->line++;
+    if (end > start && end[-1] == '\r')
+        end--;
+
+    int count = 0;
+    const char *p = start;
+    while (count < maxFields)
+    {
+        const char *pipe = memchr(p, '|', end - p);
+        const char *fieldEnd = pipe ? pipe : end;
+        fields[count].start = p;
+        fields[count].length = (int)(fieldEnd - p);
+        count++;
+        if (pipe == NULL)
+            break;
+        p = pipe + 1;
+    }
+    return count;
+}
+
+// Files saved in append mode hold one "<count>" line plus records per save.
+// Positions the reader on the records of the last complete block and returns its
+// count, or -1 when the file has none. A block cut short by a crash is ignored.
+long dataReaderLastBlock(DataReader *reader)
+{
+    long lastCount = -1;
+    size_t lastPos = 0;
+    long lastLine = 0;
+    FieldSpan field;
+
+    reader->pos = 0;
+    reader->line = 0;
+    while (1)
+    {
+        long count;
+        if (dataReaderNext(reader, &field, 1) < 0 || !spanToLong(field, &count) || count < 0)
+            break;
+
+        size_t blockPos = reader->pos;
+        long blockLine = reader->line;
+        long skipped = 0;
+        while (skipped < count)
+        {
+            const char *newline = memchr(reader->data + reader->pos, '\n', reader->size - reader->pos);
+            if (newline == NULL)
+            {
+                // The last line may lack its newline
+                if (reader->pos < reader->size)
+                {
+                    reader->pos = reader->size;
+                    skipped++;
+                }
+                break;
+            }
+            reader->pos = newline - reader->data + 1;
+            skipped++;
+        }
+        if (skipped < count)
+            break;
+        reader->line += skipped;
+        lastCount = count;
+        lastPos = blockPos;
+        lastLine = blockLine;
+    }
+
+    reader->pos = lastPos;
+    reader->line = lastLine;
+    return lastCount;
+}
+
+void dataReaderWarn(DataReader *reader, const char *problem)
+{
+    dataWarningCount++;
+    if (dataWarnings)
+        printf("WARNING: %s line %ld: %s, record skipped.\n", reader->name, reader->line, problem);
+}
+
+// Copies a field into a fixed array; fails instead of truncating or overflowing
+int spanToText(FieldSpan field, char *out, int size)
+{
+    if (field.length >= size)
+        return 0;
+    memcpy(out, field.start, field.length);
+    out[field.length] = 0;
+    return 1;
+}
+
+// Optional sign and decimal digits only; an empty field is not a number
+int spanToLong(FieldSpan field, long *out)
+{
+    int i = 0, negative = 0;
+    long value = 0;
+    if (field.length > 0 && (field.start[0] == '-' || field.start[0] == '+'))
+    {
+        negative = field.start[0] == '-';
+        i = 1;
+    }
+    if (i == field.length || field.length - i > 18)
+        return 0;
+    for (; i < field.length; i++)
+    {
+        if (!(charClass[(unsigned char)field.start[i]] & CH_DIGIT))
+            return 0;
+        value = value * 10 + (field.start[i] - '0');
+    }
+    *out = negative ? -value : value;
+    return 1;
+}
+
+int spanToInt(FieldSpan field, int *out)
+{
+    long value;
+    if (!spanToLong(field, &value) || value < INT_MIN || value > INT_MAX)
+        return 0;
+    *out = (int)value;
+    return 1;
+}
+
+int spanToDouble(FieldSpan field, double *out)
+{
+    char text[40];
+    char *end;
+    if (field.length == 0 || !spanToText(field, text, sizeof(text)))
+        return 0;
+    *out = strtod(text, &end);
+    return *end == 0;
+}
+
+void clearInputBuffer()
+{
+    int c;
+    while ((c = getchar()) != '\n' && c != EOF)
+        ;
+}
+
+int findOwnerById(char *ownerId)
+{
+    return indexFind(ownerIdIndex, OWNER_INDEX_SIZE, ownerId);
+}
+
+int findOwnerByPhone(char *phone)
+{
+    return indexFind(ownerPhoneIndex, OWNER_INDEX_SIZE, phone);
+}
+
+int findVehicleById(char *vehicleId)
+{
+    int vehicleIndex = indexFind(vehicleIdIndex, VEHICLE_INDEX_SIZE, vehicleId);
+    histogramRecord(&vehicleLookupProbes, indexLastProbes);
+    return vehicleIndex;
+}
+
+// Spot allocation
+// Both variants return the lowest free spot number, so a lot fills the same way
+// whichever one a build uses. markSpotFree must follow every isOccupied change
+// made one spot at a time; bulk changes (loads, resets) call rebuildFreeSpots.
+#if SPOT_BITMAP
+static int lowestSetBit(uint64_t bits)
+{
+#if defined(__GNUC__)
+    return __builtin_ctzll(bits);
+#else
+    int n = 0;
+    while (!(bits & 1))
+    {
+        bits >>= 1;
+        n++;
+    }
+    return n;
+#endif
+}
+
+// Lowest free spot index in [first, last), or -1
+static int findFreeSpotIn(int first, int last)
+{
+    for (int word = first / 64; word * 64 < last; word++)
+    {
+        uint64_t bits = freeSpotBits[word];
+        if (word == first / 64)
+            bits &= ~0ULL << (first % 64);
+        if (bits != 0)
+        {
+            int spotIndex = word * 64 + lowestSetBit(bits);
+            return spotIndex < last ? spotIndex : -1;
+        }
+    }
+    return -1;
+}
+
+void markSpotFree(int spotIndex, int isFree)
+{
+    if (isFree)
+        freeSpotBits[spotIndex / 64] |= 1ULL << (spotIndex % 64);
+    else
+        freeSpotBits[spotIndex / 64] &= ~(1ULL << (spotIndex % 64));
+}
+
+void rebuildFreeSpots()
+{
+    memset(freeSpotBits, 0, sizeof(freeSpotBits));
+    for (int i = 0; i < MAX_PARKING_SPOTS; i++)
+    {
+        if (!spots[i].isOccupied)
+            markSpotFree(i, 1);
+    }
+}
+
+int findAvailableSpot()
+{
+    int spotIndex = findFreeSpotIn(0, MAX_PARKING_SPOTS);
+    return spotIndex != -1 ? spotIndex + 1 : -1;
+}
+#else
+void markSpotFree(int spotIndex, int isFree)
+{
+    (void)spotIndex;
+    (void)isFree;
+}
+
+void rebuildFreeSpots()
+{
+}
+
+int findAvailableSpot()
+{
+    for (int i = 0; i < MAX_PARKING_SPOTS; i++)
+    {
+        if (!spots[i].isOccupied)
+        {
+            return spots[i].spotNumber;
+        }
+    }
+    return -1;
+}
+#endif
+
+// Zone of a spot: the lot is split into NUM_ZONES equal ranges (A, B, ...)
+int getSpotZone(int spotNumber)
+{
+    int zone = (spotNumber - 1) / SPOTS_PER_ZONE;
+    return zone < NUM_ZONES ? zone : NUM_ZONES - 1;
+}
+
+int findAvailableSpotInZones(unsigned int zoneMask)
+{
+#if SPOT_BITMAP
+    // Zones are consecutive ranges, so the first allowed zone with room has the lowest spot
+    for (int zone = 0; zone < NUM_ZONES; zone++)
+    {
+        if (!(zoneMask & (1u << zone)))
+            continue;
+        int last = zone == NUM_ZONES - 1 ? MAX_PARKING_SPOTS : (zone + 1) * SPOTS_PER_ZONE;
+        int spotIndex = findFreeSpotIn(zone * SPOTS_PER_ZONE, last);
+        if (spotIndex != -1)
+            return spotIndex + 1;
+    }
+    return -1;
+#else
+    for (int i = 0; i < MAX_PARKING_SPOTS; i++)
+    {
+        if (!spots[i].isOccupied && (zoneMask & (1u << getSpotZone(spots[i].spotNumber))))
+        {
+            return spots[i].spotNumber;
+        }
+    }
+    return -1;
+#endif
+}
+
+// IDs already loaded from the data files are skipped, so IDs stay unique across runs
+void generateOwnerId(char *ownerId)
+{
+    static int ownerCounter = 1;
+    do
+    {
+        sprintf(ownerId, "OWN%04d", ownerCounter++);
+    } while (findOwnerById(ownerId) != -1);
+}
+
+void generateVehicleId(char *vehicleId)
+{
+    static int vehicleCounter = 1;
+    do
+    {
+        sprintf(vehicleId, "VH%04d", vehicleCounter++);
+    } while (findVehicleById(vehicleId) != -1);
+}
+
+double calculateParkingFee(time_t entryTime)
+{
+    return calculateParkingFeeAt(entryTime, clockNow(), BASE_RATE_PER_HOUR);
+}
+
+double calculateParkingFeeAt(time_t entryTime, time_t exitTime, double ratePerHour)
+{
+    // Calculate difference in seconds
+    double secondsParked = difftime(exitTime, entryTime);
+    double hoursParked = secondsParked / 3600.0;
+
+    // Minimum hours
+    if (hoursParked < 1)
+    {
+        hoursParked = 1;
+    }
+    // Calculate total fee
+    double totalFee = hoursParked * ratePerHour;
+
+    return totalFee;
+}
+
+// Occupancy band of the lot with `occupied` spots taken (0 = quietest)
+int occupancyBand(int occupied)
+{
+    int percent = occupied * 100 / MAX_PARKING_SPOTS;
+    int band = 0;
+    while (band < NUM_OCCUPANCY_BANDS - 1 && percent >= occupancyBandLimits[band])
+        band++;
+    return band;
+}
+
+// Hourly rate for a car entering now: two table lookups, no scan of the lot
+double entryRatePerHour(time_t now, int occupied)
+{
+    if (!SURGE_PRICING)
+        return BASE_RATE_PER_HOUR;
+    int period = dayPeriodOfHour[hourOfWeek(now) % 24];
+    return BASE_RATE_PER_HOUR * surgeFactor[period][occupancyBand(occupied)];
+}
+
+// String index (open addressing, linear probing, FNV-1a hash).
+// Any capacity works; keep it at least twice the number of keys.
+unsigned int hashString(const char *key)
+{
+    unsigned int hash = 2166136261u;
+    while (*key)
+    {
+        hash ^= (unsigned char)*key++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Maps the hash onto [0, capacity) without a division
+static unsigned int indexStartSlot(const char *key, int capacity)
+{
+    return (unsigned int)(((unsigned long long)hashString(key) * (unsigned int)capacity) >> 32);
+}
+
+void indexClear(IndexSlot *slots, int capacity)
+{
+    for (int i = 0; i < capacity; i++)
+    {
+        slots[i].key[0] = 0;
+        slots[i].value = INDEX_EMPTY;
+    }
+}
+
+// Returns the stored value, or -1 when the key is absent
+int indexFind(IndexSlot *slots, int capacity, const char *key)
+{
+    unsigned int pos = indexStartSlot(key, capacity);
+    for (int probes = 0; probes < capacity; probes++)
+    {
+        indexLastProbes = probes + 1;
+        if (slots[pos].value == INDEX_EMPTY)
+            return -1;
+        if (slots[pos].value != INDEX_DELETED && strcmp(slots[pos].key, key) == 0)
+            return slots[pos].value;
+        if (++pos == (unsigned int)capacity)
+            pos = 0;
+    }
+    return -1;
+}
+
+// Inserts or overwrites a key, returns 0 when the index is full
+int indexInsert(IndexSlot *slots, int capacity, const char *key, int value)
+{
+    unsigned int pos = indexStartSlot(key, capacity);
+    int freeSlot = -1;
+    for (int probes = 0; probes < capacity; probes++)
+    {
+        if (slots[pos].value == INDEX_EMPTY)
+        {
+            if (freeSlot == -1)
+                freeSlot = pos;
+            break;
+        }
+        if (slots[pos].value == INDEX_DELETED)
+        {
+            if (freeSlot == -1)
+                freeSlot = pos;
+        }
+        else if (strcmp(slots[pos].key, key) == 0)
+        {
+            slots[pos].value = value;
+            return 1;
+        }
+        if (++pos == (unsigned int)capacity)
+            pos = 0;
+    }
+    if (freeSlot == -1)
+        return 0;
+    strncpy(slots[freeSlot].key, key, INDEX_KEY_LEN - 1);
+    slots[freeSlot].key[INDEX_KEY_LEN - 1] = 0;
+    slots[freeSlot].value = value;
+    return 1;
+}
+
+void indexRemove(IndexSlot *slots, int capacity, const char *key)
+{
+    unsigned int pos = indexStartSlot(key, capacity);
+    for (int probes = 0; probes < capacity; probes++)
+    {
+        if (slots[pos].value == INDEX_EMPTY)
+            return;
+        if (slots[pos].value != INDEX_DELETED && strcmp(slots[pos].key, key) == 0)
+        {
+            slots[pos].value = INDEX_DELETED;
+            return;
+        }
+        if (++pos == (unsigned int)capacity)
+            pos = 0;
+    }
+}
+
+// Deterministic random numbers (splitmix64), same seed gives the same stream
+unsigned long long randomNext(unsigned long long *state)
+{
+    unsigned long long z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// Uniform in [0, 1)
+double randomUniform(unsigned long long *state)
+{
+    return (randomNext(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+double randomExponential(unsigned long long *state, double mean)
+{
+    return -mean * log(1.0 - randomUniform(state));
+}
+
+double randomLogNormal(unsigned long long *state, double mean, double sigma)
+{
+    // Box-Muller normal, mu chosen so the distribution has the requested mean
+    double u1 = 1.0 - randomUniform(state);
+    double u2 = randomUniform(state);
+    double normal = sqrt(-2.0 * log(u1)) * cos(2.0 * 3.14159265358979323846 * u2);
+    double mu = log(mean) - sigma * sigma / 2.0;
+    return exp(mu + sigma * normal);
+}
+
+// Time-dependent code reads clockNow(), a coarse "now" that clockTick()
+// refreshes once per request or batch: one operation sees a single time from
+// start to finish and hot paths make no system call. A fake clock (--clock,
+// the simulator, replays) only moves when it is set or ticked.
+time_t clockNow()
+{
+    if (clockCurrent == 0)
+        clockTick();
+    return clockCurrent;
+}
+
+time_t clockTick()
+{
+    if (clockIsFake)
+        clockCurrent += clockFakeStep;
+    else
+        clockCurrent = time(NULL);
+    return clockCurrent;
+}
+
+void clockSet(time_t now)
+{
+    clockIsFake = 1;
+    clockCurrent = now;
+}
+
+// <unix time>[+<seconds per tick>]
+int parseFakeClock(const char *text)
+{
+    char *end;
+    long long start = strtoll(text, &end, 10);
+    long step = 0;
+    if (end == text || start <= 0)
+        return 0;
+    if (*end == '+')
+    {
+        char *stepEnd;
+        step = strtol(end + 1, &stepEnd, 10);
+        if (stepEnd == end + 1 || step < 0)
+            return 0;
+        end = stepEnd;
+    }
+    if (*end != 0)
+        return 0;
+    clockSet((time_t)start);
+    clockFakeStep = step;
+    return 1;
+}
+
+long long monotonicNanos()
+{
+#ifdef _WIN32
+    LARGE_INTEGER frequency, counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (long long)(counter.QuadPart * (1e9 / frequency.QuadPart));
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+#endif
+}
+
+// Bucket = power of two of the value plus the next three bits below it
+static int histogramBucket(unsigned long long value)
+{
+    if (value < HIST_SUB_BUCKETS)
+        return (int)value;
+    int msb = 63;
+    while (!(value >> msb))
+        msb--;
+    int sub = (int)((value >> (msb - 3)) & (HIST_SUB_BUCKETS - 1));
+    return (msb - 2) * HIST_SUB_BUCKETS + sub;
+}
+
+static unsigned long long histogramBucketValue(int bucket)
+{
+    if (bucket < HIST_SUB_BUCKETS)
+        return bucket;
+    int msb = bucket / HIST_SUB_BUCKETS + 2;
+    int sub = bucket % HIST_SUB_BUCKETS;
+    return ((unsigned long long)(HIST_SUB_BUCKETS + sub) << (msb - 3));
+}
+
+void histogramRecord(LatencyHistogram *hist, unsigned long long value)
+{
+    hist->counts[histogramBucket(value)]++;
+    hist->total++;
+    hist->sum += value;
+    if (value > hist->max)
+        hist->max = value;
+}
+
+// Lower bound of the bucket holding the given percentile
+unsigned long long histogramPercentile(LatencyHistogram *hist, double percentile)
+{
+    if (hist->total == 0)
+        return 0;
+    unsigned long long target = (unsigned long long)(hist->total * percentile / 100.0);
+    if (target >= hist->total)
+        target = hist->total - 1;
+    unsigned long long seen = 0;
+    for (int i = 0; i < HIST_BUCKETS; i++)
+    {
+        seen += hist->counts[i];
+        if (seen > target)
+            return histogramBucketValue(i);
+    }
+    return hist->max;
+}